@@ -0,0 +1,359 @@
+#include "AnimationCompression.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	const float MaxQuantized16 = 65535.0f;
+	const float MaxQuantized15 = 32767.0f;
+	const float Sqrt2 = 1.41421356f;
+
+	// Greedy keyframe reduction: grow each segment from the last kept key for as long
+	// as interpolating across it keeps every skipped key within tolerance.
+	// error(first, last, k) measures key k against the segment [first, last].
+	template<typename ErrorFunction>
+	std::vector<UINT> ReduceKeys(UINT keyCount, float tolerance, ErrorFunction error)
+	{
+		std::vector<UINT> kept(1, 0);
+		if (keyCount == 1)
+			return kept;
+
+		UINT anchor = 0;
+		for (UINT last = 2; last < keyCount; ++last)
+		{
+			bool fits = true;
+			for (UINT k = anchor + 1; k < last && fits; ++k)
+			{
+				fits = error(anchor, last, k) <= tolerance;
+			}
+
+			if (!fits)
+			{
+				kept.push_back(last - 1);
+				anchor = last - 1;
+			}
+		}
+
+		kept.push_back(keyCount - 1);
+		return kept;
+	}
+
+	float LerpPercent(const std::vector<Keyframe>& keyframes, UINT first, UINT last, UINT k)
+	{
+		return (keyframes[k].TimePos - keyframes[first].TimePos) /
+			(keyframes[last].TimePos - keyframes[first].TimePos);
+	}
+
+	// Angle of the rotation taking q0 to q1.  Measured from the chord between the two
+	// quaternions rather than acos(dot), which cannot resolve angles below ~1e-3 in float.
+	float RotationAngle(FXMVECTOR q0, FXMVECTOR q1)
+	{
+		XMVECTOR q1Near = XMVectorGetX(XMQuaternionDot(q0, q1)) < 0.0f ? -q1 : q1;
+		float chord = XMVectorGetX(XMVector4Length(q0 - q1Near));
+		return 4.0f * std::asin(MathHelper::Min(0.5f * chord, 1.0f));
+	}
+
+	// Smallest-three encoding of a unit quaternion into three 16-bit words.
+	void EncodeRotation(const XMFLOAT4& q, std::uint16_t* words)
+	{
+		float c[4] = { q.x, q.y, q.z, q.w };
+		float length = std::sqrt(c[0] * c[0] + c[1] * c[1] + c[2] * c[2] + c[3] * c[3]);
+
+		int largest = 0;
+		for (int i = 1; i < 4; ++i)
+		{
+			if (std::fabs(c[i]) > std::fabs(c[largest]))
+				largest = i;
+		}
+
+		// q and -q are the same rotation; pick the one whose dropped component is positive.
+		float scale = (c[largest] < 0.0f ? -1.0f : 1.0f) / length;
+
+		std::uint16_t quantized[3];
+		for (int i = 0, j = 0; i < 4; ++i)
+		{
+			if (i == largest)
+				continue;
+
+			float v = (c[i] * scale * Sqrt2 + 1.0f) * 0.5f;
+			quantized[j++] = (std::uint16_t)MathHelper::Clamp(std::lround(v * MaxQuantized15), 0L, (long)MaxQuantized15);
+		}
+
+		words[0] = (std::uint16_t)(quantized[0] | ((largest >> 1) << 15));
+		words[1] = (std::uint16_t)(quantized[1] | ((largest & 1) << 15));
+		words[2] = quantized[2];
+	}
+
+	XMFLOAT4 DecodeRotationWords(const std::uint16_t* words)
+	{
+		int largest = ((words[0] >> 15) << 1) | (words[1] >> 15);
+
+		float small[3];
+		for (int j = 0; j < 3; ++j)
+		{
+			small[j] = ((words[j] & 0x7fff) / MaxQuantized15 * 2.0f - 1.0f) / Sqrt2;
+		}
+
+		float c[4];
+		float sumSquares = 0.0f;
+		for (int i = 0, j = 0; i < 4; ++i)
+		{
+			if (i == largest)
+				continue;
+
+			c[i] = small[j++];
+			sumSquares += c[i] * c[i];
+		}
+		c[largest] = std::sqrt(MathHelper::Max(1.0f - sumSquares, 0.0f));
+
+		return XMFLOAT4(c[0], c[1], c[2], c[3]);
+	}
+
+	const XMFLOAT3& TrackValue(const Keyframe& key, int kind)
+	{
+		return kind == 0 ? key.Scale : key.Translation;
+	}
+}
+
+CompressedAnimation::CompressedAnimation(const std::vector<BoneAnimation>& boneAnimations, const AnimationCompressionSettings& settings)
+{
+	mStartTime = MathHelper::Infinity;
+	mEndTime = 0.0f;
+	for (const BoneAnimation& bone : boneAnimations)
+	{
+		mStartTime = MathHelper::Min(mStartTime, bone.GetStartTime());
+		mEndTime = MathHelper::Max(mEndTime, bone.GetEndTime());
+	}
+
+	for (const BoneAnimation& bone : boneAnimations)
+	{
+		BuildVectorTrack(ScaleTrack, bone.Keyframes, settings.ScaleTolerance);
+		BuildVectorTrack(TranslationTrack, bone.Keyframes, settings.TranslationTolerance);
+		BuildRotationTrack(bone.Keyframes, settings.RotationTolerance);
+	}
+
+	for (int kind = 0; kind < TrackKindCount; ++kind)
+	{
+		mTimes[kind].shrink_to_fit();
+		mValues[kind].shrink_to_fit();
+	}
+}
+
+UINT CompressedAnimation::BoneCount() const
+{
+	return (UINT)mTracks[RotationTrack].size();
+}
+
+float CompressedAnimation::GetStartTime() const
+{
+	return mStartTime;
+}
+
+float CompressedAnimation::GetEndTime() const
+{
+	return mEndTime;
+}
+
+std::size_t CompressedAnimation::ByteSize() const
+{
+	std::size_t bytes = sizeof(*this);
+	for (int kind = 0; kind < TrackKindCount; ++kind)
+	{
+		bytes += mTracks[kind].size() * sizeof(Track);
+		bytes += mTimes[kind].size() * sizeof(std::uint16_t);
+		bytes += mValues[kind].size() * sizeof(std::uint16_t);
+	}
+	return bytes;
+}
+
+std::uint16_t CompressedAnimation::QuantizeTime(float t) const
+{
+	float duration = mEndTime - mStartTime;
+	if (duration <= 0.0f)
+		return 0;
+
+	float u = (t - mStartTime) / duration * MaxQuantized16;
+	return (std::uint16_t)MathHelper::Clamp(std::lround(u), 0L, (long)MaxQuantized16);
+}
+
+void CompressedAnimation::BuildVectorTrack(TrackKind kind, const std::vector<Keyframe>& keyframes, float tolerance)
+{
+	const UINT keyCount = (UINT)keyframes.size();
+
+	Track track;
+	track.FirstKey = (UINT)mTimes[kind].size();
+
+	XMVECTOR first = XMLoadFloat3(&TrackValue(keyframes[0], kind));
+
+	bool constant = true;
+	for (UINT k = 1; k < keyCount && constant; ++k)
+	{
+		XMVECTOR v = XMLoadFloat3(&TrackValue(keyframes[k], kind));
+		constant = XMVectorGetX(XMVector3Length(v - first)) <= tolerance;
+	}
+
+	if (constant)
+	{
+		// Extent 0 decodes every component to Min exactly.
+		track.KeyCount = 1;
+		XMStoreFloat3(&track.Min, first);
+
+		mTimes[kind].push_back(0);
+		mValues[kind].insert(mValues[kind].end(), 3, 0);
+		mTracks[kind].push_back(track);
+		return;
+	}
+
+	XMVECTOR vMin = first;
+	XMVECTOR vMax = first;
+	for (UINT k = 1; k < keyCount; ++k)
+	{
+		XMVECTOR v = XMLoadFloat3(&TrackValue(keyframes[k], kind));
+		vMin = XMVectorMin(vMin, v);
+		vMax = XMVectorMax(vMax, v);
+	}
+	XMStoreFloat3(&track.Min, vMin);
+	XMStoreFloat3(&track.Extent, vMax - vMin);
+
+	const float extent[3] = { track.Extent.x, track.Extent.y, track.Extent.z };
+	const float minimum[3] = { track.Min.x, track.Min.y, track.Min.z };
+
+	// Quantize every key up front so the reduction measures what will be decoded.
+	std::vector<std::uint16_t> quantized(3 * keyCount);
+	std::vector<XMFLOAT3> decoded(keyCount);
+	for (UINT k = 0; k < keyCount; ++k)
+	{
+		const XMFLOAT3& v = TrackValue(keyframes[k], kind);
+		const float value[3] = { v.x, v.y, v.z };
+
+		float d[3];
+		for (int c = 0; c < 3; ++c)
+		{
+			float u = extent[c] > 0.0f ? (value[c] - minimum[c]) / extent[c] : 0.0f;
+			quantized[3 * k + c] = (std::uint16_t)MathHelper::Clamp(std::lround(u * MaxQuantized16), 0L, (long)MaxQuantized16);
+			d[c] = minimum[c] + quantized[3 * k + c] * (extent[c] / MaxQuantized16);
+		}
+		decoded[k] = XMFLOAT3(d[0], d[1], d[2]);
+	}
+
+	std::vector<UINT> kept = ReduceKeys(keyCount, tolerance, [&](UINT a, UINT b, UINT k)
+		{
+			XMVECTOR v = XMVectorLerp(XMLoadFloat3(&decoded[a]), XMLoadFloat3(&decoded[b]), LerpPercent(keyframes, a, b, k));
+			return XMVectorGetX(XMVector3Length(v - XMLoadFloat3(&TrackValue(keyframes[k], kind))));
+		});
+
+	track.KeyCount = (UINT)kept.size();
+	for (UINT k : kept)
+	{
+		mTimes[kind].push_back(QuantizeTime(keyframes[k].TimePos));
+		mValues[kind].insert(mValues[kind].end(), &quantized[3 * k], &quantized[3 * k] + 3);
+	}
+	mTracks[kind].push_back(track);
+}
+
+void CompressedAnimation::BuildRotationTrack(const std::vector<Keyframe>& keyframes, float tolerance)
+{
+	const UINT keyCount = (UINT)keyframes.size();
+
+	Track track;
+	track.FirstKey = (UINT)mTimes[RotationTrack].size();
+
+	std::vector<std::uint16_t> encoded(3 * keyCount);
+	std::vector<XMFLOAT4> decoded(keyCount);
+	for (UINT k = 0; k < keyCount; ++k)
+	{
+		EncodeRotation(keyframes[k].RotationQuat, &encoded[3 * k]);
+		decoded[k] = DecodeRotationWords(&encoded[3 * k]);
+	}
+
+	bool constant = true;
+	for (UINT k = 0; k < keyCount && constant; ++k)
+	{
+		constant = RotationAngle(XMLoadFloat4(&decoded[0]), XMLoadFloat4(&keyframes[k].RotationQuat)) <= tolerance;
+	}
+
+	std::vector<UINT> kept(1, 0);
+	if (!constant)
+	{
+		kept = ReduceKeys(keyCount, tolerance, [&](UINT a, UINT b, UINT k)
+			{
+				XMVECTOR q = XMQuaternionSlerp(XMLoadFloat4(&decoded[a]), XMLoadFloat4(&decoded[b]), LerpPercent(keyframes, a, b, k));
+				return RotationAngle(q, XMLoadFloat4(&keyframes[k].RotationQuat));
+			});
+	}
+
+	track.KeyCount = (UINT)kept.size();
+	for (UINT k : kept)
+	{
+		mTimes[RotationTrack].push_back(QuantizeTime(keyframes[k].TimePos));
+		mValues[RotationTrack].insert(mValues[RotationTrack].end(), &encoded[3 * k], &encoded[3 * k] + 3);
+	}
+	mTracks[RotationTrack].push_back(track);
+}
+
+void CompressedAnimation::FindKeys(TrackKind kind, const Track& track, float u, UINT& k0, UINT& k1, float& lerpPercent) const
+{
+	const std::uint16_t* times = &mTimes[kind][track.FirstKey];
+	const UINT last = track.KeyCount - 1;
+
+	if (last == 0 || u <= times[0])
+	{
+		k0 = k1 = track.FirstKey;
+		lerpPercent = 0.0f;
+	}
+	else if (u >= times[last])
+	{
+		k0 = k1 = track.FirstKey + last;
+		lerpPercent = 0.0f;
+	}
+	else
+	{
+		// First key after u; the interval starts one before it.
+		UINT next = (UINT)(std::upper_bound(times + 1, times + last, u,
+			[](float time, std::uint16_t key) { return time < key; }) - times);
+
+		k0 = track.FirstKey + next - 1;
+		k1 = track.FirstKey + next;
+		lerpPercent = (u - times[next - 1]) / (float)(times[next] - times[next - 1]);
+	}
+}
+
+XMFLOAT3 CompressedAnimation::DecodeVector(TrackKind kind, const Track& track, UINT key) const
+{
+	const std::uint16_t* q = &mValues[kind][3 * key];
+	return XMFLOAT3(
+		track.Min.x + q[0] * (track.Extent.x / MaxQuantized16),
+		track.Min.y + q[1] * (track.Extent.y / MaxQuantized16),
+		track.Min.z + q[2] * (track.Extent.z / MaxQuantized16));
+}
+
+XMFLOAT4 CompressedAnimation::DecodeRotation(UINT key) const
+{
+	return DecodeRotationWords(&mValues[RotationTrack][3 * key]);
+}
+
+void CompressedAnimation::GetBoneKeys(UINT bone, float t, BoneKeyPair& keys) const
+{
+	float duration = mEndTime - mStartTime;
+	float u = duration > 0.0f ? (t - mStartTime) / duration * MaxQuantized16 : 0.0f;
+
+	UINT k0, k1;
+
+	const Track& scale = mTracks[ScaleTrack][bone];
+	FindKeys(ScaleTrack, scale, u, k0, k1, keys.ScaleLerp);
+	keys.Scale[0] = DecodeVector(ScaleTrack, scale, k0);
+	keys.Scale[1] = DecodeVector(ScaleTrack, scale, k1);
+
+	const Track& translation = mTracks[TranslationTrack][bone];
+	FindKeys(TranslationTrack, translation, u, k0, k1, keys.TranslationLerp);
+	keys.Translation[0] = DecodeVector(TranslationTrack, translation, k0);
+	keys.Translation[1] = DecodeVector(TranslationTrack, translation, k1);
+
+	const Track& rotation = mTracks[RotationTrack][bone];
+	FindKeys(RotationTrack, rotation, u, k0, k1, keys.RotationLerp);
+	keys.RotationQuat[0] = DecodeRotation(k0);
+	keys.RotationQuat[1] = DecodeRotation(k1);
+}
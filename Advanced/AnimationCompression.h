@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+
+#include "AnimationHelper.h"
+
+
+// Error bounds for AnimationClip::Compress.  A keyframe is dropped when interpolating
+// the keys around it reproduces it within the tolerance (quantization included), and a
+// track whose keys all stay within the tolerance of its first key is stored once.
+struct AnimationCompressionSettings
+{
+	// Distances, in the model's units.
+	float TranslationTolerance = 0.001f;
+	float ScaleTolerance = 0.0001f;
+
+	// Angle between the original and the reconstructed rotation, in radians.
+	float RotationTolerance = 0.0005f;
+};
+
+
+// Compressed keyframes of one clip.  Every bone gets separate scale, translation and
+// rotation tracks, each keeping only the keys it needs:
+//
+//   - key times are 16-bit fractions of the clip's duration;
+//   - scales and translations are 16 bits per component within the track's bounds;
+//   - rotations are "smallest three" quaternions in 48 bits: the index of the largest
+//     component, then the other three at 15 bits each (the largest is implied).
+class CompressedAnimation
+{
+public:
+	CompressedAnimation(const std::vector<BoneAnimation>& boneAnimations, const AnimationCompressionSettings& settings);
+
+	UINT BoneCount() const;
+	float GetStartTime() const;
+	float GetEndTime() const;
+
+	// Decompresses the keys of bone around time t.
+	void GetBoneKeys(UINT bone, float t, BoneKeyPair& keys) const;
+
+	// Memory used by the keys and track headers.
+	std::size_t ByteSize() const;
+
+private:
+	enum TrackKind
+	{
+		ScaleTrack,
+		TranslationTrack,
+		RotationTrack,
+		TrackKindCount
+	};
+
+	struct Track
+	{
+		UINT FirstKey = 0;
+		UINT KeyCount = 0;
+
+		// Range the quantized components map onto (scale and translation tracks).
+		DirectX::XMFLOAT3 Min = { 0.0f, 0.0f, 0.0f };
+		DirectX::XMFLOAT3 Extent = { 0.0f, 0.0f, 0.0f };
+	};
+
+	void BuildVectorTrack(TrackKind kind, const std::vector<Keyframe>& keyframes, float tolerance);
+	void BuildRotationTrack(const std::vector<Keyframe>& keyframes, float tolerance);
+
+	std::uint16_t QuantizeTime(float t) const;
+
+	// The keys of track at or before and after time u (in quantized time units).
+	void FindKeys(TrackKind kind, const Track& track, float u, UINT& k0, UINT& k1, float& lerpPercent) const;
+
+	DirectX::XMFLOAT3 DecodeVector(TrackKind kind, const Track& track, UINT key) const;
+	DirectX::XMFLOAT4 DecodeRotation(UINT key) const;
+
+private:
+	float mStartTime = 0.0f;
+	float mEndTime = 0.0f;
+
+	// Indexed by TrackKind: one track per bone, one time and three values per key.
+	std::vector<Track> mTracks[TrackKindCount];
+	std::vector<std::uint16_t> mTimes[TrackKindCount];
+	std::vector<std::uint16_t> mValues[TrackKindCount];
+};
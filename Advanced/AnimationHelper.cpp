@@ -1,8 +1,35 @@
 #include "AnimationHelper.h"
+#include "AnimationCompression.h"
+
+#include <algorithm>
 
 using namespace DirectX;
 
 
+namespace
+{
+	// A bone's pose relative to its parent, before it is turned into a matrix.
+	struct LocalTransform
+	{
+		XMVECTOR S;
+		XMVECTOR Q;
+		XMVECTOR P;
+	};
+
+	LocalTransform SampleBone(const AnimationClip& clip, UINT bone, float t, UINT& cursor)
+	{
+		BoneKeyPair keys;
+		clip.GetBoneKeys(bone, t, cursor, keys);
+
+		LocalTransform x;
+		x.S = XMVectorLerp(XMLoadFloat3(&keys.Scale[0]), XMLoadFloat3(&keys.Scale[1]), keys.ScaleLerp);
+		x.Q = XMQuaternionSlerp(XMLoadFloat4(&keys.RotationQuat[0]), XMLoadFloat4(&keys.RotationQuat[1]), keys.RotationLerp);
+		x.P = XMVectorLerp(XMLoadFloat3(&keys.Translation[0]), XMLoadFloat3(&keys.Translation[1]), keys.TranslationLerp);
+		return x;
+	}
+}
+
+
 Keyframe::Keyframe()
 	: TimePos(0.0f),
 	Translation(0.0f, 0.0f, 0.0f),
@@ -26,6 +53,12 @@ float BoneAnimation::GetEndTime() const
 }
 
 void BoneAnimation::Interpolate(float t, XMFLOAT4X4& M) const
+{
+	UINT cursor = 0;
+	Interpolate(t, M, cursor);
+}
+
+void BoneAnimation::Interpolate(float t, XMFLOAT4X4& M, UINT& cursor) const
 {
 	if (t <= Keyframes.front().TimePos)
 	{
@@ -47,36 +80,83 @@ void BoneAnimation::Interpolate(float t, XMFLOAT4X4& M) const
 	}
 	else
 	{
-		for (UINT i = 0; i < Keyframes.size() - 1; ++i)
-		{
-			if (t >= Keyframes[i].TimePos && t <= Keyframes[i + 1].TimePos)
-			{
-				float lerpPercent = (t - Keyframes[i].TimePos) / (Keyframes[i + 1].TimePos - Keyframes[i].TimePos);
+		UINT i = FindKeyframe(t, cursor);
+		cursor = i;
 
-				XMVECTOR s0 = XMLoadFloat3(&Keyframes[i].Scale);
-				XMVECTOR s1 = XMLoadFloat3(&Keyframes[i + 1].Scale);
+		float lerpPercent = (t - Keyframes[i].TimePos) / (Keyframes[i + 1].TimePos - Keyframes[i].TimePos);
 
-				XMVECTOR p0 = XMLoadFloat3(&Keyframes[i].Translation);
-				XMVECTOR p1 = XMLoadFloat3(&Keyframes[i + 1].Translation);
+		XMVECTOR s0 = XMLoadFloat3(&Keyframes[i].Scale);
+		XMVECTOR s1 = XMLoadFloat3(&Keyframes[i + 1].Scale);
 
-				XMVECTOR q0 = XMLoadFloat4(&Keyframes[i].RotationQuat);
-				XMVECTOR q1 = XMLoadFloat4(&Keyframes[i + 1].RotationQuat);
+		XMVECTOR p0 = XMLoadFloat3(&Keyframes[i].Translation);
+		XMVECTOR p1 = XMLoadFloat3(&Keyframes[i + 1].Translation);
 
-				XMVECTOR S = XMVectorLerp(s0, s1, lerpPercent);
-				XMVECTOR P = XMVectorLerp(p0, p1, lerpPercent);
-				XMVECTOR Q = XMQuaternionSlerp(q0, q1, lerpPercent);
+		XMVECTOR q0 = XMLoadFloat4(&Keyframes[i].RotationQuat);
+		XMVECTOR q1 = XMLoadFloat4(&Keyframes[i + 1].RotationQuat);
 
-				XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
-				XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
+		XMVECTOR S = XMVectorLerp(s0, s1, lerpPercent);
+		XMVECTOR P = XMVectorLerp(p0, p1, lerpPercent);
+		XMVECTOR Q = XMQuaternionSlerp(q0, q1, lerpPercent);
 
-				break;
-			}
-		}
+		XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+		XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
+	}
+}
+
+void BoneAnimation::GetKeyframes(float t, UINT& cursor, const Keyframe*& k0, const Keyframe*& k1, float& lerpPercent) const
+{
+	if (t <= Keyframes.front().TimePos)
+	{
+		k0 = k1 = &Keyframes.front();
+		lerpPercent = 0.0f;
+	}
+	else if (t >= Keyframes.back().TimePos)
+	{
+		k0 = k1 = &Keyframes.back();
+		lerpPercent = 0.0f;
+	}
+	else
+	{
+		UINT i = FindKeyframe(t, cursor);
+		cursor = i;
+
+		k0 = &Keyframes[i];
+		k1 = &Keyframes[i + 1];
+		lerpPercent = (t - k0->TimePos) / (k1->TimePos - k0->TimePos);
+	}
+}
+
+UINT BoneAnimation::FindKeyframe(float t, UINT hint) const
+{
+	// Playback moves forward by less than a keyframe interval most frames, so the
+	// interval used last time, or the one right after it, is almost always it.
+	// Intervals are treated as (start, end] so a time that lands exactly on a
+	// keyframe picks the same interval as a front-to-back scan would.
+	const UINT lastInterval = (UINT)Keyframes.size() - 2;
+	for (UINT i = hint; i <= MathHelper::Min(hint + 1, lastInterval); ++i)
+	{
+		if (t > Keyframes[i].TimePos && t <= Keyframes[i + 1].TimePos)
+			return i;
 	}
+
+	// Otherwise (first call, seek, loop back to the start) binary search for the
+	// first keyframe at or after t; the interval starts one before it.
+	auto next = std::lower_bound(Keyframes.begin() + 1, Keyframes.end() - 1, t,
+		[](const Keyframe& key, float time) { return key.TimePos < time; });
+
+	return (UINT)(next - Keyframes.begin()) - 1;
+}
+
+UINT AnimationClip::BoneCount() const
+{
+	return Compressed != nullptr ? Compressed->BoneCount() : (UINT)BoneAnimations.size();
 }
 
 float AnimationClip::GetClipStartTime() const
 {
+	if (Compressed != nullptr)
+		return Compressed->GetStartTime();
+
 	float t = MathHelper::Infinity;
 	for (UINT i = 0; i < BoneAnimations.size(); ++i)
 	{
@@ -87,6 +167,9 @@ float AnimationClip::GetClipStartTime() const
 
 float AnimationClip::GetClipEndTime() const
 {
+	if (Compressed != nullptr)
+		return Compressed->GetEndTime();
+
 	float t = 0.0f;
 	for (UINT i = 0; i < BoneAnimations.size(); ++i)
 	{
@@ -97,12 +180,74 @@ float AnimationClip::GetClipEndTime() const
 
 void AnimationClip::Interpolate(float t, std::vector<XMFLOAT4X4>& boneTransforms) const
 {
+	Interpolate(t, boneTransforms.data(), nullptr);
+}
+
+void AnimationClip::Interpolate(float t, std::vector<XMFLOAT4X4>& boneTransforms, std::vector<UINT>& keyframeCursors) const
+{
+	keyframeCursors.resize(BoneCount(), 0);
+	Interpolate(t, boneTransforms.data(), keyframeCursors.data());
+}
+
+void AnimationClip::Interpolate(float t, XMFLOAT4X4* boneTransforms, UINT* keyframeCursors) const
+{
+	if (Compressed != nullptr)
+	{
+		for (UINT i = 0; i < Compressed->BoneCount(); ++i)
+		{
+			UINT cursor = 0;
+			LocalTransform x = SampleBone(*this, i, t, cursor);
+
+			XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+			XMStoreFloat4x4(&boneTransforms[i], XMMatrixAffineTransformation(x.S, zero, x.Q, x.P));
+		}
+		return;
+	}
+
 	for (UINT i = 0; i < BoneAnimations.size(); ++i)
 	{
-		BoneAnimations[i].Interpolate(t, boneTransforms[i]);
+		if (keyframeCursors != nullptr)
+			BoneAnimations[i].Interpolate(t, boneTransforms[i], keyframeCursors[i]);
+		else
+			BoneAnimations[i].Interpolate(t, boneTransforms[i]);
 	}
 }
 
+void AnimationClip::GetBoneKeys(UINT bone, float t, UINT& cursor, BoneKeyPair& keys) const
+{
+	if (Compressed != nullptr)
+	{
+		Compressed->GetBoneKeys(bone, t, keys);
+		return;
+	}
+
+	const Keyframe* k0 = nullptr;
+	const Keyframe* k1 = nullptr;
+	float lerpPercent = 0.0f;
+	BoneAnimations[bone].GetKeyframes(t, cursor, k0, k1, lerpPercent);
+
+	keys.Scale[0] = k0->Scale;
+	keys.Scale[1] = k1->Scale;
+	keys.Translation[0] = k0->Translation;
+	keys.Translation[1] = k1->Translation;
+	keys.RotationQuat[0] = k0->RotationQuat;
+	keys.RotationQuat[1] = k1->RotationQuat;
+	keys.ScaleLerp = lerpPercent;
+	keys.TranslationLerp = lerpPercent;
+	keys.RotationLerp = lerpPercent;
+}
+
+void AnimationClip::Compress(const AnimationCompressionSettings& settings)
+{
+	if (Compressed != nullptr)
+		return;
+
+	Compressed = std::make_shared<CompressedAnimation>(BoneAnimations, settings);
+
+	BoneAnimations.clear();
+	BoneAnimations.shrink_to_fit();
+}
+
 float SkinnedData::GetClipStartTime(const std::string& clipName) const
 {
 	auto clip = mAnimations.find(clipName);
@@ -120,6 +265,16 @@ UINT SkinnedData::BoneCount()const
 	return mBoneHierarchy.size();
 }
 
+const std::vector<int>& SkinnedData::BoneHierarchy() const
+{
+	return mBoneHierarchy;
+}
+
+const std::vector<XMFLOAT4X4>& SkinnedData::BoneOffsets() const
+{
+	return mBoneOffsets;
+}
+
 void SkinnedData::Set(std::vector<int>& boneHierarchy,
 	std::vector<XMFLOAT4X4>& boneOffsets,
 	std::unordered_map<std::string, AnimationClip>& animations
@@ -131,13 +286,142 @@ void SkinnedData::Set(std::vector<int>& boneHierarchy,
 
 void SkinnedData::GetFinalTransforms(const std::string& clipName, float timePos, std::vector<XMFLOAT4X4>& finalTransforms) const
 {
-	UINT numBones = mBoneOffsets.size();
-	std::vector<XMFLOAT4X4> toParentTransforms(numBones);
+	std::vector<UINT> keyframeCursors;
+	AnimationScratch scratch;
+	GetFinalTransforms(*FindClip(clipName), timePos, finalTransforms.data(), keyframeCursors, scratch);
+}
 
+void SkinnedData::GetFinalTransforms(const std::string& clipName, float timePos, std::vector<XMFLOAT4X4>& finalTransforms, std::vector<UINT>& keyframeCursors) const
+{
+	AnimationScratch scratch;
+	GetFinalTransforms(*FindClip(clipName), timePos, finalTransforms.data(), keyframeCursors, scratch);
+}
+
+void SkinnedData::CompressClips(const AnimationCompressionSettings& settings)
+{
+	for (auto& clip : mAnimations)
+	{
+		clip.second.Compress(settings);
+	}
+}
+
+const AnimationClip* SkinnedData::FindClip(const std::string& clipName) const
+{
 	auto clip = mAnimations.find(clipName);
-	clip->second.Interpolate(timePos, toParentTransforms);
+	return clip != mAnimations.end() ? &clip->second : nullptr;
+}
+
+const std::unordered_map<std::string, AnimationClip>& SkinnedData::AnimationClips() const
+{
+	return mAnimations;
+}
+
+void SkinnedData::GetFinalTransforms(const AnimationClip& clip, float timePos, XMFLOAT4X4* finalTransforms,
+	std::vector<UINT>& keyframeCursors, AnimationScratch& scratch) const
+{
+	UINT numBones = mBoneOffsets.size();
+
+	// No-ops after the first call with the same skeleton.
+	keyframeCursors.resize(numBones, 0);
+	scratch.ToParentTransforms.resize(numBones);
+	scratch.ToRootTransforms.resize(numBones);
+
+	clip.Interpolate(timePos, scratch.ToParentTransforms.data(), keyframeCursors.data());
+
+	ComposeFinalTransforms(scratch, finalTransforms);
+}
+
+void SkinnedData::GetFinalTransforms(const AnimationLayer* layers, UINT layerCount, XMFLOAT4X4* finalTransforms,
+	AnimationScratch& scratch) const
+{
+	UINT numBones = mBoneOffsets.size();
+
+	scratch.ToParentTransforms.resize(numBones);
+	scratch.ToRootTransforms.resize(numBones);
+
+	XMFLOAT4X4* toParentTransforms = scratch.ToParentTransforms.data();
+
+	const XMVECTOR one = XMVectorSplatOne();
+	const XMVECTOR identity = XMQuaternionIdentity();
+	const XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+
+	for (UINT i = 0; i < numBones; ++i)
+	{
+		LocalTransform pose = { one, identity, XMVectorZero() };
+
+		for (UINT l = 0; l < layerCount; ++l)
+		{
+			const AnimationLayer& layer = layers[l];
+
+			float weight = 1.0f;
+			if (l > 0)
+			{
+				weight = layer.Weight;
+				if (layer.BoneMask != nullptr)
+					weight *= layer.BoneMask[i];
+			}
+
+			// Masked-out bones skip the keyframe lookup altogether.
+			if (weight <= 0.0f)
+				continue;
+
+			UINT localCursor = 0;
+			UINT& cursor = layer.KeyframeCursors != nullptr ? layer.KeyframeCursors[i] : localCursor;
+			LocalTransform sample = SampleBone(*layer.Clip, i, layer.TimePos, cursor);
+
+			if (layer.BlendMode == AnimationBlendMode::Additive)
+			{
+				UINT referenceCursor = 0;
+				LocalTransform reference = SampleBone(*layer.Clip, i, layer.AdditiveReferenceTime, referenceCursor);
+
+				// The clip's motion away from the reference pose: undo the reference
+				// rotation, then apply the sampled one.
+				XMVECTOR deltaQ = XMQuaternionMultiply(XMQuaternionConjugate(reference.Q), sample.Q);
+
+				pose.S = XMVectorMultiply(pose.S, XMVectorLerp(one, XMVectorDivide(sample.S, reference.S), weight));
+				pose.Q = XMQuaternionMultiply(pose.Q, XMQuaternionSlerp(identity, deltaQ, weight));
+				pose.P = XMVectorAdd(pose.P, XMVectorScale(XMVectorSubtract(sample.P, reference.P), weight));
+			}
+			else if (weight >= 1.0f)
+			{
+				pose = sample;
+			}
+			else
+			{
+				pose.S = XMVectorLerp(pose.S, sample.S, weight);
+				pose.Q = XMQuaternionSlerp(pose.Q, sample.Q, weight);
+				pose.P = XMVectorLerp(pose.P, sample.P, weight);
+			}
+		}
+
+		XMStoreFloat4x4(&toParentTransforms[i], XMMatrixAffineTransformation(pose.S, zero, pose.Q, pose.P));
+	}
+
+	ComposeFinalTransforms(scratch, finalTransforms);
+}
+
+void SkinnedData::GetBoneMask(UINT rootBone, std::vector<float>& boneMask) const
+{
+	UINT numBones = mBoneHierarchy.size();
+	boneMask.assign(numBones, 0.0f);
+	boneMask[rootBone] = 1.0f;
+
+	// Parents come before their children (the hierarchy pass relies on it too), so
+	// one forward sweep reaches the whole subtree.
+	for (UINT i = rootBone + 1; i < numBones; ++i)
+	{
+		int parentIndex = mBoneHierarchy[i];
+		if (parentIndex >= 0)
+			boneMask[i] = boneMask[parentIndex];
+	}
+}
+
+void SkinnedData::ComposeFinalTransforms(AnimationScratch& scratch, XMFLOAT4X4* finalTransforms) const
+{
+	UINT numBones = mBoneOffsets.size();
 
-	std::vector<XMFLOAT4X4> toRootTransforms(numBones);
+	XMFLOAT4X4* toParentTransforms = scratch.ToParentTransforms.data();
+	XMFLOAT4X4* toRootTransforms = scratch.ToRootTransforms.data();
 
 	toRootTransforms[0] = toParentTransforms[0];
 
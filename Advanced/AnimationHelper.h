@@ -1,6 +1,15 @@
 #pragma once
 
-#include "Common/d3dUtil.h"
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Common/MathHelper.h"
+
+
+struct AnimationCompressionSettings;
+class CompressedAnimation;
 
 
 struct Keyframe
@@ -22,18 +31,105 @@ struct BoneAnimation
 
 	void Interpolate(float t, DirectX::XMFLOAT4X4& M) const;
 
+	// Same as above, but starts the keyframe search from cursor (the interval used by
+	// the previous call) and updates it, so steady playback finds its keyframes in
+	// O(1).  Keep one cursor per bone per animated instance; 0 is a valid start.
+	void Interpolate(float t, DirectX::XMFLOAT4X4& M, UINT& cursor) const;
+
+	// The keyframes Interpolate blends at time t and the blend factor between them.
+	// Outside the animation both point at the first (or last) keyframe.
+	void GetKeyframes(float t, UINT& cursor, const Keyframe*& k0, const Keyframe*& k1, float& lerpPercent) const;
+
 	std::vector<Keyframe> Keyframes;
+
+private:
+	// Index i such that Keyframes[i].TimePos < t <= Keyframes[i+1].TimePos, for t
+	// strictly inside the animation.
+	UINT FindKeyframe(float t, UINT hint) const;
+};
+
+
+// The keys of one bone that bracket a point in time: for each of its scale, translation
+// and rotation tracks the key before and after, and how far between them the time is.
+struct BoneKeyPair
+{
+	DirectX::XMFLOAT3 Scale[2];
+	DirectX::XMFLOAT3 Translation[2];
+	DirectX::XMFLOAT4 RotationQuat[2];
+	float ScaleLerp;
+	float TranslationLerp;
+	float RotationLerp;
 };
 
 
 struct AnimationClip
 {
+	UINT BoneCount() const;
+
 	float GetClipStartTime() const;
 	float GetClipEndTime() const;
 
 	void Interpolate(float t, std::vector<DirectX::XMFLOAT4X4>& boneTransforms) const;
+	void Interpolate(float t, std::vector<DirectX::XMFLOAT4X4>& boneTransforms, std::vector<UINT>& keyframeCursors) const;
+
+	// Writes one transform per bone animation; keyframeCursors may be null.
+	void Interpolate(float t, DirectX::XMFLOAT4X4* boneTransforms, UINT* keyframeCursors) const;
+
+	// The keys bone blends at time t.  cursor is the bone's keyframe cursor; compressed
+	// clips search their (much shorter) tracks directly and leave it alone.
+	void GetBoneKeys(UINT bone, float t, UINT& cursor, BoneKeyPair& keys) const;
+
+	// Replaces BoneAnimations with a compressed copy of the clip (see
+	// AnimationCompression.h).  Sampling decompresses on the fly from then on.
+	void Compress(const AnimationCompressionSettings& settings);
 
 	std::vector<BoneAnimation> BoneAnimations;
+
+	// Set by Compress, which leaves BoneAnimations empty.
+	std::shared_ptr<const CompressedAnimation> Compressed;
+};
+
+
+// Working memory for SkinnedData::GetFinalTransforms.  The vectors grow to the bone
+// count on first use and are only reused after that, so a caller that keeps one
+// (per instance, or per worker thread) evaluates poses without touching the heap.
+struct AnimationScratch
+{
+	std::vector<DirectX::XMFLOAT4X4> ToParentTransforms;
+	std::vector<DirectX::XMFLOAT4X4> ToRootTransforms;
+};
+
+
+enum class AnimationBlendMode
+{
+	// Blends the pose of the layers below toward this clip's pose by the layer weight.
+	Override,
+
+	// Adds how far this clip has moved from its pose at AdditiveReferenceTime, scaled
+	// by the layer weight, on top of the layers below (a lean, a breathing cycle...).
+	Additive
+};
+
+
+// One clip in a layered pose (see SkinnedData::GetFinalTransforms).  Layers apply
+// bottom to top; the bottom layer is always taken at full weight.
+struct AnimationLayer
+{
+	const AnimationClip* Clip = nullptr;
+	float TimePos = 0.0f;
+	float Weight = 1.0f;
+	AnimationBlendMode BlendMode = AnimationBlendMode::Override;
+
+	// Per-bone factors on Weight (BoneCount() entries), e.g. from
+	// SkinnedData::GetBoneMask; null applies the layer to the whole skeleton.
+	const float* BoneMask = nullptr;
+
+	// Additive layers only.
+	float AdditiveReferenceTime = 0.0f;
+
+	// Per-instance keyframe cursors for this layer's clip (BoneCount() entries, see
+	// BoneAnimation::Interpolate); may be null.
+	UINT* KeyframeCursors = nullptr;
 };
 
 
@@ -42,6 +138,9 @@ class SkinnedData
 public:
 	UINT BoneCount() const;
 
+	const std::vector<int>& BoneHierarchy() const;
+	const std::vector<DirectX::XMFLOAT4X4>& BoneOffsets() const;
+
 	float GetClipStartTime(const std::string& clipName) const;
 	float GetClipEndTime(const std::string& clipName) const;
 
@@ -51,8 +150,41 @@ public:
 		std::unordered_map<std::string, AnimationClip>& animations
 	);
 
+	// Compresses every clip in place; clip handles stay valid.
+	void CompressClips(const AnimationCompressionSettings& settings);
+
 	void GetFinalTransforms(const std::string& clipName, float timePos, std::vector<DirectX::XMFLOAT4X4>& finalTransforms) const;
 
+	// keyframeCursors is per-instance state (one entry per bone) that speeds up the
+	// keyframe lookup for an instance whose time advances smoothly.
+	void GetFinalTransforms(const std::string& clipName, float timePos, std::vector<DirectX::XMFLOAT4X4>& finalTransforms, std::vector<UINT>& keyframeCursors) const;
+
+	// Looks a clip up by name so per-frame code can skip the string hash.  The
+	// handle stays valid until the next Set(); nullptr if there is no such clip.
+	const AnimationClip* FindClip(const std::string& clipName) const;
+
+	const std::unordered_map<std::string, AnimationClip>& AnimationClips() const;
+
+	// Writes BoneCount() transposed final transforms to finalTransforms.  Once
+	// keyframeCursors and scratch have been sized by a first call this does not
+	// allocate.
+	void GetFinalTransforms(const AnimationClip& clip, float timePos, DirectX::XMFLOAT4X4* finalTransforms,
+		std::vector<UINT>& keyframeCursors, AnimationScratch& scratch) const;
+
+	// Blends the layers bone by bone in local (to-parent) space, where rotations can
+	// be slerped, and then walks the hierarchy once, so a crossfade or an upper-body
+	// layer costs about one extra keyframe sample per bone rather than another
+	// GetFinalTransforms.  Does not allocate once scratch has been sized.
+	void GetFinalTransforms(const AnimationLayer* layers, UINT layerCount, DirectX::XMFLOAT4X4* finalTransforms,
+		AnimationScratch& scratch) const;
+
+	// Fills boneMask with 1 for rootBone and every bone below it and 0 elsewhere.
+	void GetBoneMask(UINT rootBone, std::vector<float>& boneMask) const;
+
+private:
+	// toParentTransforms -> transposed final transforms.
+	void ComposeFinalTransforms(AnimationScratch& scratch, DirectX::XMFLOAT4X4* finalTransforms) const;
+
 private:
 	// Gives parentIndex of ith bone.
 	std::vector<int> mBoneHierarchy;
@@ -0,0 +1,28 @@
+#include "AnimationStage.h"
+#include "Common/ThreadPool.h"
+
+namespace
+{
+	// SIMD groups per chunk.  A soldier-sized skeleton takes a few microseconds per
+	// group, so smaller chunks would spend a noticeable share on scheduling.
+	constexpr UINT GroupsPerChunk = 4;
+}
+
+void AnimationStage::Run(const SkinnedData& skinnedData, const PoseRequest* requests, UINT requestCount)
+{
+	const UINT chunkSize = GroupsPerChunk * PoseBatch::GroupSize();
+	const UINT chunkCount = (requestCount + chunkSize - 1) / chunkSize;
+
+	if (mChunkBatches.size() < chunkCount)
+		mChunkBatches.resize(chunkCount);
+
+	ParallelFor(0, (int)chunkCount, 1, [&](int first, int last)
+		{
+			for (int chunk = first; chunk < last; ++chunk)
+			{
+				UINT begin = chunk * chunkSize;
+				UINT count = MathHelper::Min(requestCount - begin, chunkSize);
+				mChunkBatches[chunk].Evaluate(skinnedData, requests + begin, count);
+			}
+		});
+}
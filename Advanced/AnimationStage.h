@@ -0,0 +1,21 @@
+#pragma once
+
+#include "PoseBatch.h"
+
+
+// Poses every character that shares a skeleton as one job: the requests are cut into
+// fixed chunks of whole SIMD groups and the chunks are spread over the task scheduler
+// (see Common/ThreadPool.h).  Run returns only when every palette has been written,
+// which is the join the renderer waits on before recording draws.
+//
+// Each chunk always covers the same requests and owns its PoseBatch, so results do
+// not depend on the number of threads or on which thread ran which chunk, and
+// requests may point FinalTransforms straight into mapped upload memory.
+class AnimationStage
+{
+public:
+	void Run(const SkinnedData& skinnedData, const PoseRequest* requests, UINT requestCount);
+
+private:
+	std::vector<PoseBatch> mChunkBatches;
+};
@@ -1,8 +1,48 @@
 #include "LoadM3d.h"
+#include "M3dBinary.h"
 
 using namespace DirectX;
 
 
+namespace
+{
+	template<typename V>
+	MeshOptimizationStats OptimizeSubsets(std::vector<V>& vertices, std::vector<USHORT>& indices,
+		const std::vector<M3DLoader::Subset>& subsets)
+	{
+		MeshOptimizationStats stats;
+		std::vector<std::uint32_t> subsetIndices;
+		std::vector<std::uint32_t> remap;
+
+		for (const M3DLoader::Subset& subset : subsets)
+		{
+			const std::size_t first = 3 * (std::size_t)subset.FaceStart;
+			const std::size_t count = 3 * (std::size_t)subset.FaceCount;
+			if (subset.VertexCount == 0 || first + count > indices.size() ||
+				(std::size_t)subset.VertexStart + subset.VertexCount > vertices.size())
+			{
+				continue;
+			}
+
+			// The indices are absolute, so rebase them on the subset's vertices.  A subset
+			// that uses vertices outside its own range comes back unchanged.
+			subsetIndices.resize(count);
+			for (std::size_t i = 0; i < count; ++i)
+				subsetIndices[i] = (std::uint32_t)indices[first + i] - subset.VertexStart;
+
+			stats += OptimizeMeshIndices(subsetIndices.data(), count,
+				&vertices[subset.VertexStart].Pos, sizeof(V), subset.VertexCount, remap);
+			RemapVertices(vertices.data() + subset.VertexStart, subset.VertexCount, remap);
+
+			for (std::size_t i = 0; i < count; ++i)
+				indices[first + i] = (USHORT)(subsetIndices[i] + subset.VertexStart);
+		}
+
+		return stats;
+	}
+}
+
+
 bool M3DLoader::LoadM3d(
 	const std::string& filename,
 	std::vector<Vertex>& vertices,
@@ -10,7 +50,8 @@ bool M3DLoader::LoadM3d(
 	std::vector<Subset>& subsets,
 	std::vector<M3dMaterial>& mats
 ) {
-	std::ifstream fin(filename);
+	TextTokenizer fin;
+	fin.Open(filename);
 
 	UINT numMaterials = 0;
 	UINT numVertices = 0;
@@ -18,22 +59,22 @@ bool M3DLoader::LoadM3d(
 	UINT numBones = 0;
 	UINT numAnimationClips = 0;
 
-	std::string ignore;
-
 	if (fin)
 	{
-		fin >> ignore;	// file header text
-		fin >> ignore >> numMaterials;
-		fin >> ignore >> numVertices;
-		fin >> ignore >> numTriangles;
-		fin >> ignore >> numBones;
-		fin >> ignore >> numAnimationClips;
+		fin.Skip();	// file header text
+		fin.Skip() >> numMaterials;
+		fin.Skip() >> numVertices;
+		fin.Skip() >> numTriangles;
+		fin.Skip() >> numBones;
+		fin.Skip() >> numAnimationClips;
 
 		ReadMaterials(fin, numMaterials, mats);
 		ReadSubsetTable(fin, numMaterials, subsets);
 		ReadVertices(fin, numVertices, vertices);
 		ReadTriangles(fin, numTriangles, indices);
 
+		mOptimizationStats = OptimizeSubsets(vertices, indices, subsets);
+
 		return true;
 	}
 	return false;
@@ -46,7 +87,8 @@ bool M3DLoader::LoadM3d(const std::string& filename,
 	std::vector<M3dMaterial>& mats,
 	SkinnedData& skinInfo
 ) {
-	std::ifstream fin(filename);
+	TextTokenizer fin;
+	fin.Open(filename);
 
 	UINT numMaterials = 0;
 	UINT numVertices = 0;
@@ -54,16 +96,14 @@ bool M3DLoader::LoadM3d(const std::string& filename,
 	UINT numBones = 0;
 	UINT numAnimationClips = 0;
 
-	std::string ignore;
-
 	if (fin)
 	{
-		fin >> ignore;	// file header text
-		fin >> ignore >> numMaterials;
-		fin >> ignore >> numVertices;
-		fin >> ignore >> numTriangles;
-		fin >> ignore >> numBones;
-		fin >> ignore >> numAnimationClips;
+		fin.Skip();	// file header text
+		fin.Skip() >> numMaterials;
+		fin.Skip() >> numVertices;
+		fin.Skip() >> numTriangles;
+		fin.Skip() >> numBones;
+		fin.Skip() >> numAnimationClips;
 
 		std::vector<XMFLOAT4X4> boneOffsets;
 		std::vector<int> boneIndexToParentIndex;
@@ -73,6 +113,8 @@ bool M3DLoader::LoadM3d(const std::string& filename,
 		ReadSubsetTable(fin, numMaterials, subsets);
 		ReadSkinnedVertices(fin, numVertices, vertices);
 		ReadTriangles(fin, numTriangles, indices);
+
+		mOptimizationStats = OptimizeSubsets(vertices, indices, subsets);
 		ReadBoneOffsets(fin, numBones, boneOffsets);
 		ReadBoneHierarchy(fin, numBones, boneIndexToParentIndex);
 		ReadAnimationClips(fin, numBones, numAnimationClips, animations);
@@ -84,76 +126,111 @@ bool M3DLoader::LoadM3d(const std::string& filename,
 	return false;
 }
 
-void M3DLoader::ReadMaterials(std::ifstream& fin, UINT numMaterials, std::vector<M3dMaterial>& mats)
+bool M3DLoader::LoadM3db(
+	const std::string& filename,
+	std::vector<Vertex>& vertices,
+	std::vector<USHORT>& indices,
+	std::vector<Subset>& subsets,
+	std::vector<M3dMaterial>& mats
+) {
+	M3dBinary file;
+	if (!file.Open(filename) || file.IsSkinned())
+		return false;
+
+	vertices = file.Vertices().ToVector();
+	indices = file.Indices().ToVector();
+	subsets = file.Subsets().ToVector();
+	file.GetMaterials(mats);
+
+	return true;
+}
+
+bool M3DLoader::LoadM3db(const std::string& filename,
+	std::vector<SkinnedVertex>& vertices,
+	std::vector<USHORT>& indices,
+	std::vector<Subset>& subsets,
+	std::vector<M3dMaterial>& mats,
+	SkinnedData& skinInfo
+) {
+	M3dBinary file;
+	if (!file.Open(filename) || !file.IsSkinned())
+		return false;
+
+	vertices = file.SkinnedVertices().ToVector();
+	indices = file.Indices().ToVector();
+	subsets = file.Subsets().ToVector();
+	file.GetMaterials(mats);
+	file.GetSkinnedData(skinInfo);
+
+	return true;
+}
+
+void M3DLoader::ReadMaterials(TextTokenizer& fin, UINT numMaterials, std::vector<M3dMaterial>& mats)
 {
-	std::string ignore;
 	mats.resize(numMaterials);
 
 	std::string diffuseMapName;
 	std::string normalMapName;
 
-	fin >> ignore;	// materials header text
+	fin.Skip();	// materials header text
 	for (UINT i = 0; i < numMaterials; ++i)
 	{
-		fin >> ignore >> mats[i].Name;
-		fin >> ignore >> mats[i].DiffuseAlbedo.x >> mats[i].DiffuseAlbedo.y >> mats[i].DiffuseAlbedo.z;
-		fin >> ignore >> mats[i].FresnelR0.x >> mats[i].FresnelR0.y >> mats[i].FresnelR0.z;
-		fin >> ignore >> mats[i].Roughness;
-		fin >> ignore >> mats[i].AlphaClip;
-		fin >> ignore >> mats[i].MaterialTypeName;
-		fin >> ignore >> mats[i].DiffuseMapName;
-		fin >> ignore >> mats[i].NormalMapName;
+		fin.Skip() >> mats[i].Name;
+		fin.Skip() >> mats[i].DiffuseAlbedo.x >> mats[i].DiffuseAlbedo.y >> mats[i].DiffuseAlbedo.z;
+		fin.Skip() >> mats[i].FresnelR0.x >> mats[i].FresnelR0.y >> mats[i].FresnelR0.z;
+		fin.Skip() >> mats[i].Roughness;
+		fin.Skip() >> mats[i].AlphaClip;
+		fin.Skip() >> mats[i].MaterialTypeName;
+		fin.Skip() >> mats[i].DiffuseMapName;
+		fin.Skip() >> mats[i].NormalMapName;
 	}
 }
 
-void M3DLoader::ReadSubsetTable(std::ifstream& fin, UINT numSubsets, std::vector<Subset>& subsets)
+void M3DLoader::ReadSubsetTable(TextTokenizer& fin, UINT numSubsets, std::vector<Subset>& subsets)
 {
-	std::string ignore;
 	subsets.resize(numSubsets);
 
-	fin >> ignore;	// subset header text
+	fin.Skip();	// subset header text
 	for (UINT i = 0; i < numSubsets; ++i)
 	{
-		fin >> ignore >> subsets[i].Id;
-		fin >> ignore >> subsets[i].VertexStart;
-		fin >> ignore >> subsets[i].VertexCount;
-		fin >> ignore >> subsets[i].FaceStart;
-		fin >> ignore >> subsets[i].FaceCount;
+		fin.Skip() >> subsets[i].Id;
+		fin.Skip() >> subsets[i].VertexStart;
+		fin.Skip() >> subsets[i].VertexCount;
+		fin.Skip() >> subsets[i].FaceStart;
+		fin.Skip() >> subsets[i].FaceCount;
 	}
 }
 
-void M3DLoader::ReadVertices(std::ifstream& fin, UINT numVertices, std::vector<Vertex>& vertices)
+void M3DLoader::ReadVertices(TextTokenizer& fin, UINT numVertices, std::vector<Vertex>& vertices)
 {
-	std::string ignore;
 	vertices.resize(numVertices);
 
-	fin >> ignore;	// vertices header text
+	fin.Skip();	// vertices header text
 	for (UINT i = 0; i < numVertices; ++i)
 	{
-		fin >> ignore >> vertices[i].Pos.x >> vertices[i].Pos.y >> vertices[i].Pos.z;
-		fin >> ignore >> vertices[i].TangentU.x >> vertices[i].TangentU.y >> vertices[i].TangentU.z >> vertices[i].TangentU.w;
-		fin >> ignore >> vertices[i].Normal.x >> vertices[i].Normal.y >> vertices[i].Normal.z;
-		fin >> ignore >> vertices[i].TexC.x >> vertices[i].TexC.y;
+		fin.Skip() >> vertices[i].Pos.x >> vertices[i].Pos.y >> vertices[i].Pos.z;
+		fin.Skip() >> vertices[i].TangentU.x >> vertices[i].TangentU.y >> vertices[i].TangentU.z >> vertices[i].TangentU.w;
+		fin.Skip() >> vertices[i].Normal.x >> vertices[i].Normal.y >> vertices[i].Normal.z;
+		fin.Skip() >> vertices[i].TexC.x >> vertices[i].TexC.y;
 	}
 }
 
-void M3DLoader::ReadSkinnedVertices(std::ifstream& fin, UINT numVertices, std::vector<SkinnedVertex>& vertices)
+void M3DLoader::ReadSkinnedVertices(TextTokenizer& fin, UINT numVertices, std::vector<SkinnedVertex>& vertices)
 {
-	std::string ignore;
 	vertices.resize(numVertices);
 
-	fin >> ignore;	// vertices header text
+	fin.Skip();	// vertices header text
 	int boneIndices[4];
 	float weights[4];
 	for (UINT i = 0; i < numVertices; ++i)
 	{
 		float blah;
-		fin >> ignore >> vertices[i].Pos.x >> vertices[i].Pos.y >> vertices[i].Pos.z;
-		fin >> ignore >> vertices[i].TangentU.x >> vertices[i].TangentU.y >> vertices[i].TangentU.z >> blah /*vertices[i].TangentU.w*/;
-		fin >> ignore >> vertices[i].Normal.x >> vertices[i].Normal.y >> vertices[i].Normal.z;
-		fin >> ignore >> vertices[i].TexC.x >> vertices[i].TexC.y;
-		fin >> ignore >> weights[0] >> weights[1] >> weights[2] >> weights[3];
-		fin >> ignore >> boneIndices[0] >> boneIndices[1] >> boneIndices[2] >> boneIndices[3];
+		fin.Skip() >> vertices[i].Pos.x >> vertices[i].Pos.y >> vertices[i].Pos.z;
+		fin.Skip() >> vertices[i].TangentU.x >> vertices[i].TangentU.y >> vertices[i].TangentU.z >> blah /*vertices[i].TangentU.w*/;
+		fin.Skip() >> vertices[i].Normal.x >> vertices[i].Normal.y >> vertices[i].Normal.z;
+		fin.Skip() >> vertices[i].TexC.x >> vertices[i].TexC.y;
+		fin.Skip() >> weights[0] >> weights[1] >> weights[2] >> weights[3];
+		fin.Skip() >> boneIndices[0] >> boneIndices[1] >> boneIndices[2] >> boneIndices[3];
 
 		vertices[i].BoneWeights.x = weights[0];
 		vertices[i].BoneWeights.y = weights[1];
@@ -166,27 +243,25 @@ void M3DLoader::ReadSkinnedVertices(std::ifstream& fin, UINT numVertices, std::v
 	}
 }
 
-void M3DLoader::ReadTriangles(std::ifstream& fin, UINT numTriangles, std::vector<USHORT>& indices)
+void M3DLoader::ReadTriangles(TextTokenizer& fin, UINT numTriangles, std::vector<USHORT>& indices)
 {
-	std::string ignore;
 	indices.resize(numTriangles * 3);
 
-	fin >> ignore;	// triangles header text
+	fin.Skip();	// triangles header text
 	for (UINT i = 0; i < numTriangles; ++i)
 	{
 		fin >> indices[i * 3 + 0] >> indices[i * 3 + 1] >> indices[i * 3 + 2];
 	}
 }
 
-void M3DLoader::ReadBoneOffsets(std::ifstream& fin, UINT numBones, std::vector<XMFLOAT4X4>& boneOffsets)
+void M3DLoader::ReadBoneOffsets(TextTokenizer& fin, UINT numBones, std::vector<XMFLOAT4X4>& boneOffsets)
 {
-	std::string ignore;
 	boneOffsets.resize(numBones);
 
-	fin >> ignore;	// BoneOffsets header text
+	fin.Skip();	// BoneOffsets header text
 	for (UINT i = 0; i < numBones; ++i)
 	{
-		fin >> ignore >>
+		fin.Skip() >>
 			boneOffsets[i](0, 0) >> boneOffsets[i](0, 1) >> boneOffsets[i](0, 2) >> boneOffsets[i](0, 3) >>
 			boneOffsets[i](1, 0) >> boneOffsets[i](1, 1) >> boneOffsets[i](1, 2) >> boneOffsets[i](1, 3) >>
 			boneOffsets[i](2, 0) >> boneOffsets[i](2, 1) >> boneOffsets[i](2, 2) >> boneOffsets[i](2, 3) >>
@@ -194,27 +269,25 @@ void M3DLoader::ReadBoneOffsets(std::ifstream& fin, UINT numBones, std::vector<X
 	}
 }
 
-void M3DLoader::ReadBoneHierarchy(std::ifstream& fin, UINT numBones, std::vector<int>& boneIndexToParentIndex)
+void M3DLoader::ReadBoneHierarchy(TextTokenizer& fin, UINT numBones, std::vector<int>& boneIndexToParentIndex)
 {
-	std::string ignore;
 	boneIndexToParentIndex.resize(numBones);
 
-	fin >> ignore; // BoneHierarchy header text
+	fin.Skip(); // BoneHierarchy header text
 	for (UINT i = 0; i < numBones; ++i)
 	{
-		fin >> ignore >> boneIndexToParentIndex[i];
+		fin.Skip() >> boneIndexToParentIndex[i];
 	}
 }
 
-void M3DLoader::ReadAnimationClips(std::ifstream& fin, UINT numBones, UINT numAnimationClips, std::unordered_map<std::string, AnimationClip>& animations)
+void M3DLoader::ReadAnimationClips(TextTokenizer& fin, UINT numBones, UINT numAnimationClips, std::unordered_map<std::string, AnimationClip>& animations)
 {
-	std::string ignore;
-	fin >> ignore;	// AnimationClips header text
+	fin.Skip();	// AnimationClips header text
 	for (UINT clipIndex = 0; clipIndex < numAnimationClips; ++clipIndex)
 	{
 		std::string clipName;
-		fin >> ignore >> clipName;
-		fin >> ignore;
+		fin.Skip() >> clipName;
+		fin.Skip();
 
 		AnimationClip clip;
 		clip.BoneAnimations.resize(numBones);
@@ -223,18 +296,17 @@ void M3DLoader::ReadAnimationClips(std::ifstream& fin, UINT numBones, UINT numAn
 		{
 			ReadBoneKeyframes(fin, numBones, clip.BoneAnimations[boneIndex]);
 		}
-		fin >> ignore;
+		fin.Skip();
 
 		animations[clipName] = clip;
 	}
 }
 
-void M3DLoader::ReadBoneKeyframes(std::ifstream& fin, UINT numBones, BoneAnimation& boneAnimation)
+void M3DLoader::ReadBoneKeyframes(TextTokenizer& fin, UINT numBones, BoneAnimation& boneAnimation)
 {
-	std::string ignore;
 	UINT numKeyframes = 0;
-	fin >> ignore >> ignore >> numKeyframes;
-	fin >> ignore;
+	fin.Skip(2) >> numKeyframes;
+	fin.Skip();
 
 	boneAnimation.Keyframes.resize(numKeyframes);
 	for (UINT i = 0; i < numKeyframes; ++i)
@@ -243,10 +315,10 @@ void M3DLoader::ReadBoneKeyframes(std::ifstream& fin, UINT numBones, BoneAnimati
 		XMFLOAT3 p(0.0f, 0.0f, 0.0f);
 		XMFLOAT3 s(1.0f, 1.0f, 1.0f);
 		XMFLOAT4 q(0.0f, 0.0f, 0.0f, 1.0f);
-		fin >> ignore >> t;
-		fin >> ignore >> p.x >> p.y >> p.z;
-		fin >> ignore >> s.x >> s.y >> s.z;
-		fin >> ignore >> q.x >> q.y >> q.z >> q.w;
+		fin.Skip() >> t;
+		fin.Skip() >> p.x >> p.y >> p.z;
+		fin.Skip() >> s.x >> s.y >> s.z;
+		fin.Skip() >> q.x >> q.y >> q.z >> q.w;
 
 		boneAnimation.Keyframes[i].TimePos = t;
 		boneAnimation.Keyframes[i].Translation = p;
@@ -254,5 +326,5 @@ void M3DLoader::ReadBoneKeyframes(std::ifstream& fin, UINT numBones, BoneAnimati
 		boneAnimation.Keyframes[i].RotationQuat = q;
 	}
 
-	fin >> ignore;
+	fin.Skip();
 }
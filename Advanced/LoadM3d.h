@@ -1,6 +1,8 @@
 #pragma once
 
 #include "AnimationHelper.h"
+#include "Common/MeshOptimizer.h"
+#include "Common/TextTokenizer.h"
 
 
 class M3DLoader
@@ -60,14 +62,38 @@ public:
 		std::vector<M3dMaterial>& mats,
 		SkinnedData& skinInfo);
 
+	// The same for an .m3db made by the ModelConverter tool: the file is mapped and
+	// every array is copied out in one go instead of being parsed (see M3dBinary.h to
+	// use the mapped data directly).  Fails on a file of the other kind (static or
+	// skinned).
+	bool LoadM3db(const std::string& filename,
+		std::vector<Vertex>& vertices,
+		std::vector<USHORT>& indices,
+		std::vector<Subset>& subsets,
+		std::vector<M3dMaterial>& mats);
+
+	bool LoadM3db(const std::string& filename,
+		std::vector<SkinnedVertex>& vertices,
+		std::vector<USHORT>& indices,
+		std::vector<Subset>& subsets,
+		std::vector<M3dMaterial>& mats,
+		SkinnedData& skinInfo);
+
+	// LoadM3d reorders each subset's triangles and vertices for the GPU (see
+	// Common/MeshOptimizer.h); these are the cache misses before and after, over all
+	// subsets of the last file loaded.
+	const MeshOptimizationStats& OptimizationStats() const { return mOptimizationStats; }
+
 private:
-	void ReadMaterials(std::ifstream& fin, UINT numMaterials, std::vector<M3dMaterial>& mats);
-	void ReadSubsetTable(std::ifstream& fin, UINT numSubsets, std::vector<Subset>& subsets);
-	void ReadVertices(std::ifstream& fin, UINT numVertices, std::vector<Vertex>& vertices);
-	void ReadSkinnedVertices(std::ifstream& fin, UINT numVertices, std::vector<SkinnedVertex>& vertices);
-	void ReadTriangles(std::ifstream& fin, UINT numTriangles, std::vector<USHORT>& indices);
-	void ReadBoneOffsets(std::ifstream& fin, UINT numBones, std::vector<DirectX::XMFLOAT4X4>& boneOffsets);
-	void ReadBoneHierarchy(std::ifstream& fin, UINT numBones, std::vector<int>& boneIndexToParentIndex);
-	void ReadAnimationClips(std::ifstream& fin, UINT numBones, UINT numAnimationClips, std::unordered_map<std::string, AnimationClip>& animations);
-	void ReadBoneKeyframes(std::ifstream& fin, UINT numBones, BoneAnimation& boneAnimation);
+	void ReadMaterials(TextTokenizer& fin, UINT numMaterials, std::vector<M3dMaterial>& mats);
+	void ReadSubsetTable(TextTokenizer& fin, UINT numSubsets, std::vector<Subset>& subsets);
+	void ReadVertices(TextTokenizer& fin, UINT numVertices, std::vector<Vertex>& vertices);
+	void ReadSkinnedVertices(TextTokenizer& fin, UINT numVertices, std::vector<SkinnedVertex>& vertices);
+	void ReadTriangles(TextTokenizer& fin, UINT numTriangles, std::vector<USHORT>& indices);
+	void ReadBoneOffsets(TextTokenizer& fin, UINT numBones, std::vector<DirectX::XMFLOAT4X4>& boneOffsets);
+	void ReadBoneHierarchy(TextTokenizer& fin, UINT numBones, std::vector<int>& boneIndexToParentIndex);
+	void ReadAnimationClips(TextTokenizer& fin, UINT numBones, UINT numAnimationClips, std::unordered_map<std::string, AnimationClip>& animations);
+	void ReadBoneKeyframes(TextTokenizer& fin, UINT numBones, BoneAnimation& boneAnimation);
+
+	MeshOptimizationStats mOptimizationStats;
 };
@@ -0,0 +1,280 @@
+#include "M3dBinary.h"
+
+#include <algorithm>
+
+using namespace DirectX;
+
+
+namespace
+{
+	const UINT MaterialChunk = MakeChunkId('M', 'A', 'T', 'L');
+	const UINT SubsetChunk = MakeChunkId('S', 'U', 'B', 'S');
+	const UINT VertexChunk = MakeChunkId('V', 'E', 'R', 'T');
+	const UINT SkinnedVertexChunk = MakeChunkId('S', 'V', 'R', 'T');
+	const UINT IndexChunk = MakeChunkId('I', 'D', 'X', '2');
+	const UINT BoneOffsetChunk = MakeChunkId('B', 'O', 'F', 'S');
+	const UINT BoneHierarchyChunk = MakeChunkId('B', 'H', 'I', 'E');
+	const UINT ClipChunk = MakeChunkId('C', 'L', 'I', 'P');
+	const UINT TrackChunk = MakeChunkId('T', 'R', 'A', 'K');
+	const UINT KeyframeChunk = MakeChunkId('K', 'E', 'Y', 'S');
+	const UINT StringChunk = MakeChunkId('S', 'T', 'R', 'S');
+
+	static_assert(sizeof(M3dBinary::KeyframeRecord) == sizeof(Keyframe), "KeyframeRecord must mirror Keyframe");
+
+	class StringTable
+	{
+	public:
+		UINT Add(const std::string& s)
+		{
+			UINT offset = (UINT)mChars.size();
+			mChars.insert(mChars.end(), s.begin(), s.end());
+			mChars.push_back('\0');
+			return offset;
+		}
+
+		const std::vector<char>& Chars() const { return mChars; }
+
+	private:
+		std::vector<char> mChars;
+	};
+}
+
+bool M3dBinary::Open(const std::string& filename)
+{
+	Close();
+
+	if (!mFile.Open(filename, Magic, Version))
+		return false;
+
+	mVertices = mFile.Chunk<M3DLoader::Vertex>(VertexChunk);
+	mSkinnedVertices = mFile.Chunk<M3DLoader::SkinnedVertex>(SkinnedVertexChunk);
+	mIndices = mFile.Chunk<USHORT>(IndexChunk);
+	mSubsets = mFile.Chunk<M3DLoader::Subset>(SubsetChunk);
+	mMaterials = mFile.Chunk<MaterialRecord>(MaterialChunk);
+	mBoneOffsets = mFile.Chunk<XMFLOAT4X4>(BoneOffsetChunk);
+	mBoneHierarchy = mFile.Chunk<int>(BoneHierarchyChunk);
+	mClips = mFile.Chunk<ClipRecord>(ClipChunk);
+	mTracks = mFile.Chunk<TrackRecord>(TrackChunk);
+	mKeyframes = mFile.Chunk<KeyframeRecord>(KeyframeChunk);
+	mStrings = mFile.Chunk<char>(StringChunk);
+
+	if (!Validate())
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void M3dBinary::Close()
+{
+	mFile.Close();
+
+	mVertices = {};
+	mSkinnedVertices = {};
+	mIndices = {};
+	mSubsets = {};
+	mMaterials = {};
+	mBoneOffsets = {};
+	mBoneHierarchy = {};
+	mClips = {};
+	mTracks = {};
+	mKeyframes = {};
+	mStrings = {};
+}
+
+bool M3dBinary::Validate() const
+{
+	// The bulk arrays are used as they are; only the tables that index into other
+	// chunks are checked, so a damaged file fails here instead of reading out of bounds.
+	if (mStrings.empty() || mStrings[mStrings.size() - 1] != '\0')
+		return false;
+
+	for (const MaterialRecord& m : mMaterials)
+	{
+		if (std::max<UINT>({ m.Name, m.MaterialTypeName, m.DiffuseMapName, m.NormalMapName }) >= mStrings.size())
+			return false;
+	}
+
+	const std::size_t numBones = mBoneHierarchy.size();
+	if (mBoneOffsets.size() != numBones || mTracks.size() != mClips.size() * numBones)
+		return false;
+
+	for (std::size_t i = 0; i < numBones; ++i)
+	{
+		// SkinnedData walks the hierarchy parents-first.
+		if (i > 0 && (mBoneHierarchy[i] < 0 || (std::size_t)mBoneHierarchy[i] >= i))
+			return false;
+	}
+
+	for (const ClipRecord& clip : mClips)
+	{
+		if (clip.Name >= mStrings.size() || clip.FirstTrack + numBones > mTracks.size())
+			return false;
+	}
+
+	for (const TrackRecord& track : mTracks)
+	{
+		if (track.KeyCount == 0 || (UINT64)track.FirstKey + track.KeyCount > mKeyframes.size())
+			return false;
+	}
+
+	return true;
+}
+
+void M3dBinary::GetMaterials(std::vector<M3DLoader::M3dMaterial>& mats) const
+{
+	mats.resize(mMaterials.size());
+	for (std::size_t i = 0; i < mMaterials.size(); ++i)
+	{
+		const MaterialRecord& m = mMaterials[i];
+		mats[i].Name = String(m.Name);
+		mats[i].DiffuseAlbedo = m.DiffuseAlbedo;
+		mats[i].FresnelR0 = m.FresnelR0;
+		mats[i].Roughness = m.Roughness;
+		mats[i].AlphaClip = m.AlphaClip != 0;
+		mats[i].MaterialTypeName = String(m.MaterialTypeName);
+		mats[i].DiffuseMapName = String(m.DiffuseMapName);
+		mats[i].NormalMapName = String(m.NormalMapName);
+	}
+}
+
+void M3dBinary::GetSkinnedData(SkinnedData& skinInfo) const
+{
+	std::vector<int> boneHierarchy = mBoneHierarchy.ToVector();
+	std::vector<XMFLOAT4X4> boneOffsets = mBoneOffsets.ToVector();
+	std::unordered_map<std::string, AnimationClip> animations;
+
+	const UINT numBones = (UINT)mBoneHierarchy.size();
+	for (const ClipRecord& clipRecord : mClips)
+	{
+		AnimationClip& clip = animations[String(clipRecord.Name)];
+		clip.BoneAnimations.resize(numBones);
+
+		for (UINT bone = 0; bone < numBones; ++bone)
+		{
+			const TrackRecord& track = mTracks[clipRecord.FirstTrack + bone];
+			const KeyframeRecord* keys = mKeyframes.data() + track.FirstKey;
+
+			std::vector<Keyframe>& keyframes = clip.BoneAnimations[bone].Keyframes;
+			keyframes.resize(track.KeyCount);
+			for (UINT k = 0; k < track.KeyCount; ++k)
+			{
+				keyframes[k].TimePos = keys[k].TimePos;
+				keyframes[k].Translation = keys[k].Translation;
+				keyframes[k].Scale = keys[k].Scale;
+				keyframes[k].RotationQuat = keys[k].RotationQuat;
+			}
+		}
+	}
+
+	skinInfo.Set(boneHierarchy, boneOffsets, animations);
+}
+
+bool M3dBinary::Save(const std::string& filename,
+	const std::vector<M3DLoader::Vertex>* vertices,
+	const std::vector<M3DLoader::SkinnedVertex>* skinnedVertices,
+	const std::vector<USHORT>& indices,
+	const std::vector<M3DLoader::Subset>& subsets,
+	const std::vector<M3DLoader::M3dMaterial>& mats,
+	const SkinnedData* skinInfo)
+{
+	ChunkFileWriter writer;
+	StringTable strings;
+
+	std::vector<MaterialRecord> materials(mats.size());
+	for (std::size_t i = 0; i < mats.size(); ++i)
+	{
+		materials[i].DiffuseAlbedo = mats[i].DiffuseAlbedo;
+		materials[i].FresnelR0 = mats[i].FresnelR0;
+		materials[i].Roughness = mats[i].Roughness;
+		materials[i].AlphaClip = mats[i].AlphaClip ? 1 : 0;
+		materials[i].Name = strings.Add(mats[i].Name);
+		materials[i].MaterialTypeName = strings.Add(mats[i].MaterialTypeName);
+		materials[i].DiffuseMapName = strings.Add(mats[i].DiffuseMapName);
+		materials[i].NormalMapName = strings.Add(mats[i].NormalMapName);
+	}
+
+	writer.AddChunk(MaterialChunk, materials);
+	writer.AddChunk(SubsetChunk, subsets);
+	if (vertices != nullptr)
+		writer.AddChunk(VertexChunk, *vertices);
+	if (skinnedVertices != nullptr)
+		writer.AddChunk(SkinnedVertexChunk, *skinnedVertices);
+	writer.AddChunk(IndexChunk, indices);
+
+	std::vector<ClipRecord> clips;
+	std::vector<TrackRecord> tracks;
+	std::vector<KeyframeRecord> keyframes;
+	if (skinInfo != nullptr)
+	{
+		writer.AddChunk(BoneOffsetChunk, skinInfo->BoneOffsets());
+		writer.AddChunk(BoneHierarchyChunk, skinInfo->BoneHierarchy());
+
+		// Sorted so the same model always produces the same bytes.
+		std::vector<std::string> clipNames;
+		for (const auto& clip : skinInfo->AnimationClips())
+			clipNames.push_back(clip.first);
+		std::sort(clipNames.begin(), clipNames.end());
+
+		for (const std::string& clipName : clipNames)
+		{
+			const AnimationClip& clip = *skinInfo->FindClip(clipName);
+			if (clip.Compressed != nullptr)
+				return false;
+
+			clips.push_back({ strings.Add(clipName), (UINT)tracks.size() });
+			for (const BoneAnimation& bone : clip.BoneAnimations)
+			{
+				tracks.push_back({ (UINT)keyframes.size(), (UINT)bone.Keyframes.size() });
+				for (const Keyframe& key : bone.Keyframes)
+					keyframes.push_back({ key.TimePos, key.Translation, key.Scale, key.RotationQuat });
+			}
+		}
+	}
+
+	writer.AddChunk(ClipChunk, clips);
+	writer.AddChunk(TrackChunk, tracks);
+	writer.AddChunk(KeyframeChunk, keyframes);
+
+	// Keeps the chunk (which Open requires) non-empty for a model without names.
+	strings.Add("");
+	writer.AddChunk(StringChunk, strings.Chars());
+
+	return writer.Save(filename, Magic, Version);
+}
+
+bool M3dBinary::Convert(const std::string& m3dFilename, const std::string& m3dbFilename,
+	MeshOptimizationStats* stats)
+{
+	// Header text, then "#Materials n", "#Vertices n", "#Triangles n", "#Bones n".
+	UINT numBones = 0;
+	TextTokenizer header;
+	if (!header.Open(m3dFilename))
+		return false;
+	header.Skip(8) >> numBones;
+
+	M3DLoader loader;
+	std::vector<USHORT> indices;
+	std::vector<M3DLoader::Subset> subsets;
+	std::vector<M3DLoader::M3dMaterial> mats;
+
+	bool converted = false;
+	if (numBones == 0)
+	{
+		std::vector<M3DLoader::Vertex> vertices;
+		converted = loader.LoadM3d(m3dFilename, vertices, indices, subsets, mats) &&
+			Save(m3dbFilename, &vertices, nullptr, indices, subsets, mats, nullptr);
+	}
+	else
+	{
+		std::vector<M3DLoader::SkinnedVertex> vertices;
+		SkinnedData skinInfo;
+		converted = loader.LoadM3d(m3dFilename, vertices, indices, subsets, mats, skinInfo) &&
+			Save(m3dbFilename, nullptr, &vertices, indices, subsets, mats, &skinInfo);
+	}
+
+	if (stats != nullptr)
+		*stats = loader.OptimizationStats();
+	return converted;
+}
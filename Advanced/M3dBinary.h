@@ -0,0 +1,112 @@
+#pragma once
+
+#include "Common/ChunkFile.h"
+#include "LoadM3d.h"
+
+
+// .m3db: the contents of an .m3d file as a ChunkFile (see Common/ChunkFile.h), written
+// by the ModelConverter tool.  Opening one maps it and points views straight at the
+// vertex, index, subset and keyframe records; nothing is parsed.
+//
+// Strings (material and clip names) live in one chunk of NUL-terminated characters and
+// are referred to by offset.  Keyframes of every clip share one array: a clip lists
+// BoneCount() consecutive tracks, and each track a range of keyframes.
+class M3dBinary
+{
+public:
+	static const UINT Magic = MakeChunkId('M', '3', 'D', 'B');
+	static const UINT Version = 1;
+
+	struct MaterialRecord
+	{
+		DirectX::XMFLOAT4 DiffuseAlbedo;
+		DirectX::XMFLOAT3 FresnelR0;
+		float Roughness;
+		UINT AlphaClip;
+
+		// Offsets into the string chunk.
+		UINT Name;
+		UINT MaterialTypeName;
+		UINT DiffuseMapName;
+		UINT NormalMapName;
+	};
+
+	// Same members as Keyframe, without its constructors so it can be mapped.
+	struct KeyframeRecord
+	{
+		float TimePos;
+		DirectX::XMFLOAT3 Translation;
+		DirectX::XMFLOAT3 Scale;
+		DirectX::XMFLOAT4 RotationQuat;
+	};
+
+	struct ClipRecord
+	{
+		UINT Name;
+		UINT FirstTrack;
+	};
+
+	struct TrackRecord
+	{
+		UINT FirstKey;
+		UINT KeyCount;
+	};
+
+	bool Open(const std::string& filename);
+	void Close();
+
+	// Skinned files carry SkinnedVertices() and the skeleton, static ones Vertices().
+	bool IsSkinned() const { return !mSkinnedVertices.empty(); }
+
+	ArrayView<M3DLoader::Vertex> Vertices() const { return mVertices; }
+	ArrayView<M3DLoader::SkinnedVertex> SkinnedVertices() const { return mSkinnedVertices; }
+	ArrayView<USHORT> Indices() const { return mIndices; }
+	ArrayView<M3DLoader::Subset> Subsets() const { return mSubsets; }
+	ArrayView<MaterialRecord> Materials() const { return mMaterials; }
+
+	ArrayView<DirectX::XMFLOAT4X4> BoneOffsets() const { return mBoneOffsets; }
+	ArrayView<int> BoneHierarchy() const { return mBoneHierarchy; }
+	ArrayView<ClipRecord> Clips() const { return mClips; }
+	ArrayView<TrackRecord> Tracks() const { return mTracks; }
+	ArrayView<KeyframeRecord> Keyframes() const { return mKeyframes; }
+
+	const char* String(UINT offset) const { return mStrings.data() + offset; }
+
+	// Copies into the types LoadM3d fills.
+	void GetMaterials(std::vector<M3DLoader::M3dMaterial>& mats) const;
+	void GetSkinnedData(SkinnedData& skinInfo) const;
+
+	// Writes an .m3db.  Pass a null skinInfo for static models; its clips must not
+	// be compressed.
+	static bool Save(const std::string& filename,
+		const std::vector<M3DLoader::Vertex>* vertices,
+		const std::vector<M3DLoader::SkinnedVertex>* skinnedVertices,
+		const std::vector<USHORT>& indices,
+		const std::vector<M3DLoader::Subset>& subsets,
+		const std::vector<M3DLoader::M3dMaterial>& mats,
+		const SkinnedData* skinInfo);
+
+	// Loads a text .m3d (static or skinned, from its bone count) and saves it as .m3db.
+	// The loader reorders the triangles for the GPU; stats, if given, receives how much
+	// that changed the vertex cache misses.
+	static bool Convert(const std::string& m3dFilename, const std::string& m3dbFilename,
+		MeshOptimizationStats* stats = nullptr);
+
+private:
+	bool Validate() const;
+
+private:
+	ChunkFileReader mFile;
+
+	ArrayView<M3DLoader::Vertex> mVertices;
+	ArrayView<M3DLoader::SkinnedVertex> mSkinnedVertices;
+	ArrayView<USHORT> mIndices;
+	ArrayView<M3DLoader::Subset> mSubsets;
+	ArrayView<MaterialRecord> mMaterials;
+	ArrayView<DirectX::XMFLOAT4X4> mBoneOffsets;
+	ArrayView<int> mBoneHierarchy;
+	ArrayView<ClipRecord> mClips;
+	ArrayView<TrackRecord> mTracks;
+	ArrayView<KeyframeRecord> mKeyframes;
+	ArrayView<char> mStrings;
+};
@@ -0,0 +1,280 @@
+#include "PoseBatch.h"
+#include "Common/SimdLane.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// Per-lane keyframe data gathered for one bone, one row of LaneWidth floats each.
+	enum KeyRow
+	{
+		S0x, S0y, S0z, S1x, S1y, S1z,
+		P0x, P0y, P0z, P1x, P1y, P1z,
+		Q0x, Q0y, Q0z, Q0w, Q1x, Q1y, Q1z, Q1w,
+		LerpS, LerpP, LerpQ,
+		KeyRowCount
+	};
+
+	// A bone-to-root affine transform: rows 0-2 of the 3x3 part, then the translation.
+	constexpr int AffineFloats = 12;
+
+	// acos(x) for x in [0, 1]; the 7th degree polynomial of XMScalarACos.
+	inline Lane LaneACosUnit(Lane x)
+	{
+		Lane root = LaneSqrt(LaneMax(LaneSub(LaneSet(1.0f), x), LaneSet(0.0f)));
+
+		Lane p = LaneSet(-0.0012624911f);
+		p = LaneAdd(LaneMul(p, x), LaneSet(0.0066700901f));
+		p = LaneAdd(LaneMul(p, x), LaneSet(-0.0170881256f));
+		p = LaneAdd(LaneMul(p, x), LaneSet(0.0308918810f));
+		p = LaneAdd(LaneMul(p, x), LaneSet(-0.0501743046f));
+		p = LaneAdd(LaneMul(p, x), LaneSet(0.0889789874f));
+		p = LaneAdd(LaneMul(p, x), LaneSet(-0.2145988016f));
+		p = LaneAdd(LaneMul(p, x), LaneSet(1.5707963050f));
+
+		return LaneMul(p, root);
+	}
+
+	// sin(x) for x in [0, pi/2], where the Taylor series to x^13 is good to 1e-9.
+	inline Lane LaneSinQuadrant(Lane x)
+	{
+		Lane x2 = LaneMul(x, x);
+
+		Lane p = LaneSet(1.0f / 6227020800.0f);
+		p = LaneAdd(LaneMul(p, x2), LaneSet(-1.0f / 39916800.0f));
+		p = LaneAdd(LaneMul(p, x2), LaneSet(1.0f / 362880.0f));
+		p = LaneAdd(LaneMul(p, x2), LaneSet(-1.0f / 5040.0f));
+		p = LaneAdd(LaneMul(p, x2), LaneSet(1.0f / 120.0f));
+		p = LaneAdd(LaneMul(p, x2), LaneSet(-1.0f / 6.0f));
+		p = LaneAdd(LaneMul(p, x2), LaneSet(1.0f));
+
+		return LaneMul(p, x);
+	}
+}
+
+UINT PoseBatch::GroupSize()
+{
+	return LaneWidth;
+}
+
+void PoseBatch::Evaluate(const SkinnedData& skinnedData, const PoseRequest* requests, UINT requestCount)
+{
+	mToRootTransforms.resize(skinnedData.BoneCount() * AffineFloats * LaneWidth);
+
+	for (UINT first = 0; first < requestCount; first += LaneWidth)
+	{
+		EvaluateGroup(skinnedData, requests + first, MathHelper::Min(requestCount - first, (UINT)LaneWidth));
+	}
+}
+
+void PoseBatch::EvaluateGroup(const SkinnedData& skinnedData, const PoseRequest* requests, UINT count)
+{
+	const std::vector<int>& boneHierarchy = skinnedData.BoneHierarchy();
+	const std::vector<XMFLOAT4X4>& boneOffsets = skinnedData.BoneOffsets();
+	const UINT numBones = skinnedData.BoneCount();
+
+	const Lane zero = LaneSet(0.0f);
+	const Lane one = LaneSet(1.0f);
+	const Lane two = LaneSet(2.0f);
+
+	for (UINT bone = 0; bone < numBones; ++bone)
+	{
+		//
+		// Gather the keyframe pair of every lane.  Lanes past count repeat the last
+		// request so the arithmetic stays valid; their results are never written.
+		//
+
+		alignas(32) float keys[KeyRowCount][LaneWidth];
+		for (int lane = 0; lane < LaneWidth; ++lane)
+		{
+			const PoseRequest& request = requests[MathHelper::Min((UINT)lane, count - 1)];
+
+			UINT scratchCursor = 0;
+			UINT& cursor = (request.KeyframeCursors != nullptr && (UINT)lane < count) ?
+				request.KeyframeCursors[bone] : scratchCursor;
+
+			BoneKeyPair k;
+			request.Clip->GetBoneKeys(bone, request.TimePos, cursor, k);
+
+			keys[S0x][lane] = k.Scale[0].x;
+			keys[S0y][lane] = k.Scale[0].y;
+			keys[S0z][lane] = k.Scale[0].z;
+			keys[S1x][lane] = k.Scale[1].x;
+			keys[S1y][lane] = k.Scale[1].y;
+			keys[S1z][lane] = k.Scale[1].z;
+
+			keys[P0x][lane] = k.Translation[0].x;
+			keys[P0y][lane] = k.Translation[0].y;
+			keys[P0z][lane] = k.Translation[0].z;
+			keys[P1x][lane] = k.Translation[1].x;
+			keys[P1y][lane] = k.Translation[1].y;
+			keys[P1z][lane] = k.Translation[1].z;
+
+			keys[Q0x][lane] = k.RotationQuat[0].x;
+			keys[Q0y][lane] = k.RotationQuat[0].y;
+			keys[Q0z][lane] = k.RotationQuat[0].z;
+			keys[Q0w][lane] = k.RotationQuat[0].w;
+			keys[Q1x][lane] = k.RotationQuat[1].x;
+			keys[Q1y][lane] = k.RotationQuat[1].y;
+			keys[Q1z][lane] = k.RotationQuat[1].z;
+			keys[Q1w][lane] = k.RotationQuat[1].w;
+
+			keys[LerpS][lane] = k.ScaleLerp;
+			keys[LerpP][lane] = k.TranslationLerp;
+			keys[LerpQ][lane] = k.RotationLerp;
+		}
+
+		//
+		// Scale and translation: plain lerps.
+		//
+
+		Lane ts = LaneLoad(keys[LerpS]);
+		Lane tp = LaneLoad(keys[LerpP]);
+
+		Lane S[3], P[3];
+		for (int c = 0; c < 3; ++c)
+		{
+			Lane s0 = LaneLoad(keys[S0x + c]);
+			Lane p0 = LaneLoad(keys[P0x + c]);
+			S[c] = LaneAdd(s0, LaneMul(ts, LaneSub(LaneLoad(keys[S1x + c]), s0)));
+			P[c] = LaneAdd(p0, LaneMul(tp, LaneSub(LaneLoad(keys[P1x + c]), p0)));
+		}
+
+		//
+		// Rotation: the same slerp as XMQuaternionSlerp, falling back to a lerp when
+		// the two rotations are (nearly) equal.
+		//
+
+		Lane t = LaneLoad(keys[LerpQ]);
+
+		Lane q0[4], q1[4];
+		for (int c = 0; c < 4; ++c)
+		{
+			q0[c] = LaneLoad(keys[Q0x + c]);
+			q1[c] = LaneLoad(keys[Q1x + c]);
+		}
+
+		Lane cosOmega = LaneAdd(LaneAdd(LaneMul(q0[0], q1[0]), LaneMul(q0[1], q1[1])),
+			LaneAdd(LaneMul(q0[2], q1[2]), LaneMul(q0[3], q1[3])));
+
+		Lane sign = LaneSelect(LaneLess(cosOmega, zero), LaneSet(-1.0f), one);
+		cosOmega = LaneMul(cosOmega, sign);
+
+		LaneMask apart = LaneLess(cosOmega, LaneSet(1.0f - 0.00001f));
+
+		// sin(omega) comes from omega rather than sqrt(1 - cos^2), which loses most of
+		// its precision exactly where slerp is used most (rotations a few degrees apart).
+		Lane omega = LaneACosUnit(cosOmega);
+		Lane sinOmega = LaneSinQuadrant(omega);
+		Lane invSinOmega = LaneDiv(one, sinOmega);
+
+		Lane oneMinusT = LaneSub(one, t);
+		Lane w0 = LaneSelect(apart, LaneMul(LaneSinQuadrant(LaneMul(oneMinusT, omega)), invSinOmega), oneMinusT);
+		Lane w1 = LaneSelect(apart, LaneMul(LaneSinQuadrant(LaneMul(t, omega)), invSinOmega), t);
+		w1 = LaneMul(w1, sign);
+
+		Lane qx = LaneAdd(LaneMul(q0[0], w0), LaneMul(q1[0], w1));
+		Lane qy = LaneAdd(LaneMul(q0[1], w0), LaneMul(q1[1], w1));
+		Lane qz = LaneAdd(LaneMul(q0[2], w0), LaneMul(q1[2], w1));
+		Lane qw = LaneAdd(LaneMul(q0[3], w0), LaneMul(q1[3], w1));
+
+		//
+		// toParent = Scaling(S) * RotationQuaternion(Q) * Translation(P), as
+		// XMMatrixAffineTransformation builds it with a zero rotation origin.
+		//
+
+		Lane xx = LaneMul(qx, qx), yy = LaneMul(qy, qy), zz = LaneMul(qz, qz);
+		Lane xy = LaneMul(qx, qy), xz = LaneMul(qx, qz), yz = LaneMul(qy, qz);
+		Lane xw = LaneMul(qx, qw), yw = LaneMul(qy, qw), zw = LaneMul(qz, qw);
+
+		Lane toParent[AffineFloats];
+		toParent[0] = LaneMul(S[0], LaneSub(one, LaneMul(two, LaneAdd(yy, zz))));
+		toParent[1] = LaneMul(S[0], LaneMul(two, LaneAdd(xy, zw)));
+		toParent[2] = LaneMul(S[0], LaneMul(two, LaneSub(xz, yw)));
+		toParent[3] = LaneMul(S[1], LaneMul(two, LaneSub(xy, zw)));
+		toParent[4] = LaneMul(S[1], LaneSub(one, LaneMul(two, LaneAdd(xx, zz))));
+		toParent[5] = LaneMul(S[1], LaneMul(two, LaneAdd(yz, xw)));
+		toParent[6] = LaneMul(S[2], LaneMul(two, LaneAdd(xz, yw)));
+		toParent[7] = LaneMul(S[2], LaneMul(two, LaneSub(yz, xw)));
+		toParent[8] = LaneMul(S[2], LaneSub(one, LaneMul(two, LaneAdd(xx, yy))));
+		toParent[9] = P[0];
+		toParent[10] = P[1];
+		toParent[11] = P[2];
+
+		//
+		// toRoot = toParent * parentToRoot.  Both are affine, so only the 3x3 part
+		// and the translation row need multiplying.
+		//
+
+		Lane toRoot[AffineFloats];
+		float* toRootStore = &mToRootTransforms[bone * AffineFloats * LaneWidth];
+		if (bone == 0)
+		{
+			for (int k = 0; k < AffineFloats; ++k)
+				toRoot[k] = toParent[k];
+		}
+		else
+		{
+			const float* parentStore = &mToRootTransforms[boneHierarchy[bone] * AffineFloats * LaneWidth];
+
+			Lane parent[AffineFloats];
+			for (int k = 0; k < AffineFloats; ++k)
+				parent[k] = LaneLoad(parentStore + k * LaneWidth);
+
+			for (int r = 0; r < 4; ++r)
+			{
+				for (int c = 0; c < 3; ++c)
+				{
+					Lane v = LaneAdd(LaneAdd(
+						LaneMul(toParent[r * 3 + 0], parent[0 * 3 + c]),
+						LaneMul(toParent[r * 3 + 1], parent[1 * 3 + c])),
+						LaneMul(toParent[r * 3 + 2], parent[2 * 3 + c]));
+
+					if (r == 3)
+						v = LaneAdd(v, parent[9 + c]);
+
+					toRoot[r * 3 + c] = v;
+				}
+			}
+		}
+
+		for (int k = 0; k < AffineFloats; ++k)
+			LaneStore(toRootStore + k * LaneWidth, toRoot[k]);
+
+		//
+		// final = offset * toRoot.  The offset is shared by every lane, and is used
+		// as a full 4x4 so non-affine offsets come out the same as in the scalar path.
+		//
+
+		const XMFLOAT4X4& offset = boneOffsets[bone];
+
+		alignas(32) float finalTransform[16][LaneWidth];
+		for (int r = 0; r < 4; ++r)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				Lane v = LaneAdd(LaneAdd(
+					LaneMul(LaneSet(offset(r, 0)), toRoot[0 * 3 + c]),
+					LaneMul(LaneSet(offset(r, 1)), toRoot[1 * 3 + c])),
+					LaneAdd(
+					LaneMul(LaneSet(offset(r, 2)), toRoot[2 * 3 + c]),
+					LaneMul(LaneSet(offset(r, 3)), toRoot[9 + c])));
+
+				LaneStore(finalTransform[r * 4 + c], v);
+			}
+			LaneStore(finalTransform[r * 4 + 3], LaneSet(offset(r, 3)));
+		}
+
+		// Scatter back to each instance's palette, transposed for the shader.  The
+		// palette may live in a write-combined upload heap, so write it in order.
+		for (UINT lane = 0; lane < count; ++lane)
+		{
+			XMFLOAT4X4& out = requests[lane].FinalTransforms[bone];
+			for (int c = 0; c < 4; ++c)
+			{
+				for (int r = 0; r < 4; ++r)
+					out(c, r) = finalTransform[r * 4 + c][lane];
+			}
+		}
+	}
+}
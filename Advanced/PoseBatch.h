@@ -0,0 +1,43 @@
+#pragma once
+
+#include "AnimationHelper.h"
+
+
+// One character to pose: which clip, at what time, and where to write its skinning
+// palette.  KeyframeCursors (BoneCount() entries, see BoneAnimation::Interpolate) may
+// be null; FinalTransforms receives BoneCount() transposed matrices, exactly as
+// SkinnedData::GetFinalTransforms writes them.
+struct PoseRequest
+{
+	const AnimationClip* Clip = nullptr;
+	float TimePos = 0.0f;
+	UINT* KeyframeCursors = nullptr;
+	DirectX::XMFLOAT4X4* FinalTransforms = nullptr;
+};
+
+
+// Evaluates many instances of the same skeleton together.  Instances are processed a
+// SIMD register at a time (4 with SSE, 8 with AVX2) in structure-of-arrays form, one
+// instance per lane, so keyframe blending, slerp, affine composition and the walk
+// down the bone hierarchy each run once per group instead of once per character.
+//
+// Results match GetFinalTransforms to within float rounding.  A PoseBatch holds its
+// working memory between calls, so keep one per thread; Evaluate does not allocate
+// once it has seen the skeleton.
+class PoseBatch
+{
+public:
+	// Every request must use a clip of skinnedData.
+	void Evaluate(const SkinnedData& skinnedData, const PoseRequest* requests, UINT requestCount);
+
+	// Number of instances evaluated side by side.
+	static UINT GroupSize();
+
+private:
+	void EvaluateGroup(const SkinnedData& skinnedData, const PoseRequest* requests, UINT count);
+
+private:
+	// Bone-to-root transforms of the current group: for each bone, the 3x3 part and
+	// the translation row (12 floats), each stored as GroupSize() lanes.
+	std::vector<float> mToRootTransforms;
+};
@@ -0,0 +1,359 @@
+//***************************************************************************************
+// AnimationBench.cpp
+//
+// Loading soldier.m3d and evaluating its skinning palette.
+//***************************************************************************************
+
+#include "Benchmark.h"
+#include "Advanced/AnimationCompression.h"
+#include "Advanced/AnimationStage.h"
+#include "Advanced/LoadM3d.h"
+#include "Advanced/M3dBinary.h"
+#include "Advanced/PoseBatch.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+
+using namespace DirectX;
+
+
+namespace
+{
+	struct SoldierModel
+	{
+		std::vector<M3DLoader::SkinnedVertex> Vertices;
+		std::vector<USHORT> Indices;
+		std::vector<M3DLoader::Subset> Subsets;
+		std::vector<M3DLoader::M3dMaterial> Materials;
+		SkinnedData SkinInfo;
+	};
+
+	const SoldierModel& Soldier()
+	{
+		static SoldierModel model = []
+			{
+				SoldierModel m;
+				M3DLoader loader;
+				if (!loader.LoadM3d(ModelPath("soldier.m3d"), m.Vertices, m.Indices, m.Subsets, m.Materials, m.SkinInfo))
+				{
+					std::fprintf(stderr, "%s not found.\n", ModelPath("soldier.m3d").c_str());
+					std::exit(1);
+				}
+				return m;
+			}();
+		return model;
+	}
+
+	// A crowd of soldiers playing "Take1", each starting at a different time.
+	struct Crowd
+	{
+		std::vector<float> TimePos;
+		std::vector<std::vector<UINT>> KeyframeCursors;
+		std::vector<std::vector<XMFLOAT4X4>> FinalTransforms;
+	};
+
+	Crowd MakeCrowd(const SkinnedData& skinInfo, UINT count)
+	{
+		Crowd crowd;
+		crowd.TimePos.resize(count);
+		crowd.KeyframeCursors.assign(count, std::vector<UINT>(skinInfo.BoneCount(), 0));
+		crowd.FinalTransforms.assign(count, std::vector<XMFLOAT4X4>(skinInfo.BoneCount()));
+
+		const float endTime = skinInfo.GetClipEndTime("Take1");
+		for (UINT i = 0; i < count; ++i)
+			crowd.TimePos[i] = endTime * i / count;
+
+		return crowd;
+	}
+}
+
+static void BM_LoadM3d(BenchmarkState& state)
+{
+	std::int64_t vertices = 0;
+
+	for (auto _ : state)
+	{
+		SoldierModel m;
+		M3DLoader loader;
+		loader.LoadM3d(ModelPath("soldier.m3d"), m.Vertices, m.Indices, m.Subsets, m.Materials, m.SkinInfo);
+		vertices += m.Vertices.size();
+	}
+
+	state.SetItemsProcessed(vertices);
+}
+BENCHMARK(BM_LoadM3d);
+
+static void BM_LoadM3db(BenchmarkState& state)
+{
+	const std::string path = (std::filesystem::temp_directory_path() / "soldier.m3db").string();
+	if (!M3dBinary::Convert(ModelPath("soldier.m3d"), path))
+	{
+		std::fprintf(stderr, "Could not convert %s.\n", ModelPath("soldier.m3d").c_str());
+		std::exit(1);
+	}
+
+	std::int64_t vertices = 0;
+
+	for (auto _ : state)
+	{
+		SoldierModel m;
+		M3DLoader loader;
+		loader.LoadM3db(path, m.Vertices, m.Indices, m.Subsets, m.Materials, m.SkinInfo);
+		vertices += m.Vertices.size();
+	}
+
+	state.SetItemsProcessed(vertices);
+}
+BENCHMARK(BM_LoadM3db);
+
+static void BM_GetFinalTransforms(BenchmarkState& state)
+{
+	const SkinnedData& skinInfo = Soldier().SkinInfo;
+	const std::string clipName = "Take1";
+	const float endTime = skinInfo.GetClipEndTime(clipName);
+
+	std::vector<XMFLOAT4X4> finalTransforms(skinInfo.BoneCount());
+	float timePos = 0.0f;
+
+	for (auto _ : state)
+	{
+		// Step at 60 Hz so every keyframe interval gets sampled.
+		timePos += 1.0f / 60.0f;
+		if (timePos > endTime)
+			timePos = 0.0f;
+
+		skinInfo.GetFinalTransforms(clipName, timePos, finalTransforms);
+		DoNotOptimize(finalTransforms[0]);
+	}
+
+	state.SetItemsProcessed(state.Iterations() * skinInfo.BoneCount());
+}
+BENCHMARK(BM_GetFinalTransforms);
+
+// Same as above with a per-instance keyframe cursor, as SkinnedModelInstance uses.
+static void BM_GetFinalTransformsCursor(BenchmarkState& state)
+{
+	const SkinnedData& skinInfo = Soldier().SkinInfo;
+	const std::string clipName = "Take1";
+	const float endTime = skinInfo.GetClipEndTime(clipName);
+
+	std::vector<XMFLOAT4X4> finalTransforms(skinInfo.BoneCount());
+	std::vector<UINT> keyframeCursors;
+	float timePos = 0.0f;
+
+	for (auto _ : state)
+	{
+		timePos += 1.0f / 60.0f;
+		if (timePos > endTime)
+			timePos = 0.0f;
+
+		skinInfo.GetFinalTransforms(clipName, timePos, finalTransforms, keyframeCursors);
+		DoNotOptimize(finalTransforms[0]);
+	}
+
+	state.SetItemsProcessed(state.Iterations() * skinInfo.BoneCount());
+}
+BENCHMARK(BM_GetFinalTransformsCursor);
+
+// The handle + scratch API; should report 0 allocs/op.
+static void BM_GetFinalTransformsHandle(BenchmarkState& state)
+{
+	const SkinnedData& skinInfo = Soldier().SkinInfo;
+	const AnimationClip* clip = skinInfo.FindClip("Take1");
+	const float endTime = clip->GetClipEndTime();
+
+	std::vector<XMFLOAT4X4> finalTransforms(skinInfo.BoneCount());
+	std::vector<UINT> keyframeCursors;
+	AnimationScratch scratch;
+	float timePos = 0.0f;
+
+	for (auto _ : state)
+	{
+		timePos += 1.0f / 60.0f;
+		if (timePos > endTime)
+			timePos = 0.0f;
+
+		skinInfo.GetFinalTransforms(*clip, timePos, finalTransforms.data(), keyframeCursors, scratch);
+		DoNotOptimize(finalTransforms[0]);
+	}
+
+	state.SetItemsProcessed(state.Iterations() * skinInfo.BoneCount());
+}
+BENCHMARK(BM_GetFinalTransformsHandle);
+
+// The handle path on a compressed copy of the clips.
+static void BM_GetFinalTransformsCompressed(BenchmarkState& state)
+{
+	static const SkinnedData skinInfo = []
+		{
+			SkinnedData compressed = Soldier().SkinInfo;
+			compressed.CompressClips(AnimationCompressionSettings());
+			return compressed;
+		}();
+	const AnimationClip* clip = skinInfo.FindClip("Take1");
+	const float endTime = clip->GetClipEndTime();
+
+	std::vector<XMFLOAT4X4> finalTransforms(skinInfo.BoneCount());
+	std::vector<UINT> keyframeCursors;
+	AnimationScratch scratch;
+	float timePos = 0.0f;
+
+	for (auto _ : state)
+	{
+		timePos += 1.0f / 60.0f;
+		if (timePos > endTime)
+			timePos = 0.0f;
+
+		skinInfo.GetFinalTransforms(*clip, timePos, finalTransforms.data(), keyframeCursors, scratch);
+		DoNotOptimize(finalTransforms[0]);
+	}
+
+	state.SetItemsProcessed(state.Iterations() * skinInfo.BoneCount());
+}
+BENCHMARK(BM_GetFinalTransformsCompressed);
+
+// A crossfade between two points of the walk plus an additive layer on the upper
+// body, blended in one pass.
+static void BM_GetFinalTransformsLayered(BenchmarkState& state)
+{
+	const SkinnedData& skinInfo = Soldier().SkinInfo;
+	const AnimationClip* clip = skinInfo.FindClip("Take1");
+	const float endTime = clip->GetClipEndTime();
+
+	std::vector<float> upperBody;
+	skinInfo.GetBoneMask(5, upperBody);
+
+	std::vector<std::vector<UINT>> keyframeCursors(3, std::vector<UINT>(skinInfo.BoneCount(), 0));
+	AnimationLayer layers[3];
+	for (int l = 0; l < 3; ++l)
+	{
+		layers[l].Clip = clip;
+		layers[l].KeyframeCursors = keyframeCursors[l].data();
+	}
+	layers[1].Weight = 0.3f;
+	layers[2].Weight = 0.5f;
+	layers[2].BlendMode = AnimationBlendMode::Additive;
+	layers[2].BoneMask = upperBody.data();
+
+	std::vector<XMFLOAT4X4> finalTransforms(skinInfo.BoneCount());
+	AnimationScratch scratch;
+	float timePos = 0.0f;
+
+	for (auto _ : state)
+	{
+		timePos += 1.0f / 60.0f;
+		if (timePos > endTime)
+			timePos = 0.0f;
+
+		layers[0].TimePos = timePos;
+		layers[1].TimePos = std::fmod(timePos + 0.5f, endTime);
+		layers[2].TimePos = std::fmod(timePos + 0.25f, endTime);
+
+		skinInfo.GetFinalTransforms(layers, 3, finalTransforms.data(), scratch);
+		DoNotOptimize(finalTransforms[0]);
+	}
+
+	state.SetItemsProcessed(state.Iterations() * skinInfo.BoneCount());
+}
+BENCHMARK(BM_GetFinalTransformsLayered);
+
+// Arg is the number of soldiers; one GetFinalTransforms call per soldier.
+static void BM_CrowdPerInstance(BenchmarkState& state)
+{
+	const SkinnedData& skinInfo = Soldier().SkinInfo;
+	const AnimationClip* clip = skinInfo.FindClip("Take1");
+	const float endTime = clip->GetClipEndTime();
+
+	Crowd crowd = MakeCrowd(skinInfo, (UINT)state.Arg());
+	AnimationScratch scratch;
+
+	for (auto _ : state)
+	{
+		for (UINT i = 0; i < crowd.TimePos.size(); ++i)
+		{
+			crowd.TimePos[i] += 1.0f / 60.0f;
+			if (crowd.TimePos[i] > endTime)
+				crowd.TimePos[i] = 0.0f;
+
+			skinInfo.GetFinalTransforms(*clip, crowd.TimePos[i], crowd.FinalTransforms[i].data(), crowd.KeyframeCursors[i], scratch);
+		}
+		DoNotOptimize(crowd.FinalTransforms[0][0]);
+	}
+
+	state.SetItemsProcessed(state.Iterations() * state.Arg() * skinInfo.BoneCount());
+}
+BENCHMARK(BM_CrowdPerInstance)->Arg(64)->Arg(512);
+
+// The same crowd through PoseBatch, GroupSize() soldiers per SIMD pass.
+static void BM_CrowdPoseBatch(BenchmarkState& state)
+{
+	const SkinnedData& skinInfo = Soldier().SkinInfo;
+	const AnimationClip* clip = skinInfo.FindClip("Take1");
+	const float endTime = clip->GetClipEndTime();
+
+	Crowd crowd = MakeCrowd(skinInfo, (UINT)state.Arg());
+	std::vector<PoseRequest> requests(crowd.TimePos.size());
+	for (UINT i = 0; i < requests.size(); ++i)
+	{
+		requests[i].Clip = clip;
+		requests[i].KeyframeCursors = crowd.KeyframeCursors[i].data();
+		requests[i].FinalTransforms = crowd.FinalTransforms[i].data();
+	}
+	PoseBatch batch;
+
+	for (auto _ : state)
+	{
+		for (UINT i = 0; i < requests.size(); ++i)
+		{
+			crowd.TimePos[i] += 1.0f / 60.0f;
+			if (crowd.TimePos[i] > endTime)
+				crowd.TimePos[i] = 0.0f;
+
+			requests[i].TimePos = crowd.TimePos[i];
+		}
+
+		batch.Evaluate(skinInfo, requests.data(), (UINT)requests.size());
+		DoNotOptimize(crowd.FinalTransforms[0][0]);
+	}
+
+	state.SetItemsProcessed(state.Iterations() * state.Arg() * skinInfo.BoneCount());
+}
+BENCHMARK(BM_CrowdPoseBatch)->Arg(64)->Arg(512);
+
+// The crowd through AnimationStage, spread over the default thread pool.
+static void BM_CrowdAnimationStage(BenchmarkState& state)
+{
+	const SkinnedData& skinInfo = Soldier().SkinInfo;
+	const AnimationClip* clip = skinInfo.FindClip("Take1");
+	const float endTime = clip->GetClipEndTime();
+
+	Crowd crowd = MakeCrowd(skinInfo, (UINT)state.Arg());
+	std::vector<PoseRequest> requests(crowd.TimePos.size());
+	for (UINT i = 0; i < requests.size(); ++i)
+	{
+		requests[i].Clip = clip;
+		requests[i].KeyframeCursors = crowd.KeyframeCursors[i].data();
+		requests[i].FinalTransforms = crowd.FinalTransforms[i].data();
+	}
+	AnimationStage stage;
+
+	for (auto _ : state)
+	{
+		for (UINT i = 0; i < requests.size(); ++i)
+		{
+			crowd.TimePos[i] += 1.0f / 60.0f;
+			if (crowd.TimePos[i] > endTime)
+				crowd.TimePos[i] = 0.0f;
+
+			requests[i].TimePos = crowd.TimePos[i];
+		}
+
+		stage.Run(skinInfo, requests.data(), (UINT)requests.size());
+		DoNotOptimize(crowd.FinalTransforms[0][0]);
+	}
+
+	state.SetItemsProcessed(state.Iterations() * state.Arg() * skinInfo.BoneCount());
+}
+BENCHMARK(BM_CrowdAnimationStage)->Arg(64)->Arg(512);
@@ -0,0 +1,183 @@
+//***************************************************************************************
+// Benchmark.cpp
+//
+// Harness implementation and main().  Usage:
+//
+//     CpuBenchmarks [--filter=<substring>] [--min-time=<seconds>]
+//***************************************************************************************
+
+#include "Benchmark.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+
+#if defined(_MSC_VER)
+volatile char gBenchmarkSink;
+#endif
+
+namespace
+{
+	std::atomic<std::int64_t> gAllocationCount{ 0 };
+	std::atomic<std::int64_t> gAllocatedBytes{ 0 };
+
+	std::vector<BenchmarkRegistration*>& Registry()
+	{
+		static std::vector<BenchmarkRegistration*> registry;
+		return registry;
+	}
+
+	std::int64_t NowTicks()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void* CountedAlloc(std::size_t size)
+	{
+		gAllocationCount.fetch_add(1, std::memory_order_relaxed);
+		gAllocatedBytes.fetch_add((std::int64_t)size, std::memory_order_relaxed);
+
+		void* p = std::malloc(size ? size : 1);
+		if (p == nullptr)
+			throw std::bad_alloc();
+		return p;
+	}
+}
+
+// Count every heap allocation made while a benchmark runs.
+void* operator new(std::size_t size) { return CountedAlloc(size); }
+void* operator new[](std::size_t size) { return CountedAlloc(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+
+void BenchmarkState::StartTiming()
+{
+	mStartAllocations = gAllocationCount.load(std::memory_order_relaxed);
+	mStartBytes = gAllocatedBytes.load(std::memory_order_relaxed);
+	mStartTicks = NowTicks();
+}
+
+void BenchmarkState::FinishTiming()
+{
+	if (mPaused)
+		ResumeTiming();
+
+	std::int64_t ticks = NowTicks();
+	ElapsedSeconds += (ticks - mStartTicks) * 1.0e-9;
+	Allocations += gAllocationCount.load(std::memory_order_relaxed) - mStartAllocations;
+	AllocatedBytes += gAllocatedBytes.load(std::memory_order_relaxed) - mStartBytes;
+}
+
+void BenchmarkState::PauseTiming()
+{
+	FinishTiming();
+	mPaused = true;
+}
+
+void BenchmarkState::ResumeTiming()
+{
+	mPaused = false;
+	StartTiming();
+}
+
+BenchmarkRegistration::BenchmarkRegistration(const char* name, BenchmarkFunction function) :
+	Name(name), Function(function)
+{
+	Registry().push_back(this);
+}
+
+BenchmarkRegistration* BenchmarkRegistration::Arg(std::int64_t arg)
+{
+	Args.push_back(arg);
+	return this;
+}
+
+std::string ModelPath(const std::string& filename)
+{
+#if defined(LEARNDX12_MODELS_DIR)
+	return std::string(LEARNDX12_MODELS_DIR) + filename;
+#else
+	return "../Models/" + filename;
+#endif
+}
+
+static void RunBenchmark(const BenchmarkRegistration& reg, std::int64_t arg, bool hasArg, double minTime)
+{
+	std::string name = reg.Name;
+	if (hasArg)
+		name += "/" + std::to_string(arg);
+
+	// Grow the iteration count until one run fills the minimum time.
+	std::int64_t iterations = 1;
+	for (;;)
+	{
+		BenchmarkState state(iterations, arg);
+		reg.Function(state);
+
+		if (state.ElapsedSeconds >= minTime || iterations >= (std::int64_t(1) << 40))
+		{
+			double nsPerOp = state.ElapsedSeconds * 1.0e9 / iterations;
+			double allocsPerOp = (double)state.Allocations / iterations;
+			double bytesPerOp = (double)state.AllocatedBytes / iterations;
+
+			std::printf("%-40s %12lld %14.1f ns/op", name.c_str(), (long long)iterations, nsPerOp);
+			if (state.ItemsProcessed() > 0)
+			{
+				std::printf(" %12.3f M items/s", state.ItemsProcessed() / state.ElapsedSeconds * 1.0e-6);
+			}
+			std::printf(" %10.1f allocs/op %12.0f B/op\n", allocsPerOp, bytesPerOp);
+			return;
+		}
+
+		// Aim a little past the minimum time, but never grow more than 10x at once.
+		double scale = state.ElapsedSeconds > 0.0 ? 1.4 * minTime / state.ElapsedSeconds : 10.0;
+		scale = scale < 2.0 ? 2.0 : (scale > 10.0 ? 10.0 : scale);
+		iterations = (std::int64_t)(iterations * scale);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const char* filter = "";
+	double minTime = 0.5;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strncmp(argv[i], "--filter=", 9) == 0)
+			filter = argv[i] + 9;
+		else if (std::strncmp(argv[i], "--min-time=", 11) == 0)
+			minTime = std::atof(argv[i] + 11);
+		else
+		{
+			std::fprintf(stderr, "usage: %s [--filter=<substring>] [--min-time=<seconds>]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	std::printf("%-40s %12s %17s\n", "Benchmark", "Iterations", "Time");
+	for (const BenchmarkRegistration* reg : Registry())
+	{
+		if (reg->Name.find(filter) == std::string::npos)
+			continue;
+
+		if (reg->Args.empty())
+		{
+			RunBenchmark(*reg, 0, false, minTime);
+		}
+		else
+		{
+			for (std::int64_t arg : reg->Args)
+				RunBenchmark(*reg, arg, true, minTime);
+		}
+	}
+
+	return 0;
+}
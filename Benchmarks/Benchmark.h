@@ -0,0 +1,123 @@
+//***************************************************************************************
+// Benchmark.h
+//
+// A small Google-Benchmark-style harness for the CPU frame path.  A benchmark is a
+// function taking a BenchmarkState; the timed part is the body of
+//
+//     for (auto _ : state) { ... }
+//
+// which the harness runs for as many iterations as it needs to fill the minimum
+// measuring time.  Results report ns/op, items/s (if SetItemsProcessed was called)
+// and heap allocations/bytes per iteration.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+class BenchmarkState
+{
+public:
+	BenchmarkState(std::int64_t iterations, std::int64_t arg) :
+		mIterations(iterations), mArg(arg) {
+	}
+
+	// The argument given with Arg(); 0 if the benchmark has none.
+	std::int64_t Arg() const { return mArg; }
+	std::int64_t Iterations() const { return mIterations; }
+
+	// Total number of items (vertices, instances, bones...) processed over all iterations.
+	void SetItemsProcessed(std::int64_t items) { mItemsProcessed = items; }
+	std::int64_t ItemsProcessed() const { return mItemsProcessed; }
+
+	// Excludes setup work inside the timed loop from the measurement.
+	void PauseTiming();
+	void ResumeTiming();
+
+	// What the loop variable binds to; the user-provided destructor keeps compilers
+	// from warning that "_" is unused.
+	struct Value
+	{
+		~Value() {}
+	};
+
+	struct Iterator
+	{
+		BenchmarkState* State;
+		std::int64_t Remaining;
+
+		Value operator*() const { return Value(); }
+		Iterator& operator++() { --Remaining; return *this; }
+		bool operator!=(const Iterator& rhs) const
+		{
+			if (Remaining != rhs.Remaining)
+				return true;
+			State->FinishTiming();
+			return false;
+		}
+	};
+
+	Iterator begin() { StartTiming(); return Iterator{ this, mIterations }; }
+	Iterator end() { return Iterator{ this, 0 }; }
+
+	// Measurements, filled in once the loop has finished.
+	double ElapsedSeconds = 0.0;
+	std::int64_t Allocations = 0;
+	std::int64_t AllocatedBytes = 0;
+
+private:
+	void StartTiming();
+	void FinishTiming();
+
+	std::int64_t mIterations = 0;
+	std::int64_t mArg = 0;
+	std::int64_t mItemsProcessed = 0;
+
+	std::int64_t mStartTicks = 0;
+	std::int64_t mStartAllocations = 0;
+	std::int64_t mStartBytes = 0;
+	bool mPaused = false;
+};
+
+
+using BenchmarkFunction = void(*)(BenchmarkState&);
+
+class BenchmarkRegistration
+{
+public:
+	BenchmarkRegistration(const char* name, BenchmarkFunction function);
+
+	// Runs the benchmark once per argument (e.g. grid size, subdivision level).
+	BenchmarkRegistration* Arg(std::int64_t arg);
+
+	std::string Name;
+	BenchmarkFunction Function;
+	std::vector<std::int64_t> Args;
+};
+
+
+// Keeps the compiler from optimizing away a result that is otherwise unused.
+template<typename T>
+inline void DoNotOptimize(const T& value)
+{
+#if defined(_MSC_VER)
+	extern volatile char gBenchmarkSink;
+	gBenchmarkSink = *reinterpret_cast<const volatile char*>(&value);
+#else
+	asm volatile("" : : "r,m"(value) : "memory");
+#endif
+}
+
+// Directory holding skull.txt, car.txt and soldier.m3d.
+std::string ModelPath(const std::string& filename);
+
+
+#define BENCHMARK_CONCAT_INNER(a, b) a##b
+#define BENCHMARK_CONCAT(a, b) BENCHMARK_CONCAT_INNER(a, b)
+
+#define BENCHMARK(function) \
+	static BenchmarkRegistration* BENCHMARK_CONCAT(gBenchmark_, __LINE__) = \
+		(new BenchmarkRegistration(#function, function))
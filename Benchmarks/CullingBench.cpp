@@ -0,0 +1,645 @@
+//***************************************************************************************
+// CullingBench.cpp
+//
+// The per-frame CPU loops of the Ch16 instancing/culling demo and the Ch17 picking
+// demo.  Both live in D3D12 application classes, so the fixtures rebuild the same
+// scene (skull grid, car, camera) and the loops mirror
+// InstanceCullApp::UpdateInstanceData and PickingApp::Pick.  BM_InstanceCull keeps the
+// original local-space frustum test as the baseline for BM_InstanceCullSoA, and
+// BM_InstanceGroupCull is the tree-plus-ranges path the demo now takes.
+// BM_OcclusionCull adds the occlusion pass of InstanceCullApp::CullOccludedInstances.
+// BM_PickCar keeps the original linear scan over the car's triangles as the baseline
+// for the TriangleBvh picks.
+//***************************************************************************************
+
+#include "Benchmark.h"
+#include "Common/Camera.h"
+#include "Common/DynamicAabbTree.h"
+#include "Common/FrustumCulling.h"
+#include "Common/GeometryGenerator.h"
+#include "Common/OcclusionCulling.h"
+#include "Common/TriangleBvh.h"
+
+#include <DirectXCollision.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+using namespace DirectX;
+
+
+namespace
+{
+	// Same layout as InstanceData in FrameResource.h.
+	struct InstanceData
+	{
+		XMFLOAT4X4 World = MathHelper::Identity4x4();
+		XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
+		UINT MaterialIndex;
+		UINT InstancePad0;
+		UINT InstancePad1;
+		UINT InstancePad2;
+	};
+
+	struct TextMesh
+	{
+		std::vector<XMFLOAT3> Positions;
+		std::vector<std::uint32_t> Indices;
+		BoundingBox Bounds;
+	};
+
+	// Reads the skull.txt/car.txt format: positions and normals, then triangles.
+	TextMesh LoadTextMesh(const std::string& filename)
+	{
+		std::ifstream fin(filename);
+		if (!fin)
+		{
+			std::fprintf(stderr, "%s not found.\n", filename.c_str());
+			std::exit(1);
+		}
+
+		UINT vcount = 0;
+		UINT tcount = 0;
+		std::string ignore;
+
+		fin >> ignore >> vcount;
+		fin >> ignore >> tcount;
+		fin >> ignore >> ignore >> ignore >> ignore;
+
+		TextMesh mesh;
+		mesh.Positions.resize(vcount);
+
+		XMVECTOR vMin = XMVectorReplicate(+MathHelper::Infinity);
+		XMVECTOR vMax = XMVectorReplicate(-MathHelper::Infinity);
+		for (UINT i = 0; i < vcount; ++i)
+		{
+			XMFLOAT3 n;
+			fin >> mesh.Positions[i].x >> mesh.Positions[i].y >> mesh.Positions[i].z;
+			fin >> n.x >> n.y >> n.z;
+
+			XMVECTOR P = XMLoadFloat3(&mesh.Positions[i]);
+			vMin = XMVectorMin(vMin, P);
+			vMax = XMVectorMax(vMax, P);
+		}
+
+		XMStoreFloat3(&mesh.Bounds.Center, 0.5f * (vMin + vMax));
+		XMStoreFloat3(&mesh.Bounds.Extents, 0.5f * (vMax - vMin));
+
+		fin >> ignore;
+		fin >> ignore;
+		fin >> ignore;
+
+		mesh.Indices.resize(3 * tcount);
+		for (UINT i = 0; i < tcount; ++i)
+		{
+			fin >> mesh.Indices[i * 3 + 0] >> mesh.Indices[i * 3 + 1] >> mesh.Indices[i * 3 + 2];
+		}
+
+		return mesh;
+	}
+
+	const TextMesh& Skull()
+	{
+		static TextMesh mesh = LoadTextMesh(ModelPath("skull.txt"));
+		return mesh;
+	}
+
+	const TextMesh& Car()
+	{
+		static TextMesh mesh = LoadTextMesh(ModelPath("car.txt"));
+		return mesh;
+	}
+
+	Camera MakeDemoCamera()
+	{
+		Camera camera;
+		camera.SetPosition(0.0f, 2.0f, -15.0f);
+		camera.SetLens(0.25f * MathHelper::Pi, 800.0f / 600.0f, 1.0f, 1000.0f);
+		camera.UpdateViewMatrix();
+		return camera;
+	}
+
+	// Inside the grid near its (-100, -100, -100) corner, looking into the corner, so
+	// only a few skulls are in view.
+	Camera MakeCornerCamera()
+	{
+		Camera camera;
+		camera.LookAt(XMFLOAT3(-70.0f, -70.0f, -70.0f), XMFLOAT3(-100.0f, -100.0f, -100.0f), XMFLOAT3(0.0f, 1.0f, 0.0f));
+		camera.SetLens(0.25f * MathHelper::Pi, 800.0f / 600.0f, 1.0f, 1000.0f);
+		camera.UpdateViewMatrix();
+		return camera;
+	}
+
+	// The object-space ray through one of a fixed pattern of screen positions around
+	// the window centre, as PickingApp::Pick makes it.
+	void MakePickRay(const Camera& camera, int sample, FXMMATRIX world, XMVECTOR& rayOrigin, XMVECTOR& rayDir)
+	{
+		const int clientWidth = 800;
+		const int clientHeight = 600;
+
+		int sx = clientWidth / 2 + 20 * (sample % 5 - 2);
+		int sy = clientHeight / 2 + 20 * ((sample / 5) % 5 - 2);
+
+		XMFLOAT4X4 P = camera.GetProj4x4f();
+
+		float vx = (+2.f * sx / clientWidth - 1.f) / P(0, 0);
+		float vy = (-2.f * sy / clientHeight + 1.f) / P(1, 1);
+
+		rayOrigin = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+		rayDir = XMVectorSet(vx, vy, 1.0f, 0.0f);
+
+		XMMATRIX V = camera.GetView();
+		XMVECTOR viewDet = XMMatrixDeterminant(V);
+		XMMATRIX invView = XMMatrixInverse(&viewDet, V);
+
+		XMVECTOR worldDet = XMMatrixDeterminant(world);
+		XMMATRIX invWorld = XMMatrixInverse(&worldDet, world);
+
+		XMMATRIX toLocal = XMMatrixMultiply(invView, invWorld);
+
+		rayOrigin = XMVector3TransformCoord(rayOrigin, toLocal);
+		rayDir = XMVector3Normalize(XMVector3TransformNormal(rayDir, toLocal));
+	}
+
+	// The n*n*n grid of skulls spread over a 200^3 volume (BuildRenderItems in Ch16).
+	std::vector<InstanceData> MakeSkullGrid(int n)
+	{
+		std::vector<InstanceData> instances(n * n * n);
+
+		float width = 200.0f;
+		float height = 200.0f;
+		float depth = 200.0f;
+
+		float x = -0.5f * width;
+		float y = -0.5f * height;
+		float z = -0.5f * depth;
+		float dx = width / (n - 1);
+		float dy = height / (n - 1);
+		float dz = depth / (n - 1);
+		for (int k = 0; k < n; ++k)
+		{
+			for (int i = 0; i < n; ++i)
+			{
+				for (int j = 0; j < n; ++j)
+				{
+					int index = k * n * n + i * n + j;
+					instances[index].World = XMFLOAT4X4(
+						1.0f, 0.0f, 0.0f, 0.0f,
+						0.0f, 1.0f, 0.0f, 0.0f,
+						0.0f, 0.0f, 1.0f, 0.0f,
+						x + j * dx, y + i * dy, z + k * dz, 1.0f
+					);
+					XMStoreFloat4x4(&instances[index].TexTransform, XMMatrixScaling(2.0f, 2.0f, 1.0f));
+					instances[index].MaterialIndex = index % 7;
+				}
+			}
+		}
+
+		return instances;
+	}
+}
+
+// Arg is the number of skulls along each axis; the demo uses 11 (1331 instances).
+static void BM_InstanceCull(BenchmarkState& state)
+{
+	const BoundingBox& bounds = Skull().Bounds;
+	const std::vector<InstanceData> instanceData = MakeSkullGrid((int)state.Arg());
+	std::vector<InstanceData> instanceBuffer(instanceData.size());
+
+	Camera camera = MakeDemoCamera();
+	BoundingFrustum camFrustum;
+	BoundingFrustum::CreateFromMatrix(camFrustum, camera.GetProj());
+
+	for (auto _ : state)
+	{
+		XMMATRIX view = camera.GetView();
+		XMVECTOR viewDet = XMMatrixDeterminant(view);
+		XMMATRIX invView = XMMatrixInverse(&viewDet, view);
+
+		int visibleInstanceCount = 0;
+		for (UINT i = 0; i < (UINT)instanceData.size(); ++i)
+		{
+			XMMATRIX world = XMLoadFloat4x4(&instanceData[i].World);
+			XMMATRIX texTransform = XMLoadFloat4x4(&instanceData[i].TexTransform);
+			XMVECTOR worldDet = XMMatrixDeterminant(world);
+			XMMATRIX invWorld = XMMatrixInverse(&worldDet, world);
+
+			XMMATRIX viewToLocal = XMMatrixMultiply(invView, invWorld);
+
+			BoundingFrustum localSpaceFrustum;
+			camFrustum.Transform(localSpaceFrustum, viewToLocal);
+
+			if (localSpaceFrustum.Contains(bounds) != DirectX::DISJOINT)
+			{
+				InstanceData data;
+				XMStoreFloat4x4(&data.World, XMMatrixTranspose(world));
+				XMStoreFloat4x4(&data.TexTransform, XMMatrixTranspose(texTransform));
+				data.MaterialIndex = instanceData[i].MaterialIndex;
+
+				instanceBuffer[visibleInstanceCount++] = data;
+			}
+		}
+
+		DoNotOptimize(visibleInstanceCount);
+	}
+
+	state.SetItemsProcessed(state.Iterations() * instanceData.size());
+}
+BENCHMARK(BM_InstanceCull)->Arg(11)->Arg(21)->Arg(47);
+
+// World-space bounds tested LaneWidth at a time, survivors written as they are found.
+static void BM_InstanceCullSoA(BenchmarkState& state)
+{
+	const BoundingBox& bounds = Skull().Bounds;
+	const std::vector<InstanceData> instanceData = MakeSkullGrid((int)state.Arg());
+	std::vector<InstanceData> instanceBuffer(instanceData.size());
+
+	CullingBounds instanceBounds;
+	instanceBounds.Reserve(instanceData.size());
+	for (const InstanceData& instance : instanceData)
+		instanceBounds.Add(bounds, XMLoadFloat4x4(&instance.World));
+
+	Camera camera = MakeDemoCamera();
+
+	for (auto _ : state)
+	{
+		FrustumPlanes camFrustum;
+		ExtractFrustumPlanes(camFrustum, XMMatrixMultiply(camera.GetView(), camera.GetProj()));
+
+		int visibleInstanceCount = 0;
+		CullBounds(camFrustum, instanceBounds, 0, (UINT)instanceData.size(), [&](UINT i)
+		{
+			InstanceData* data = &instanceBuffer[visibleInstanceCount++];
+			XMStoreFloat4x4(&data->World, XMMatrixTranspose(XMLoadFloat4x4(&instanceData[i].World)));
+			XMStoreFloat4x4(&data->TexTransform, XMMatrixTranspose(XMLoadFloat4x4(&instanceData[i].TexTransform)));
+			data->MaterialIndex = instanceData[i].MaterialIndex;
+		});
+
+		DoNotOptimize(visibleInstanceCount);
+	}
+
+	state.SetItemsProcessed(state.Iterations() * instanceData.size());
+}
+BENCHMARK(BM_InstanceCullSoA)->Arg(11)->Arg(21)->Arg(47);
+
+// The same on the task scheduler: chunks cull, a prefix sum places them, and each
+// chunk writes its own run of the buffer.
+static void BM_InstanceCullParallel(BenchmarkState& state)
+{
+	const BoundingBox& bounds = Skull().Bounds;
+	const std::vector<InstanceData> instanceData = MakeSkullGrid((int)state.Arg());
+	std::vector<InstanceData> instanceBuffer(instanceData.size());
+
+	CullingBounds instanceBounds;
+	instanceBounds.Reserve(instanceData.size());
+	for (const InstanceData& instance : instanceData)
+		instanceBounds.Add(bounds, XMLoadFloat4x4(&instance.World));
+
+	CullingScratch scratch;
+	Camera camera = MakeDemoCamera();
+
+	for (auto _ : state)
+	{
+		FrustumPlanes camFrustum;
+		ExtractFrustumPlanes(camFrustum, XMMatrixMultiply(camera.GetView(), camera.GetProj()));
+
+		UINT visibleInstanceCount = ParallelCullBounds(camFrustum, instanceBounds, scratch, [&](UINT i, UINT slot)
+		{
+			InstanceData* data = &instanceBuffer[slot];
+			XMStoreFloat4x4(&data->World, XMMatrixTranspose(XMLoadFloat4x4(&instanceData[i].World)));
+			XMStoreFloat4x4(&data->TexTransform, XMMatrixTranspose(XMLoadFloat4x4(&instanceData[i].TexTransform)));
+			data->MaterialIndex = instanceData[i].MaterialIndex;
+		});
+
+		DoNotOptimize(visibleInstanceCount);
+	}
+
+	state.SetItemsProcessed(state.Iterations() * instanceData.size());
+}
+BENCHMARK(BM_InstanceCullParallel)->Arg(11)->Arg(21)->Arg(47);
+
+// The frustum query of the instance tree, from the demo's camera or from the corner,
+// against BM_InstanceCullSoA's flat test of every box.
+static void InstanceTreeCull(BenchmarkState& state, const Camera& camera)
+{
+	const BoundingBox& bounds = Skull().Bounds;
+	const std::vector<InstanceData> instanceData = MakeSkullGrid((int)state.Arg());
+
+	DynamicAabbTree tree;
+	for (UINT i = 0; i < (UINT)instanceData.size(); ++i)
+	{
+		BoundingBox worldBounds;
+		bounds.Transform(worldBounds, XMLoadFloat4x4(&instanceData[i].World));
+		tree.CreateProxy(worldBounds, i);
+	}
+
+	std::vector<UINT> visibleInstances;
+	for (auto _ : state)
+	{
+		FrustumPlanes camFrustum;
+		ExtractFrustumPlanes(camFrustum, XMMatrixMultiply(camera.GetView(), camera.GetProj()));
+
+		visibleInstances.clear();
+		tree.QueryFrustum(camFrustum, [&](UINT i) { visibleInstances.push_back(i); });
+
+		DoNotOptimize(visibleInstances.data());
+	}
+
+	state.SetItemsProcessed(state.Iterations() * instanceData.size());
+}
+
+static void BM_InstanceTreeCull(BenchmarkState& state)
+{
+	InstanceTreeCull(state, MakeDemoCamera());
+}
+BENCHMARK(BM_InstanceTreeCull)->Arg(11)->Arg(47);
+
+static void BM_InstanceTreeCullCorner(BenchmarkState& state)
+{
+	InstanceTreeCull(state, MakeCornerCamera());
+}
+BENCHMARK(BM_InstanceTreeCullCorner)->Arg(11)->Arg(47);
+
+// InstanceCullApp's path: the tree holds groups of 64 consecutive instances, and the
+// boxes of the groups it keeps are tested and written with ParallelCullRanges.
+static void InstanceGroupCull(BenchmarkState& state, const Camera& camera)
+{
+	const UINT groupSize = 64;
+
+	const BoundingBox& bounds = Skull().Bounds;
+	const std::vector<InstanceData> instanceData = MakeSkullGrid((int)state.Arg());
+	const UINT instanceCount = (UINT)instanceData.size();
+	std::vector<InstanceData> instanceBuffer(instanceCount);
+
+	CullingBounds instanceBounds;
+	instanceBounds.Reserve(instanceCount);
+	for (const InstanceData& instance : instanceData)
+		instanceBounds.Add(bounds, XMLoadFloat4x4(&instance.World));
+
+	DynamicAabbTree tree;
+	for (UINT first = 0; first < instanceCount; first += groupSize)
+	{
+		BoundingBox groupBounds = instanceBounds.Get(first);
+		for (UINT i = first + 1; i < std::min<UINT>(first + groupSize, instanceCount); ++i)
+			BoundingBox::CreateMerged(groupBounds, groupBounds, instanceBounds.Get(i));
+		tree.CreateProxy(groupBounds, first / groupSize);
+	}
+
+	std::vector<CullingRange> visibleRanges;
+	CullingScratch scratch;
+	for (auto _ : state)
+	{
+		FrustumPlanes camFrustum;
+		ExtractFrustumPlanes(camFrustum, XMMatrixMultiply(camera.GetView(), camera.GetProj()));
+
+		visibleRanges.clear();
+		tree.QueryFrustum(camFrustum, [&](UINT group)
+		{
+			const UINT first = group * groupSize;
+			visibleRanges.push_back({ first, std::min<UINT>(first + groupSize, instanceCount) });
+		});
+
+		UINT visibleInstanceCount = ParallelCullRanges(camFrustum, instanceBounds, visibleRanges, scratch, [&](UINT i, UINT slot)
+		{
+			InstanceData* data = &instanceBuffer[slot];
+			XMStoreFloat4x4(&data->World, XMMatrixTranspose(XMLoadFloat4x4(&instanceData[i].World)));
+			XMStoreFloat4x4(&data->TexTransform, XMMatrixTranspose(XMLoadFloat4x4(&instanceData[i].TexTransform)));
+			data->MaterialIndex = instanceData[i].MaterialIndex;
+		});
+
+		DoNotOptimize(visibleInstanceCount);
+	}
+
+	state.SetItemsProcessed(state.Iterations() * instanceCount);
+}
+
+static void BM_InstanceGroupCull(BenchmarkState& state)
+{
+	InstanceGroupCull(state, MakeDemoCamera());
+}
+BENCHMARK(BM_InstanceGroupCull)->Arg(11)->Arg(47);
+
+static void BM_InstanceGroupCullCorner(BenchmarkState& state)
+{
+	InstanceGroupCull(state, MakeCornerCamera());
+}
+BENCHMARK(BM_InstanceGroupCullCorner)->Arg(11)->Arg(47);
+
+// Every skull drifts a little each iteration; most stay inside their fat boxes.
+static void BM_InstanceTreeMove(BenchmarkState& state)
+{
+	const BoundingBox& bounds = Skull().Bounds;
+	const std::vector<InstanceData> instanceData = MakeSkullGrid((int)state.Arg());
+
+	DynamicAabbTree tree(0.5f);
+	std::vector<int> proxies(instanceData.size());
+	std::vector<BoundingBox> worldBounds(instanceData.size());
+	for (UINT i = 0; i < (UINT)instanceData.size(); ++i)
+	{
+		bounds.Transform(worldBounds[i], XMLoadFloat4x4(&instanceData[i].World));
+		proxies[i] = tree.CreateProxy(worldBounds[i], i);
+	}
+
+	int frame = 0;
+	for (auto _ : state)
+	{
+		const float dx = 0.05f * ((frame++ % 40) < 20 ? 1.0f : -1.0f);
+		for (UINT i = 0; i < (UINT)proxies.size(); ++i)
+		{
+			worldBounds[i].Center.x += dx;
+			tree.MoveProxy(proxies[i], worldBounds[i]);
+		}
+	}
+
+	DoNotOptimize(tree.Height());
+	state.SetItemsProcessed(state.Iterations() * proxies.size());
+}
+BENCHMARK(BM_InstanceTreeMove)->Arg(11)->Arg(47);
+
+// The frustum query, then the nearest 32 visible skulls' interior boxes rasterized into
+// the occlusion buffer and every visible skull tested against it.  At 47 the skulls
+// overlap and most of the grid in view is hidden.
+static void BM_OcclusionCull(BenchmarkState& state)
+{
+	const TextMesh& skull = Skull();
+	const std::vector<InstanceData> instanceData = MakeSkullGrid((int)state.Arg());
+
+	BoundingBox occluderBounds;
+	if (!ComputeInteriorBox(skull.Positions.data(), sizeof(XMFLOAT3), skull.Positions.size(),
+		skull.Indices.data(), skull.Indices.size(), occluderBounds))
+	{
+		std::fprintf(stderr, "No interior box found for the skull.\n");
+		std::exit(1);
+	}
+
+	DynamicAabbTree tree;
+	std::vector<int> proxies(instanceData.size());
+	for (UINT i = 0; i < (UINT)instanceData.size(); ++i)
+	{
+		BoundingBox worldBounds;
+		skull.Bounds.Transform(worldBounds, XMLoadFloat4x4(&instanceData[i].World));
+		proxies[i] = tree.CreateProxy(worldBounds, i);
+	}
+
+	const Camera camera = MakeDemoCamera();
+	const XMMATRIX viewProj = XMMatrixMultiply(camera.GetView(), camera.GetProj());
+	const XMVECTOR eyePos = camera.GetPosition();
+
+	OcclusionBuffer occlusionBuffer(256, 192);
+	std::vector<UINT> visibleInstances;
+	std::vector<std::pair<float, UINT>> candidates;
+	std::size_t unoccludedCount = 0;
+	for (auto _ : state)
+	{
+		FrustumPlanes camFrustum;
+		ExtractFrustumPlanes(camFrustum, viewProj);
+
+		visibleInstances.clear();
+		tree.QueryFrustum(camFrustum, [&](UINT i) { visibleInstances.push_back(i); });
+
+		candidates.clear();
+		for (UINT i : visibleInstances)
+		{
+			XMVECTOR center = XMVector3Transform(XMLoadFloat3(&skull.Bounds.Center), XMLoadFloat4x4(&instanceData[i].World));
+			candidates.emplace_back(XMVectorGetX(XMVector3LengthSq(center - eyePos)), i);
+		}
+
+		const std::size_t occluderCount = std::min<std::size_t>(candidates.size(), 32);
+		std::partial_sort(candidates.begin(), candidates.begin() + occluderCount, candidates.end());
+
+		occlusionBuffer.Clear(viewProj);
+		for (std::size_t k = 0; k < occluderCount; ++k)
+			occlusionBuffer.RenderOccluderBox(occluderBounds, XMLoadFloat4x4(&instanceData[candidates[k].second].World));
+		occlusionBuffer.FinishOccluders();
+
+		unoccludedCount = 0;
+		for (UINT i : visibleInstances)
+		{
+			if (occlusionBuffer.IsVisible(tree.GetFatBox(proxies[i])))
+				visibleInstances[unoccludedCount++] = i;
+		}
+
+		DoNotOptimize(unoccludedCount);
+	}
+
+	state.SetItemsProcessed(state.Iterations() * instanceData.size());
+}
+BENCHMARK(BM_OcclusionCull)->Arg(11)->Arg(47);
+
+// Picks the car from a fixed pattern of screen positions around the window centre.
+static void BM_PickCar(BenchmarkState& state)
+{
+	const TextMesh& car = Car();
+	const UINT triCount = (UINT)car.Indices.size() / 3;
+
+	const XMMATRIX carWorld = XMMatrixTranslation(0.0f, 1.0f, 0.0f);
+	const Camera camera = MakeDemoCamera();
+
+	int sample = 0;
+	int hits = 0;
+	for (auto _ : state)
+	{
+		XMVECTOR rayOrigin, rayDir;
+		MakePickRay(camera, sample++, carWorld, rayOrigin, rayDir);
+
+		float tmin = 0.0f;
+		if (car.Bounds.Intersects(rayOrigin, rayDir, tmin))
+		{
+			tmin = MathHelper::Infinity;
+			for (UINT i = 0; i < triCount; ++i)
+			{
+				XMVECTOR v0 = XMLoadFloat3(&car.Positions[car.Indices[i * 3 + 0]]);
+				XMVECTOR v1 = XMLoadFloat3(&car.Positions[car.Indices[i * 3 + 1]]);
+				XMVECTOR v2 = XMLoadFloat3(&car.Positions[car.Indices[i * 3 + 2]]);
+
+				float t = 0.0f;
+				if (TriangleTests::Intersects(rayOrigin, rayDir, v0, v1, v2, t) && t < tmin)
+				{
+					tmin = t;
+					++hits;
+				}
+			}
+		}
+	}
+
+	DoNotOptimize(hits);
+	state.SetItemsProcessed(state.Iterations());
+}
+BENCHMARK(BM_PickCar);
+
+// The same picks through the car's TriangleBvh.
+static void BM_PickCarBvh(BenchmarkState& state)
+{
+	const TextMesh& car = Car();
+
+	TriangleBvh bvh;
+	bvh.Build(car.Positions.data(), sizeof(XMFLOAT3), car.Positions.size(), car.Indices.data(), car.Indices.size());
+
+	const XMMATRIX carWorld = XMMatrixTranslation(0.0f, 1.0f, 0.0f);
+	const Camera camera = MakeDemoCamera();
+
+	int sample = 0;
+	int hits = 0;
+	for (auto _ : state)
+	{
+		XMVECTOR rayOrigin, rayDir;
+		MakePickRay(camera, sample++, carWorld, rayOrigin, rayDir);
+
+		float tmin = 0.0f;
+		UINT triangle = 0;
+		if (bvh.Intersects(rayOrigin, rayDir, tmin, triangle))
+			++hits;
+	}
+
+	DoNotOptimize(hits);
+	state.SetItemsProcessed(state.Iterations());
+}
+BENCHMARK(BM_PickCarBvh);
+
+// Arg is the sphere's slice count, with half as many stacks: 2048 makes about 4.2
+// million triangles.
+static void BM_PickSphereBvh(BenchmarkState& state)
+{
+	GeometryGenerator geoGen;
+	const GeometryGenerator::uint32 slices = (GeometryGenerator::uint32)state.Arg();
+	const GeometryGenerator::MeshData sphere = geoGen.CreateSphere(5.0f, slices, slices / 2);
+
+	TriangleBvh bvh;
+	bvh.Build(&sphere.Vertices[0].Position, sizeof(GeometryGenerator::Vertex), sphere.Vertices.size(),
+		sphere.Indices32.data(), sphere.Indices32.size());
+
+	const XMMATRIX sphereWorld = XMMatrixTranslation(0.0f, 1.0f, 0.0f);
+	const Camera camera = MakeDemoCamera();
+
+	int sample = 0;
+	int hits = 0;
+	for (auto _ : state)
+	{
+		XMVECTOR rayOrigin, rayDir;
+		MakePickRay(camera, sample++, sphereWorld, rayOrigin, rayDir);
+
+		float tmin = 0.0f;
+		UINT triangle = 0;
+		if (bvh.Intersects(rayOrigin, rayDir, tmin, triangle))
+			++hits;
+	}
+
+	DoNotOptimize(hits);
+	state.SetItemsProcessed(state.Iterations());
+}
+BENCHMARK(BM_PickSphereBvh)->Arg(256)->Arg(2048);
+
+static void BM_TriangleBvhBuild(BenchmarkState& state)
+{
+	const TextMesh& car = Car();
+
+	TriangleBvh bvh;
+	for (auto _ : state)
+	{
+		bvh.Build(car.Positions.data(), sizeof(XMFLOAT3), car.Positions.size(), car.Indices.data(), car.Indices.size());
+		DoNotOptimize(bvh.NodeCount());
+	}
+
+	state.SetItemsProcessed(state.Iterations() * car.Indices.size() / 3);
+}
+BENCHMARK(BM_TriangleBvhBuild);
@@ -0,0 +1,61 @@
+//***************************************************************************************
+// GeometryBench.cpp
+//
+// Procedural mesh generation at several tessellation levels, and packing the result
+// into the compact vertex format.
+//***************************************************************************************
+
+#include "Benchmark.h"
+#include "Common/GeometryGenerator.h"
+#include "Common/VertexPacking.h"
+
+
+static void BM_CreateGeosphere(BenchmarkState& state)
+{
+	GeometryGenerator geoGen;
+	std::int64_t vertices = 0;
+
+	for (auto _ : state)
+	{
+		GeometryGenerator::MeshData mesh = geoGen.CreateGeosphere(0.5f, (GeometryGenerator::uint32)state.Arg());
+		vertices += mesh.Vertices.size();
+		DoNotOptimize(mesh.Indices32.data());
+	}
+
+	state.SetItemsProcessed(vertices);
+}
+BENCHMARK(BM_CreateGeosphere)->Arg(2)->Arg(3)->Arg(4)->Arg(5);
+
+static void BM_CreateSphere(BenchmarkState& state)
+{
+	GeometryGenerator geoGen;
+	std::int64_t vertices = 0;
+
+	for (auto _ : state)
+	{
+		GeometryGenerator::uint32 slices = (GeometryGenerator::uint32)state.Arg();
+		GeometryGenerator::MeshData mesh = geoGen.CreateSphere(0.5f, slices, slices);
+		vertices += mesh.Vertices.size();
+		DoNotOptimize(mesh.Indices32.data());
+	}
+
+	state.SetItemsProcessed(vertices);
+}
+BENCHMARK(BM_CreateSphere)->Arg(20)->Arg(64)->Arg(256);
+
+static void BM_PackVertices(BenchmarkState& state)
+{
+	GeometryGenerator geoGen;
+	GeometryGenerator::MeshData mesh = geoGen.CreateGeosphere(0.5f, 5);
+	std::int64_t vertices = 0;
+
+	for (auto _ : state)
+	{
+		std::vector<PackedVertex> packed = PackVertices(mesh.Vertices);
+		DoNotOptimize(packed.data());
+		vertices += packed.size();
+	}
+
+	state.SetItemsProcessed(vertices);
+}
+BENCHMARK(BM_PackVertices);
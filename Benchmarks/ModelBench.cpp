@@ -0,0 +1,277 @@
+//***************************************************************************************
+// ModelBench.cpp
+//
+// Loading the skull mesh from text (serially and on the thread pool), from its binary
+// (.meshb) form and from the derived data cache, reordering it for the GPU, and a
+// small scene through the AssetLoader.
+//***************************************************************************************
+
+#include "Benchmark.h"
+#include "Common/AssetLoader.h"
+#include "Common/DerivedDataCache.h"
+#include "Common/MappedFile.h"
+#include "Common/MeshFile.h"
+#include "Common/MeshOptimizer.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+
+
+namespace
+{
+	// skull.txt converted once per run, as the ModelConverter tool would.
+	const std::string& SkullBinaryPath()
+	{
+		static std::string path = []
+			{
+				std::string binaryPath = (std::filesystem::temp_directory_path() / "skull.meshb").string();
+
+				std::vector<MeshFileVertex> vertices;
+				std::vector<std::uint32_t> indices;
+				if (!LoadTextMesh(ModelPath("skull.txt"), vertices, indices) ||
+					!SaveBinaryMesh(binaryPath, vertices, indices))
+				{
+					std::fprintf(stderr, "Could not convert %s.\n", ModelPath("skull.txt").c_str());
+					std::exit(1);
+				}
+				return binaryPath;
+			}();
+		return path;
+	}
+
+	struct TextMesh
+	{
+		std::vector<MeshFileVertex> Vertices;
+		std::vector<std::uint32_t> Indices;
+	};
+
+	const TextMesh& Skull()
+	{
+		static TextMesh skull = []
+			{
+				TextMesh mesh;
+				LoadTextMesh(ModelPath("skull.txt"), mesh.Vertices, mesh.Indices);
+				return mesh;
+			}();
+		return skull;
+	}
+
+	const char* SceneTextures[] = { "bricks2.dds", "bricks2_nmap.dds", "tile.dds", "tile_nmap.dds", "desertcube1024.dds" };
+
+	std::string TexturePath(const char* filename)
+	{
+		// Textures/ sits next to Models/.
+		return ModelPath(std::string("../Textures/") + filename);
+	}
+}
+
+static void BM_LoadTextMesh(BenchmarkState& state)
+{
+	std::int64_t vertices = 0;
+
+	for (auto _ : state)
+	{
+		std::vector<MeshFileVertex> meshVertices;
+		std::vector<std::uint32_t> meshIndices;
+		LoadTextMesh(ModelPath("skull.txt"), meshVertices, meshIndices);
+		vertices += meshVertices.size();
+	}
+
+	state.SetItemsProcessed(vertices);
+}
+BENCHMARK(BM_LoadTextMesh);
+
+static void BM_LoadTextMeshParallel(BenchmarkState& state)
+{
+	std::int64_t vertices = 0;
+
+	for (auto _ : state)
+	{
+		std::vector<MeshFileVertex> meshVertices;
+		std::vector<std::uint32_t> meshIndices;
+		LoadTextMeshParallel(ModelPath("skull.txt"), meshVertices, meshIndices);
+		vertices += meshVertices.size();
+	}
+
+	state.SetItemsProcessed(vertices);
+}
+BENCHMARK(BM_LoadTextMeshParallel);
+
+static void BM_ComputeMeshBounds(BenchmarkState& state)
+{
+	BinaryMesh mesh;
+	mesh.Open(SkullBinaryPath());
+	ArrayView<MeshFileVertex> meshVertices = mesh.Vertices();
+	std::int64_t vertices = 0;
+
+	for (auto _ : state)
+	{
+		DirectX::BoundingBox bounds = ComputeMeshBounds(meshVertices.data(), meshVertices.size());
+		DoNotOptimize(bounds);
+		vertices += meshVertices.size();
+	}
+
+	state.SetItemsProcessed(vertices);
+}
+BENCHMARK(BM_ComputeMeshBounds);
+
+// Maps the file and sums the positions so every page is actually read.
+static void BM_OpenBinaryMesh(BenchmarkState& state)
+{
+	const std::string& path = SkullBinaryPath();
+	std::int64_t vertices = 0;
+
+	for (auto _ : state)
+	{
+		BinaryMesh mesh;
+		mesh.Open(path);
+
+		float sum = 0.0f;
+		for (const MeshFileVertex& v : mesh.Vertices())
+			sum += v.Pos.x;
+		DoNotOptimize(sum);
+
+		vertices += mesh.Vertices().size();
+	}
+
+	state.SetItemsProcessed(vertices);
+}
+BENCHMARK(BM_OpenBinaryMesh);
+
+static void BM_OptimizeVertexCache(BenchmarkState& state)
+{
+	const TextMesh& skull = Skull();
+	std::int64_t triangles = 0;
+
+	for (auto _ : state)
+	{
+		state.PauseTiming();
+		std::vector<std::uint32_t> indices = skull.Indices;
+		state.ResumeTiming();
+
+		OptimizeVertexCache(indices.data(), indices.size(), skull.Vertices.size());
+		triangles += indices.size() / 3;
+	}
+
+	state.SetItemsProcessed(triangles);
+}
+BENCHMARK(BM_OptimizeVertexCache);
+
+// All three passes, as the apps run them after loading the skull.
+static void BM_OptimizeMesh(BenchmarkState& state)
+{
+	const TextMesh& skull = Skull();
+	std::int64_t triangles = 0;
+
+	for (auto _ : state)
+	{
+		state.PauseTiming();
+		TextMesh mesh = skull;
+		state.ResumeTiming();
+
+		MeshOptimizationStats stats = OptimizeMesh(mesh.Vertices, mesh.Indices);
+		DoNotOptimize(stats);
+		triangles += stats.TriangleCount;
+	}
+
+	state.SetItemsProcessed(triangles);
+}
+BENCHMARK(BM_OptimizeMesh);
+
+// A warm start of an app's skull: hash skull.txt for the key, then load the entry the
+// first run stored.  Compare with BM_LoadTextMeshParallel, which the cold start pays
+// before deriving anything.
+static void BM_LoadDerivedMesh(BenchmarkState& state)
+{
+	DerivedDataCache cache((std::filesystem::temp_directory_path() / "DerivedDataCacheBench").string());
+	{
+		DerivedDataKey key("ModelBench skull", 1);
+		key.AddFile(ModelPath("skull.txt"));
+
+		std::vector<MeshFileVertex> meshVertices;
+		std::vector<std::uint32_t> meshIndices;
+		LoadTextMesh(ModelPath("skull.txt"), meshVertices, meshIndices);
+
+		DerivedSubmesh submesh;
+		submesh.IndexCount = (UINT)meshIndices.size();
+		submesh.Bounds = ComputeMeshBounds(meshVertices.data(), meshVertices.size());
+
+		DerivedMesh mesh;
+		mesh.SetVertices(meshVertices);
+		mesh.SetIndices(meshIndices);
+		mesh.AddSubmesh("skull", submesh);
+		if (!cache.StoreMesh(key, mesh))
+		{
+			std::fprintf(stderr, "Could not store %s.\n", cache.EntryPath(key).c_str());
+			std::exit(1);
+		}
+	}
+
+	std::int64_t vertices = 0;
+
+	for (auto _ : state)
+	{
+		DerivedDataKey key("ModelBench skull", 1);
+		key.AddFile(ModelPath("skull.txt"));
+
+		DerivedMesh mesh;
+		cache.LoadMesh(key, mesh);
+		vertices += mesh.VertexData.size() / sizeof(MeshFileVertex);
+	}
+
+	state.SetItemsProcessed(vertices);
+}
+BENCHMARK(BM_LoadDerivedMesh);
+
+// The skull, the car and a few textures one after the other, as the apps' Initialize
+// used to, against the same files through an AssetLoader.
+static void BM_LoadSceneSerial(BenchmarkState& state)
+{
+	for (auto _ : state)
+	{
+		TextMesh skull;
+		TextMesh car;
+		LoadTextMesh(ModelPath("skull.txt"), skull.Vertices, skull.Indices);
+		LoadTextMesh(ModelPath("car.txt"), car.Vertices, car.Indices);
+
+		std::size_t textureBytes = 0;
+		for (const char* texture : SceneTextures)
+		{
+			MappedFile file;
+			file.Open(TexturePath(texture));
+			std::vector<char> bytes((const char*)file.Data(), (const char*)file.Data() + file.Size());
+			textureBytes += bytes.size();
+		}
+		DoNotOptimize(textureBytes);
+	}
+}
+BENCHMARK(BM_LoadSceneSerial);
+
+static void BM_LoadSceneAsync(BenchmarkState& state)
+{
+	AssetLoader loader;
+
+	for (auto _ : state)
+	{
+		auto loadMesh = [](const std::string& filename)
+			{
+				return [filename](TextMesh& mesh)
+					{
+						return LoadTextMeshParallel(filename, mesh.Vertices, mesh.Indices);
+					};
+			};
+
+		AssetHandle<TextMesh> skull = loader.Load<TextMesh>(loadMesh(ModelPath("skull.txt")));
+		AssetHandle<TextMesh> car = loader.Load<TextMesh>(loadMesh(ModelPath("car.txt")));
+
+		std::vector<AssetHandle<std::vector<char>>> textures;
+		for (const char* texture : SceneTextures)
+			textures.push_back(loader.LoadFileBytes(TexturePath(texture)));
+
+		loader.WaitIdle();
+		loader.DispatchCompletions();
+		DoNotOptimize(skull.Get().Vertices.size() + car.Get().Vertices.size() + textures.size());
+	}
+}
+BENCHMARK(BM_LoadSceneAsync);
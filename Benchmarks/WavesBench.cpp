@@ -0,0 +1,37 @@
+//***************************************************************************************
+// WavesBench.cpp
+//
+// One fixed simulation step of Waves at several grid sizes.
+//***************************************************************************************
+
+#include "Benchmark.h"
+#include "Common/Waves.h"
+
+#include <cstdlib>
+
+
+static void BM_WavesUpdate(BenchmarkState& state)
+{
+	const int n = (int)state.Arg();
+	const float timeStep = 0.03f;
+
+	Waves waves(n, n, 1.0f, timeStep, 4.0f, 0.2f);
+
+	// Get the whole surface moving first, so no row has settled.
+	std::srand(1);
+	for (int k = 0; k < 4 * n; ++k)
+	{
+		waves.Disturb(2 + std::rand() % (n - 4), 2 + std::rand() % (n - 4), 0.5f);
+		waves.Update(timeStep);
+	}
+
+	for (auto _ : state)
+	{
+		waves.Disturb(2 + std::rand() % (n - 4), 2 + std::rand() % (n - 4), 0.5f);
+		waves.Update(timeStep);
+	}
+
+	DoNotOptimize(waves.Heights()[n * n / 2]);
+	state.SetItemsProcessed(state.Iterations() * n * n);
+}
+BENCHMARK(BM_WavesUpdate)->Arg(128)->Arg(256)->Arg(512)->Arg(1024);
@@ -113,6 +113,8 @@ private:
 
 	std::unique_ptr<Waves> mWaves;
 
+	std::vector<Vertex> mWavesRowVertices;
+
 	PassConstants mMainPassCB;
 
 	UINT mPassCbvOffset = 0;
@@ -152,6 +154,7 @@ bool LandWavesApp::Initialize()
 	ThrowIfFailed(mCommandList->Reset(mDirectCmdListAlloc.Get(), nullptr));
 
 	mWaves = std::make_unique<Waves>(128, 128, 1.0f, 0.03f, 4.0f, 0.2f);
+	mWavesRowVertices.resize(mWaves->ColumnCount());
 
 	BuildRootSignature();
 	BuildShadersAndInputLayout();
@@ -426,17 +429,26 @@ void LandWavesApp::UpdateWaves(const GameTimer& gt)
 	// Update the wave simulation.
 	mWaves->Update(gt.DeltaTime());
 
-	// Update the wave vertex buffer with the new solution.
+	// Update the wave vertex buffer with the rows of the solution that changed
+	// since this frame resource's buffer was last written.
 	auto currWavesVB = mCurrFrameResource->WavesVB.get();
-	for (int i = 0; i < mWaves->VertexCount(); ++i)
+	const int n = mWaves->ColumnCount();
+	for (int i = 0; i < mWaves->RowCount(); ++i)
 	{
-		Vertex v;
+		if (!mWaves->IsRowDirty(i, mCurrFrameResource->WavesVersion))
+			continue;
+
+		for (int j = 0; j < n; ++j)
+		{
+			Vertex& v = mWavesRowVertices[j];
 
-		v.Pos = mWaves->Position(i);
-		v.Color = XMFLOAT4(DirectX::Colors::Blue);
+			v.Pos = mWaves->Position(i * n + j);
+			v.Color = XMFLOAT4(DirectX::Colors::Blue);
+		}
 
-		currWavesVB->CopyData(i, v);
+		currWavesVB->CopyRange(i * n, mWavesRowVertices.data(), n);
 	}
+	mCurrFrameResource->WavesVersion = mWaves->Version();
 
 	// Set the dynamic VB of the wave renderitem to the current frame VB.
 	mWavesRitem->Geo->VertexBufferGPU = currWavesVB->Resource();
@@ -2,6 +2,8 @@
 #include "MathHelper.h"
 #include "UploadBuffer.h"
 #include "GeometryGenerator.h"
+#include "MeshFile.h"
+#include "MeshOptimizer.h"
 
 #include "FrameResource.h"
 #include "Waves.h"
@@ -889,43 +891,27 @@ void StencilApp::BuildRoomGeometry()
 
 void StencilApp::BuildSkullGeometry()
 {
-	std::ifstream fin("../Models/skull.txt");
-
-	if (!fin)
+	std::vector<MeshFileVertex> meshVertices;
+	std::vector<std::uint32_t> meshIndices;
+	if (!LoadTextMeshParallel("../Models/skull.txt", meshVertices, meshIndices))
 	{
 		MessageBox(0, L"../Models/skull.txt not found.", 0, 0);
 		return;
 	}
 
-	UINT vcount = 0;
-	UINT tcount = 0;
-	std::string ignore;
-
-	fin >> ignore >> vcount;
-	fin >> ignore >> tcount;
-	fin >> ignore >> ignore >> ignore >> ignore;
+	OptimizeMesh(meshVertices, meshIndices);
 
-	std::vector<Vertex> vertices(vcount);
-	for (UINT i = 0; i < vcount; ++i)
+	std::vector<Vertex> vertices(meshVertices.size());
+	for (size_t i = 0; i < meshVertices.size(); ++i)
 	{
-		fin >> vertices[i].Pos.x >> vertices[i].Pos.y >> vertices[i].Pos.z;
-		fin >> vertices[i].Normal.x >> vertices[i].Normal.y >> vertices[i].Normal.z;
+		vertices[i].Pos = meshVertices[i].Pos;
+		vertices[i].Normal = meshVertices[i].Normal;
 
 		// Model does not have texture coordinates, so just zero them out.
 		vertices[i].TexC = { 0.0f, 0.0f };
 	}
 
-	fin >> ignore;
-	fin >> ignore;
-	fin >> ignore;
-
-	std::vector<std::int32_t> indices(3 * tcount);
-	for (UINT i = 0; i < tcount; ++i)
-	{
-		fin >> indices[i * 3 + 0] >> indices[i * 3 + 1] >> indices[i * 3 + 2];
-	}
-
-	fin.close();
+	std::vector<std::int32_t> indices(meshIndices.begin(), meshIndices.end());
 
 	// Pack the indices of all the meshes into one index buffer.
 
@@ -4,7 +4,12 @@
 #include "MathHelper.h"
 #include "UploadBuffer.h"
 #include "FrameResource.h"
+#include "DynamicAabbTree.h"
+#include "FrustumCulling.h"
 #include "GeometryGenerator.h"
+#include "MeshFile.h"
+#include "MeshOptimizer.h"
+#include "OcclusionCulling.h"
 
 #include <DirectXCollision.h>
 
@@ -17,6 +22,13 @@ using namespace DirectX::PackedVector;
 
 const int gNumFrameResources = 3;
 
+// The nearest visible instances drawn into the occlusion buffer each frame.
+const int gNumOccluders = 32;
+
+// Consecutive instances per leaf of a render item's InstanceGroupTree.  The grid is laid
+// out row by row, so a group is a compact slab of neighbouring instances.
+const UINT gInstanceGroupSize = 64;
+
 
 struct RenderItem
 {
@@ -38,6 +50,20 @@ struct RenderItem
 	BoundingBox Bounds;
 	std::vector<InstanceData> Instances;
 
+	// World-space bounds of Instances, in the same order.
+	CullingBounds InstanceBounds;
+
+	// One proxy per gInstanceGroupSize consecutive instances, holding the union of their
+	// bounds, with the group index as its user data.  An instance whose World changes
+	// is updated with InstanceBounds.Set(i, ...) and its group with MoveProxy.
+	DynamicAabbTree InstanceGroupTree;
+	std::vector<int> InstanceGroupProxies;
+
+	// A box inside the mesh, drawn into the occlusion buffer for the instances nearest
+	// the camera.
+	BoundingBox OccluderBounds;
+	bool HasOccluder = false;
+
 	UINT IndexCount = 0;
 	UINT InstanceCount = 0;
 	UINT StartIndexLocation = 0;
@@ -67,6 +93,7 @@ private:
 	void OnKeyboardInput(const GameTimer& gt);
 	void AnimateMaterials(const GameTimer& gt);
 	void UpdateInstanceData(const GameTimer& gt);
+	UINT CullOccludedInstances(RenderItem* ri, FXMMATRIX viewProj);
 	void UpdateMaterialBuffer(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
 
@@ -110,7 +137,23 @@ private:
 
 	bool mFrustumCullingEnabled = true;
 
-	BoundingFrustum mCamFrustum;
+	// The runs of instances whose groups the last tree query kept, and the instances
+	// in them that passed the frustum test, for the occlusion pass.
+	std::vector<CullingRange> mVisibleRanges;
+	CullingScratch mCullingScratch;
+	std::vector<UINT> mVisibleInstances;
+
+	bool mOcclusionCullingEnabled = true;
+	OcclusionBuffer mOcclusionBuffer;
+	std::vector<std::pair<float, UINT>> mOccluderCandidates;
+	std::vector<BYTE> mInstanceUnoccluded;
+
+	// 'O' writes the occlusion buffer to OcclusionBuffer.pgm once per press.
+	bool mSaveOcclusionBuffer = false;
+	bool mSaveKeyDown = false;
+
+	BoundingBox mSkullOccluderBounds;
+	bool mSkullHasOccluder = false;
 
 	PassConstants mMainPassCB;
 
@@ -191,7 +234,7 @@ void InstanceCullApp::OnResize()
 
 	mCamera.SetLens(0.25f * MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
 
-	BoundingFrustum::CreateFromMatrix(mCamFrustum, mCamera.GetProj());
+	mOcclusionBuffer.Resize(256, std::max<UINT>(1, (UINT)(256 / AspectRatio())));
 }
 
 void InstanceCullApp::Update(const GameTimer& gt)
@@ -327,6 +370,12 @@ void InstanceCullApp::OnKeyboardInput(const GameTimer& gt)
 		mFrustumCullingEnabled = true;
 	}
 
+	mOcclusionCullingEnabled = !(GetAsyncKeyState('2') & 0x8000);
+
+	bool saveKeyDown = (GetAsyncKeyState('O') & 0x8000) != 0;
+	mSaveOcclusionBuffer = saveKeyDown && !mSaveKeyDown;
+	mSaveKeyDown = saveKeyDown;
+
 	mCamera.UpdateViewMatrix();
 }
 
@@ -336,40 +385,70 @@ void InstanceCullApp::AnimateMaterials(const GameTimer& gt)
 
 void InstanceCullApp::UpdateInstanceData(const GameTimer& gt)
 {
-	XMMATRIX view = mCamera.GetView();
-	XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(view), view);
+	// Test the world-space instance bounds against the world-space frustum, so no
+	// instance matrix needs inverting.
+	XMMATRIX viewProj = XMMatrixMultiply(mCamera.GetView(), mCamera.GetProj());
+
+	FrustumPlanes camFrustum;
+	ExtractFrustumPlanes(camFrustum, viewProj);
 
 	auto currInstanceBuffer = mCurrFrameResource->InstanceBuffer.get();
 	for (auto& e : mAllRitems)
 	{
-		int visibleInstanceCount = 0;
 		const auto& instanceData = e->Instances;
 
-		for (UINT i = 0; i < (UINT)instanceData.size(); ++i)
+		// Write the instance data to structured buffer for the visible objects.  The
+		// workers fill disjoint runs of slots, straight into the mapped buffer.
+		auto writeInstance = [&](UINT i, UINT slot)
 		{
-			XMMATRIX world = XMLoadFloat4x4(&instanceData[i].World);
-			XMMATRIX texTransform = XMLoadFloat4x4(&instanceData[i].TexTransform);
-			XMMATRIX invWorld = XMMatrixInverse(&XMMatrixDeterminant(world), world);
-
-			// View space to the object's local space.
-			XMMATRIX viewToLocal = XMMatrixMultiply(invView, invWorld);
-
-			// Transform the camera frustum from view space to the object's local space.
-			BoundingFrustum localSpaceFrustum;
-			mCamFrustum.Transform(localSpaceFrustum, viewToLocal);
-
-			if ((localSpaceFrustum.Contains(e->Bounds) != DirectX::DISJOINT)
-				|| (mFrustumCullingEnabled == false))
+			InstanceData* data = currInstanceBuffer->MappedElement(slot);
+			XMStoreFloat4x4(&data->World, XMMatrixTranspose(XMLoadFloat4x4(&instanceData[i].World)));
+			XMStoreFloat4x4(&data->TexTransform, XMMatrixTranspose(XMLoadFloat4x4(&instanceData[i].TexTransform)));
+			data->MaterialIndex = instanceData[i].MaterialIndex;
+		};
+
+		UINT visibleInstanceCount = (UINT)instanceData.size();
+		UINT occludedInstanceCount = 0;
+		if (mFrustumCullingEnabled)
+		{
+			// The tree drops whole off-screen groups of the grid, so only the boxes of
+			// the groups near the frustum are tested, in parallel.
+			const UINT instanceCount = (UINT)instanceData.size();
+			mVisibleRanges.clear();
+			e->InstanceGroupTree.QueryFrustum(camFrustum, [&](UINT group)
+				{
+					const UINT first = group * gInstanceGroupSize;
+					mVisibleRanges.push_back({ first, std::min<UINT>(first + gInstanceGroupSize, instanceCount) });
+				});
+
+			if (mOcclusionCullingEnabled && e->HasOccluder)
 			{
-				InstanceData data;
-				XMStoreFloat4x4(&data.World, XMMatrixTranspose(world));
-				XMStoreFloat4x4(&data.TexTransform, XMMatrixTranspose(texTransform));
-				data.MaterialIndex = instanceData[i].MaterialIndex;
-
-				// Write the instance data to structured buffer for the visible objects.
-				currInstanceBuffer->CopyData(visibleInstanceCount++, data);
+				mVisibleInstances.resize(instanceCount);
+				mVisibleInstances.resize(ParallelCullRanges(camFrustum, e->InstanceBounds, mVisibleRanges, mCullingScratch,
+					[&](UINT i, UINT slot) { mVisibleInstances[slot] = i; }));
+
+				occludedInstanceCount = CullOccludedInstances(e.get(), viewProj);
+
+				visibleInstanceCount = (UINT)mVisibleInstances.size();
+				ParallelFor(0, (int)visibleInstanceCount, CullingChunkSize, [&](int first, int last)
+					{
+						for (int slot = first; slot < last; ++slot)
+							writeInstance(mVisibleInstances[slot], slot);
+					});
+			}
+			else
+			{
+				visibleInstanceCount = ParallelCullRanges(camFrustum, e->InstanceBounds, mVisibleRanges, mCullingScratch, writeInstance);
 			}
 		}
+		else
+		{
+			ParallelFor(0, (int)instanceData.size(), CullingChunkSize, [&](int first, int last)
+				{
+					for (int i = first; i < last; ++i)
+						writeInstance(i, i);
+				});
+		}
 
 		e->InstanceCount = visibleInstanceCount;
 
@@ -377,11 +456,61 @@ void InstanceCullApp::UpdateInstanceData(const GameTimer& gt)
 		outs.precision(6);
 		outs << L"Instancing and Culling Demo" <<
 			L"    " << e->InstanceCount <<
-			L" objects visible out of " << e->Instances.size();
+			L" objects visible out of " << e->Instances.size() <<
+			L"    " << occludedInstanceCount << L" occluded";
 		mMainWndCaption = outs.str();
 	}
 }
 
+UINT InstanceCullApp::CullOccludedInstances(RenderItem* ri, FXMMATRIX viewProj)
+{
+	const auto& instanceData = ri->Instances;
+
+	// Draw the occluder boxes of the visible instances nearest the camera.
+	XMVECTOR eyePos = mCamera.GetPosition();
+	mOccluderCandidates.clear();
+	for (UINT i : mVisibleInstances)
+	{
+		XMVECTOR center = XMVector3Transform(XMLoadFloat3(&ri->Bounds.Center), XMLoadFloat4x4(&instanceData[i].World));
+		mOccluderCandidates.emplace_back(XMVectorGetX(XMVector3LengthSq(center - eyePos)), i);
+	}
+
+	const std::size_t occluderCount = std::min<std::size_t>(mOccluderCandidates.size(), gNumOccluders);
+	std::partial_sort(mOccluderCandidates.begin(), mOccluderCandidates.begin() + occluderCount, mOccluderCandidates.end());
+
+	mOcclusionBuffer.Clear(viewProj);
+	for (std::size_t k = 0; k < occluderCount; ++k)
+	{
+		UINT i = mOccluderCandidates[k].second;
+		mOcclusionBuffer.RenderOccluderBox(ri->OccluderBounds, XMLoadFloat4x4(&instanceData[i].World));
+	}
+	mOcclusionBuffer.FinishOccluders();
+
+	if (mSaveOcclusionBuffer)
+		mOcclusionBuffer.SaveDepthImage("OcclusionBuffer.pgm");
+
+	// Test every visible instance's bounds, then keep the ones that passed in order.
+	const UINT visibleCount = (UINT)mVisibleInstances.size();
+	mInstanceUnoccluded.resize(visibleCount);
+	ParallelFor(0, (int)visibleCount, CullingChunkSize, [&](int first, int last)
+		{
+			for (int k = first; k < last; ++k)
+			{
+				mInstanceUnoccluded[k] = mOcclusionBuffer.IsVisible(ri->InstanceBounds.Get(mVisibleInstances[k]));
+			}
+		});
+
+	UINT unoccludedCount = 0;
+	for (UINT k = 0; k < visibleCount; ++k)
+	{
+		if (mInstanceUnoccluded[k])
+			mVisibleInstances[unoccludedCount++] = mVisibleInstances[k];
+	}
+	mVisibleInstances.resize(unoccludedCount);
+
+	return visibleCount - unoccludedCount;
+}
+
 void InstanceCullApp::UpdateMaterialBuffer(const GameTimer& gt)
 {
 	auto currMaterialBuffer = mCurrFrameResource->MaterialBuffer.get();
@@ -641,33 +770,24 @@ void InstanceCullApp::BuildShadersAndInputLayout()
 
 void InstanceCullApp::BuildSkullGeometry()
 {
-	std::ifstream fin("../Models/skull.txt");
-
-	if (!fin)
+	std::vector<MeshFileVertex> meshVertices;
+	std::vector<std::uint32_t> meshIndices;
+	if (!LoadTextMeshParallel("../Models/skull.txt", meshVertices, meshIndices))
 	{
 		MessageBox(0, L"../Models/skull.txt not found.", 0, 0);
 		return;
 	}
 
-	UINT vcount = 0;
-	UINT tcount = 0;
-	std::string ignore;
-
-	fin >> ignore >> vcount;
-	fin >> ignore >> tcount;
-	fin >> ignore >> ignore >> ignore >> ignore;
+	OptimizeMesh(meshVertices, meshIndices);
 
-	XMFLOAT3 vMinf3(+MathHelper::Infinity, +MathHelper::Infinity, +MathHelper::Infinity);
-	XMFLOAT3 vMaxf3(-MathHelper::Infinity, -MathHelper::Infinity, -MathHelper::Infinity);
+	mSkullHasOccluder = ComputeInteriorBox(&meshVertices[0].Pos, sizeof(MeshFileVertex), meshVertices.size(),
+		meshIndices.data(), meshIndices.size(), mSkullOccluderBounds);
 
-	XMVECTOR vMin = XMLoadFloat3(&vMinf3);
-	XMVECTOR vMax = XMLoadFloat3(&vMaxf3);
-
-	std::vector<Vertex> vertices(vcount);
-	for (UINT i = 0; i < vcount; ++i)
+	std::vector<Vertex> vertices(meshVertices.size());
+	for (size_t i = 0; i < meshVertices.size(); ++i)
 	{
-		fin >> vertices[i].Pos.x >> vertices[i].Pos.y >> vertices[i].Pos.z;
-		fin >> vertices[i].Normal.x >> vertices[i].Normal.y >> vertices[i].Normal.z;
+		vertices[i].Pos = meshVertices[i].Pos;
+		vertices[i].Normal = meshVertices[i].Normal;
 
 		XMVECTOR P = XMLoadFloat3(&vertices[i].Pos);
 
@@ -689,25 +809,11 @@ void InstanceCullApp::BuildSkullGeometry()
 		float v = phi / XM_PI;
 
 		vertices[i].TexC = { u, v };
-
-		vMin = XMVectorMin(vMin, P);
-		vMax = XMVectorMax(vMax, P);
 	}
 
-	BoundingBox bounds;
-	XMStoreFloat3(&bounds.Center, 0.5f * (vMin + vMax));
-	XMStoreFloat3(&bounds.Extents, 0.5f * (vMax - vMin));
+	BoundingBox bounds = ComputeMeshBounds(meshVertices.data(), meshVertices.size());
 
-	fin >> ignore;
-	fin >> ignore;
-	fin >> ignore;
-
-	std::vector<std::int32_t> indices(3 * tcount);
-	for (UINT i = 0; i < tcount; ++i)
-	{
-		fin >> indices[i * 3 + 0] >> indices[i * 3 + 1] >> indices[i * 3 + 2];
-	}
-	fin.close();
+	std::vector<std::int32_t> indices(meshIndices.begin(), meshIndices.end());
 
 	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
 	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::int32_t);
@@ -866,6 +972,8 @@ void InstanceCullApp::BuildRenderItems()
 	skullRitem->StartIndexLocation = skullRitem->Geo->DrawArgs["skull"].StartIndexLocation;
 	skullRitem->BaseVertexLocation = skullRitem->Geo->DrawArgs["skull"].BaseVertexLocation;
 	skullRitem->Bounds = skullRitem->Geo->DrawArgs["skull"].Bounds;
+	skullRitem->OccluderBounds = mSkullOccluderBounds;
+	skullRitem->HasOccluder = mSkullHasOccluder;
 
 	// Generate instance data.
 	const int n = 11;
@@ -902,6 +1010,24 @@ void InstanceCullApp::BuildRenderItems()
 		}
 	}
 
+	skullRitem->InstanceBounds.Reserve(mInstanceCount);
+	for (const InstanceData& instance : skullRitem->Instances)
+		skullRitem->InstanceBounds.Add(skullRitem->Bounds, XMLoadFloat4x4(&instance.World));
+
+	const UINT groupCount = (mInstanceCount + gInstanceGroupSize - 1) / gInstanceGroupSize;
+	skullRitem->InstanceGroupProxies.resize(groupCount);
+	for (UINT group = 0; group < groupCount; ++group)
+	{
+		const UINT first = group * gInstanceGroupSize;
+		const UINT last = std::min<UINT>(first + gInstanceGroupSize, mInstanceCount);
+
+		BoundingBox groupBounds = skullRitem->InstanceBounds.Get(first);
+		for (UINT i = first + 1; i < last; ++i)
+			BoundingBox::CreateMerged(groupBounds, groupBounds, skullRitem->InstanceBounds.Get(i));
+
+		skullRitem->InstanceGroupProxies[group] = skullRitem->InstanceGroupTree.CreateProxy(groupBounds, group);
+	}
+
 	mAllRitems.emplace_back(std::move(skullRitem));
 
 	for (auto& e : mAllRitems)
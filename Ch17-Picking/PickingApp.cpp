@@ -5,6 +5,9 @@
 #include "UploadBuffer.h"
 #include "FrameResource.h"
 #include "GeometryGenerator.h"
+#include "MeshFile.h"
+#include "MeshOptimizer.h"
+#include "TriangleBvh.h"
 
 #include <DirectXCollision.h>
 
@@ -40,6 +43,9 @@ struct RenderItem
 	BoundingBox Bounds;
 	std::vector<InstanceData> Instances;
 
+	// The mesh's triangles for picking, in object space; nullptr if it cannot be picked.
+	const TriangleBvh* Bvh = nullptr;
+
 	UINT IndexCount = 0;
 	UINT StartIndexLocation = 0;
 	int BaseVertexLocation = 0;
@@ -104,6 +110,7 @@ private:
 	ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap = nullptr;
 
 	std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> mGeometries;
+	std::unordered_map<std::string, std::unique_ptr<TriangleBvh>> mTriangleBvhs;
 	std::unordered_map<std::string, std::unique_ptr<Material>> mMaterials;
 	std::unordered_map<std::string, std::unique_ptr<Texture>> mTextures;
 
@@ -517,33 +524,27 @@ void PickingApp::BuildShadersAndInputLayout()
 
 void PickingApp::BuildCarGeometry()
 {
-	std::ifstream fin("../Models/car.txt");
-
-	if (!fin)
+	std::vector<MeshFileVertex> meshVertices;
+	std::vector<std::uint32_t> meshIndices;
+	if (!LoadTextMeshParallel("../Models/car.txt", meshVertices, meshIndices))
 	{
 		MessageBox(0, L"../Models/car.txt not found.", 0, 0);
 		return;
 	}
 
-	UINT vcount = 0;
-	UINT tcount = 0;
-	std::string ignore;
-
-	fin >> ignore >> vcount;
-	fin >> ignore >> tcount;
-	fin >> ignore >> ignore >> ignore >> ignore;
+	OptimizeMesh(meshVertices, meshIndices);
 
-	XMFLOAT3 vMinf3(+MathHelper::Infinity, +MathHelper::Infinity, +MathHelper::Infinity);
-	XMFLOAT3 vMaxf3(-MathHelper::Infinity, -MathHelper::Infinity, -MathHelper::Infinity);
+	// Built after optimizing, so the triangle numbers it returns match the index buffer.
+	auto bvh = std::make_unique<TriangleBvh>();
+	bvh->Build(&meshVertices[0].Pos, sizeof(MeshFileVertex), meshVertices.size(),
+		meshIndices.data(), meshIndices.size());
+	mTriangleBvhs["car"] = std::move(bvh);
 
-	XMVECTOR vMin = XMLoadFloat3(&vMinf3);
-	XMVECTOR vMax = XMLoadFloat3(&vMaxf3);
-
-	std::vector<Vertex> vertices(vcount);
-	for (UINT i = 0; i < vcount; ++i)
+	std::vector<Vertex> vertices(meshVertices.size());
+	for (size_t i = 0; i < meshVertices.size(); ++i)
 	{
-		fin >> vertices[i].Pos.x >> vertices[i].Pos.y >> vertices[i].Pos.z;
-		fin >> vertices[i].Normal.x >> vertices[i].Normal.y >> vertices[i].Normal.z;
+		vertices[i].Pos = meshVertices[i].Pos;
+		vertices[i].Normal = meshVertices[i].Normal;
 
 		XMVECTOR P = XMLoadFloat3(&vertices[i].Pos);
 
@@ -565,25 +566,11 @@ void PickingApp::BuildCarGeometry()
 		float v = phi / XM_PI;
 
 		vertices[i].TexC = { u, v };
-
-		vMin = XMVectorMin(vMin, P);
-		vMax = XMVectorMax(vMax, P);
 	}
 
-	BoundingBox bounds;
-	XMStoreFloat3(&bounds.Center, 0.5f * (vMin + vMax));
-	XMStoreFloat3(&bounds.Extents, 0.5f * (vMax - vMin));
+	BoundingBox bounds = ComputeMeshBounds(meshVertices.data(), meshVertices.size());
 
-	fin >> ignore;
-	fin >> ignore;
-	fin >> ignore;
-
-	std::vector<std::int32_t> indices(3 * tcount);
-	for (UINT i = 0; i < tcount; ++i)
-	{
-		fin >> indices[i * 3 + 0] >> indices[i * 3 + 1] >> indices[i * 3 + 2];
-	}
-	fin.close();
+	std::vector<std::int32_t> indices(meshIndices.begin(), meshIndices.end());
 
 	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
 	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::int32_t);
@@ -715,6 +702,7 @@ void PickingApp::BuildRenderItems()
 	carRitem->IndexCount = carRitem->Geo->DrawArgs["car"].IndexCount;
 	carRitem->StartIndexLocation = carRitem->Geo->DrawArgs["car"].StartIndexLocation;
 	carRitem->BaseVertexLocation = carRitem->Geo->DrawArgs["car"].BaseVertexLocation;
+	carRitem->Bvh = mTriangleBvhs["car"].get();
 	mRitemLayer[(int)RenderLayer::Opaque].emplace_back(carRitem.get());
 
 	auto pickedRitem = std::make_unique<RenderItem>();
@@ -840,8 +828,6 @@ void PickingApp::Pick(int sx, int sy)
 
 	for (auto ri : mRitemLayer[(int)RenderLayer::Opaque])
 	{
-		auto geo = ri->Geo;
-
 		if (ri->Visible == false)
 		{
 			continue;
@@ -857,43 +843,20 @@ void PickingApp::Pick(int sx, int sy)
 
 		rayDir = XMVector3Normalize(rayDir);
 
+		// The BVH's root box is the mesh's bounds, so a ray that misses them costs one
+		// box test, and one that hits only reaches the triangles near it.
 		float tmin = 0.0f;
-		if (ri->Bounds.Intersects(rayOrigin, rayDir, tmin))
+		UINT pickedTriangle = 0;
+		if (ri->Bvh != nullptr && ri->Bvh->Intersects(rayOrigin, rayDir, tmin, pickedTriangle))
 		{
-			auto vertices = (Vertex*)geo->VertexBufferCPU->GetBufferPointer();
-			auto indices = (std::uint32_t*)geo->IndexBufferCPU->GetBufferPointer();
-			UINT triCount = ri->IndexCount / 3;
-
-			tmin = MathHelper::Infinity;
-			for (UINT i = 0; i < triCount; ++i)
-			{
-				UINT i0 = indices[i * 3 + 0];
-				UINT i1 = indices[i * 3 + 1];
-				UINT i2 = indices[i * 3 + 2];
-
-				XMVECTOR v0 = XMLoadFloat3(&vertices[i0].Pos);
-				XMVECTOR v1 = XMLoadFloat3(&vertices[i1].Pos);
-				XMVECTOR v2 = XMLoadFloat3(&vertices[i2].Pos);
-
-				float t = 0.0f;
-				if (TriangleTests::Intersects(rayOrigin, rayDir, v0, v1, v2, t))
-				{
-					if (t < tmin)
-					{
-						tmin = t;
-						UINT pickedTriangle = i;
-
-						mPickedRitem->Visible = true;
-						mPickedRitem->IndexCount = 3;
-						mPickedRitem->BaseVertexLocation = 0;
-
-						mPickedRitem->World = ri->World;
-						mPickedRitem->NumFramesDirty = gNumFrameResources;
-
-						mPickedRitem->StartIndexLocation = 3 * pickedTriangle;
-					}
-				}
-			}
+			mPickedRitem->Visible = true;
+			mPickedRitem->IndexCount = 3;
+			mPickedRitem->BaseVertexLocation = 0;
+
+			mPickedRitem->World = ri->World;
+			mPickedRitem->NumFramesDirty = gNumFrameResources;
+
+			mPickedRitem->StartIndexLocation = 3 * pickedTriangle;
 		}
 	}
 }
@@ -5,6 +5,8 @@
 #include "UploadBuffer.h"
 #include "FrameResource.h"
 #include "GeometryGenerator.h"
+#include "MeshFile.h"
+#include "MeshOptimizer.h"
 
 #include "CubeRenderTarget.h"
 
@@ -716,57 +718,28 @@ void CubeMapApp::BuildShadersAndInputLayout()
 
 void CubeMapApp::BuildSkullGeometry()
 {
-	std::ifstream fin("../Models/skull.txt");
-
-	if (!fin)
+	std::vector<MeshFileVertex> meshVertices;
+	std::vector<std::uint32_t> meshIndices;
+	if (!LoadTextMeshParallel("../Models/skull.txt", meshVertices, meshIndices))
 	{
 		MessageBox(0, L"../Models/skull.txt not found.", 0, 0);
 		return;
 	}
 
-	UINT vcount = 0;
-	UINT tcount = 0;
-	std::string ignore;
-
-	fin >> ignore >> vcount;
-	fin >> ignore >> tcount;
-	fin >> ignore >> ignore >> ignore >> ignore;
-
-	XMFLOAT3 vMinf3(+MathHelper::Infinity, +MathHelper::Infinity, +MathHelper::Infinity);
-	XMFLOAT3 vMaxf3(-MathHelper::Infinity, -MathHelper::Infinity, -MathHelper::Infinity);
+	OptimizeMesh(meshVertices, meshIndices);
 
-	XMVECTOR vMin = XMLoadFloat3(&vMinf3);
-	XMVECTOR vMax = XMLoadFloat3(&vMaxf3);
-
-	std::vector<Vertex> vertices(vcount);
-	for (UINT i = 0; i < vcount; ++i)
+	std::vector<Vertex> vertices(meshVertices.size());
+	for (size_t i = 0; i < meshVertices.size(); ++i)
 	{
-		fin >> vertices[i].Pos.x >> vertices[i].Pos.y >> vertices[i].Pos.z;
-		fin >> vertices[i].Normal.x >> vertices[i].Normal.y >> vertices[i].Normal.z;
+		vertices[i].Pos = meshVertices[i].Pos;
+		vertices[i].Normal = meshVertices[i].Normal;
 
 		vertices[i].TexC = { 0.0f, 0.0f };
-
-		XMVECTOR P = XMLoadFloat3(&vertices[i].Pos);
-
-		vMin = XMVectorMin(vMin, P);
-		vMax = XMVectorMax(vMax, P);
 	}
 
-	BoundingBox bounds;
-	XMStoreFloat3(&bounds.Center, 0.5f * (vMin + vMax));
-	XMStoreFloat3(&bounds.Extents, 0.5f * (vMax - vMin));
-
-	fin >> ignore;
-	fin >> ignore;
-	fin >> ignore;
-
-	std::vector<std::int32_t> indices(3 * tcount);
-	for (UINT i = 0; i < tcount; ++i)
-	{
-		fin >> indices[i * 3 + 0] >> indices[i * 3 + 1] >> indices[i * 3 + 2];
-	}
+	BoundingBox bounds = ComputeMeshBounds(meshVertices.data(), meshVertices.size());
 
-	fin.close();
+	std::vector<std::int32_t> indices(meshIndices.begin(), meshIndices.end());
 
 	// Pack the indices of all the meshes into one index buffer.
 	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
@@ -5,6 +5,9 @@
 #include "UploadBuffer.h"
 #include "FrameResource.h"
 #include "GeometryGenerator.h"
+#include "MeshFile.h"
+#include "MeshOptimizer.h"
+#include "DerivedDataCache.h"
 
 #include "Advanced/SSAO.h"
 #include "Advanced/ShadowMap.h"
@@ -88,6 +91,8 @@ private:
 	void BuildShadersAndInputLayout();
 	void BuildShapeGeometry();
 	void BuildSkullGeometry();
+	void DeriveShapeGeometry(DerivedMesh& mesh);
+	bool DeriveSkullGeometry(const std::string& filename, DerivedMesh& mesh);
 	void BuildPSOs();
 	void BuildFrameResources();
 	void BuildMaterials();
@@ -122,6 +127,10 @@ private:
 	std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;
 
 	std::vector<std::unique_ptr<RenderItem>> mAllRitems;
+
+	// Finished vertex/index blobs from earlier runs, keyed by what they were built from.
+	DerivedDataCache mDerivedDataCache{ "../DerivedDataCache" };
+
 	// Render items divided by PSO.
 	std::vector<RenderItem*> mRitemLayer[(int)RenderLayer::Count];
 
@@ -941,14 +950,49 @@ void SsaoApp::BuildShadersAndInputLayout()
 	};
 }
 
+// Everything shapeGeo is derived from; hashed into its cache key, so a change here
+// (or to the Vertex layout) rebuilds the shapes instead of reusing a stale entry.
+struct ShapeParams
+{
+	float BoxWidth = 1.0f, BoxHeight = 1.0f, BoxDepth = 1.0f;
+	UINT BoxSubdivisions = 3;
+	float GridWidth = 20.0f, GridDepth = 30.0f;
+	UINT GridM = 60, GridN = 40;
+	float SphereRadius = 0.5f;
+	UINT SphereSlices = 20, SphereStacks = 20;
+	float CylinderBottomRadius = 0.5f, CylinderTopRadius = 0.3f, CylinderHeight = 3.0f;
+	UINT CylinderSlices = 20, CylinderStacks = 20;
+	float QuadX = 0.0f, QuadY = 0.0f, QuadW = 1.0f, QuadH = 1.0f, QuadDepth = 0.0f;
+	UINT VertexSize = sizeof(Vertex);
+};
+
 void SsaoApp::BuildShapeGeometry()
 {
+	DerivedDataKey key("SsaoApp shapeGeo", 1);
+	key.AddValue(ShapeParams());
+
+	DerivedMesh mesh;
+	if (!mDerivedDataCache.LoadMesh(key, mesh))
+	{
+		DeriveShapeGeometry(mesh);
+		mDerivedDataCache.StoreMesh(key, mesh);
+	}
+
+	mGeometries["shapeGeo"] = d3dUtil::CreateMeshGeometry(md3dDevice.Get(),
+		mCommandList.Get(), "shapeGeo", mesh);
+}
+
+void SsaoApp::DeriveShapeGeometry(DerivedMesh& mesh)
+{
+	const ShapeParams params;
+
 	GeometryGenerator geoGen;
-	GeometryGenerator::MeshData box = geoGen.CreateBox(1.0f, 1.0f, 1.0f, 3);
-	GeometryGenerator::MeshData grid = geoGen.CreateGrid(20.0f, 30.0f, 60, 40);
-	GeometryGenerator::MeshData sphere = geoGen.CreateSphere(0.5f, 20, 20);
-	GeometryGenerator::MeshData cylinder = geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20);
-	GeometryGenerator::MeshData quad = geoGen.CreateQuad(0.0f, 0.0f, 1.0f, 1.0f, 0.0f);
+	GeometryGenerator::MeshData box = geoGen.CreateBox(params.BoxWidth, params.BoxHeight, params.BoxDepth, params.BoxSubdivisions);
+	GeometryGenerator::MeshData grid = geoGen.CreateGrid(params.GridWidth, params.GridDepth, params.GridM, params.GridN);
+	GeometryGenerator::MeshData sphere = geoGen.CreateSphere(params.SphereRadius, params.SphereSlices, params.SphereStacks);
+	GeometryGenerator::MeshData cylinder = geoGen.CreateCylinder(params.CylinderBottomRadius, params.CylinderTopRadius,
+		params.CylinderHeight, params.CylinderSlices, params.CylinderStacks);
+	GeometryGenerator::MeshData quad = geoGen.CreateQuad(params.QuadX, params.QuadY, params.QuadW, params.QuadH, params.QuadDepth);
 
 	UINT boxVertexOffset = 0;
 	UINT gridVertexOffset = (UINT)box.Vertices.size();
@@ -963,27 +1007,27 @@ void SsaoApp::BuildShapeGeometry()
 	UINT cylinderIndexOffset = sphereIndexOffset + (UINT)sphere.Indices32.size();
 	UINT quadIndexOffset = cylinderIndexOffset + (UINT)cylinder.Indices32.size();
 
-	SubmeshGeometry boxSubmesh;
+	DerivedSubmesh boxSubmesh;
 	boxSubmesh.IndexCount = (UINT)box.Indices32.size();
 	boxSubmesh.StartIndexLocation = boxIndexOffset;
 	boxSubmesh.BaseVertexLocation = boxVertexOffset;
 
-	SubmeshGeometry gridSubmesh;
+	DerivedSubmesh gridSubmesh;
 	gridSubmesh.IndexCount = (UINT)grid.Indices32.size();
 	gridSubmesh.StartIndexLocation = gridIndexOffset;
 	gridSubmesh.BaseVertexLocation = gridVertexOffset;
 
-	SubmeshGeometry sphereSubmesh;
+	DerivedSubmesh sphereSubmesh;
 	sphereSubmesh.IndexCount = (UINT)sphere.Indices32.size();
 	sphereSubmesh.StartIndexLocation = sphereIndexOffset;
 	sphereSubmesh.BaseVertexLocation = sphereVertexOffset;
 
-	SubmeshGeometry cylinderSubmesh;
+	DerivedSubmesh cylinderSubmesh;
 	cylinderSubmesh.IndexCount = (UINT)cylinder.Indices32.size();
 	cylinderSubmesh.StartIndexLocation = cylinderIndexOffset;
 	cylinderSubmesh.BaseVertexLocation = cylinderVertexOffset;
 
-	SubmeshGeometry quadSubmesh;
+	DerivedSubmesh quadSubmesh;
 	quadSubmesh.IndexCount = (UINT)quad.Indices32.size();
 	quadSubmesh.StartIndexLocation = quadIndexOffset;
 	quadSubmesh.BaseVertexLocation = quadVertexOffset;
@@ -1045,72 +1089,61 @@ void SsaoApp::BuildShapeGeometry()
 	indices.insert(indices.end(), std::begin(cylinder.GetIndices16()), std::end(cylinder.GetIndices16()));
 	indices.insert(indices.end(), std::begin(quad.GetIndices16()), std::end(quad.GetIndices16()));
 
-	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
-	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
-
-	auto geo = std::make_unique<MeshGeometry>();
-	geo->Name = "shapeGeo";
-
-	// ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-	// CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
-
-	// ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-	// CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+	mesh.SetVertices(vertices);
+	mesh.SetIndices(indices);
 
-	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
-
-	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
-
-	geo->VertexByteStride = sizeof(Vertex);
-	geo->VertexBufferByteSize = vbByteSize;
-	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
-	geo->IndexBufferByteSize = ibByteSize;
-
-	geo->DrawArgs["box"] = boxSubmesh;
-	geo->DrawArgs["grid"] = gridSubmesh;
-	geo->DrawArgs["sphere"] = sphereSubmesh;
-	geo->DrawArgs["cylinder"] = cylinderSubmesh;
-	geo->DrawArgs["quad"] = quadSubmesh;
-
-	mGeometries[geo->Name] = std::move(geo);
+	mesh.AddSubmesh("box", boxSubmesh);
+	mesh.AddSubmesh("grid", gridSubmesh);
+	mesh.AddSubmesh("sphere", sphereSubmesh);
+	mesh.AddSubmesh("cylinder", cylinderSubmesh);
+	mesh.AddSubmesh("quad", quadSubmesh);
 }
 
 void SsaoApp::BuildSkullGeometry()
 {
-	std::ifstream fin("../Models/skull.txt");
+	const std::string filename = "../Models/skull.txt";
 
-	if (!fin)
+	// Hashing the file is far cheaper than parsing it and deriving the tangents.
+	DerivedDataKey key("SsaoApp skullGeo", 3);
+	key.AddValue((UINT)sizeof(Vertex));
+	if (!key.AddFile(filename))
 	{
 		MessageBox(0, L"../Models/skull.txt not found.", 0, 0);
 		return;
 	}
 
-	UINT vcount = 0;
-	UINT tcount = 0;
-	std::string ignore;
+	DerivedMesh mesh;
+	if (!mDerivedDataCache.LoadMesh(key, mesh))
+	{
+		if (!DeriveSkullGeometry(filename, mesh))
+		{
+			MessageBox(0, L"../Models/skull.txt not found.", 0, 0);
+			return;
+		}
+		mDerivedDataCache.StoreMesh(key, mesh);
+	}
 
-	fin >> ignore >> vcount;
-	fin >> ignore >> tcount;
-	fin >> ignore >> ignore >> ignore >> ignore;
+	mGeometries["skullGeo"] = d3dUtil::CreateMeshGeometry(md3dDevice.Get(),
+		mCommandList.Get(), "skullGeo", mesh);
+}
 
-	XMFLOAT3 vMinf3(+MathHelper::Infinity, +MathHelper::Infinity, +MathHelper::Infinity);
-	XMFLOAT3 vMaxf3(-MathHelper::Infinity, -MathHelper::Infinity, -MathHelper::Infinity);
+bool SsaoApp::DeriveSkullGeometry(const std::string& filename, DerivedMesh& mesh)
+{
+	std::vector<MeshFileVertex> meshVertices;
+	std::vector<std::uint32_t> meshIndices;
+	if (!LoadTextMeshParallel(filename, meshVertices, meshIndices))
+		return false;
 
-	XMVECTOR vMin = XMLoadFloat3(&vMinf3);
-	XMVECTOR vMax = XMLoadFloat3(&vMaxf3);
+	OptimizeMesh(meshVertices, meshIndices);
 
-	std::vector<Vertex> vertices(vcount);
-	for (UINT i = 0; i < vcount; ++i)
+	std::vector<Vertex> vertices(meshVertices.size());
+	for (size_t i = 0; i < meshVertices.size(); ++i)
 	{
-		fin >> vertices[i].Pos.x >> vertices[i].Pos.y >> vertices[i].Pos.z;
-		fin >> vertices[i].Normal.x >> vertices[i].Normal.y >> vertices[i].Normal.z;
+		vertices[i].Pos = meshVertices[i].Pos;
+		vertices[i].Normal = meshVertices[i].Normal;
 
 		vertices[i].TexC = { 0.0f, 0.0f };
 
-		XMVECTOR P = XMLoadFloat3(&vertices[i].Pos);
-
 		XMVECTOR N = XMLoadFloat3(&vertices[i].Normal);
 
 		// Generate a tangent vector so normal mapping works.
@@ -1129,59 +1162,20 @@ void SsaoApp::BuildSkullGeometry()
 			XMVECTOR T = XMVector3Normalize(XMVector3Cross(N, up));
 			XMStoreFloat3(&vertices[i].TangentU, T);
 		}
-		vMin = XMVectorMin(vMin, P);
-		vMax = XMVectorMax(vMax, P);
 	}
 
-	BoundingBox bounds;
-	XMStoreFloat3(&bounds.Center, 0.5f * (vMin + vMax));
-	XMStoreFloat3(&bounds.Extents, 0.5f * (vMax - vMin));
-
-	fin >> ignore;
-	fin >> ignore;
-	fin >> ignore;
-
-	std::vector<std::int32_t> indices(3 * tcount);
-	for (UINT i = 0; i < tcount; ++i)
-	{
-		fin >> indices[i * 3 + 0] >> indices[i * 3 + 1] >> indices[i * 3 + 2];
-	}
+	BoundingBox bounds = ComputeMeshBounds(meshVertices.data(), meshVertices.size());
 
-	fin.close();
-
-	// Pack the indices of all the meshes into one index buffer.
-	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
-	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::int32_t);
-
-	auto geo = std::make_unique<MeshGeometry>();
-	geo->Name = "skullGeo";
-
-	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
-
-	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
-
-	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
-
-	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
-
-	geo->VertexByteStride = sizeof(Vertex);
-	geo->VertexBufferByteSize = vbByteSize;
-	geo->IndexFormat = DXGI_FORMAT_R32_UINT;
-	geo->IndexBufferByteSize = ibByteSize;
-
-	SubmeshGeometry submesh;
-	submesh.IndexCount = (UINT)indices.size();
+	DerivedSubmesh submesh;
+	submesh.IndexCount = (UINT)meshIndices.size();
 	submesh.StartIndexLocation = 0;
 	submesh.BaseVertexLocation = 0;
 	submesh.Bounds = bounds;
 
-	geo->DrawArgs["skull"] = submesh;
-
-	mGeometries[geo->Name] = std::move(geo);
+	mesh.SetVertices(vertices);
+	mesh.SetIndices(meshIndices);
+	mesh.AddSubmesh("skull", submesh);
+	return true;
 }
 
 void SsaoApp::BuildPSOs()
@@ -5,11 +5,16 @@
 #include "UploadBuffer.h"
 #include "FrameResource.h"
 #include "GeometryGenerator.h"
+#include "MeshFile.h"
+#include "MeshOptimizer.h"
+#include "AssetLoader.h"
 
 #include "Advanced/SSAO.h"
 #include "Advanced/LoadM3d.h"
 #include "Advanced/ShadowMap.h"
 #include "Advanced/AnimationHelper.h"
+#include "Advanced/AnimationCompression.h"
+#include "Advanced/AnimationStage.h"
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
@@ -21,24 +26,47 @@ using namespace DirectX::PackedVector;
 
 const int gNumFrameResources = 3;
 
+// Soldiers to animate.  The demo shows one; raise this to load the animation stage
+// with a crowd, laid out in rows of ten around the first soldier.
+const UINT gNumSkinnedInstances = 1;
+
+// Materials (and so submeshes) of the soldier the frame resources leave room for.
+// The model arrives after they are built; one with more is not shown.
+const UINT gMaxSkinnedMaterials = 8;
+
+// Slots of Common.hlsl's gTextureMaps, the start of the SRV heap.
+const UINT gNumTextureMapSrvs = 48;
+
 
 struct SkinnedModelInstance
 {
 	SkinnedData* SkinnedInfo = nullptr;
-	std::vector<DirectX::XMFLOAT4X4> FinalTransforms;
-	std::string ClipName;
+	const AnimationClip* Clip = nullptr;
+	float ClipEndTime = 0.0f;
 	float TimePos = 0.0f;
 
-	void UpdateSkinnedAnimation(float dt)
+	// Slot of this instance's palette in FrameResource::SkinnedCB.
+	UINT SkinnedCBIndex = 0;
+
+	// Per-bone keyframe search positions, carried from frame to frame.
+	std::vector<UINT> KeyframeCursors;
+
+	void SetClip(const std::string& clipName)
+	{
+		Clip = SkinnedInfo->FindClip(clipName);
+		ClipEndTime = Clip->GetClipEndTime();
+		TimePos = 0.0f;
+		KeyframeCursors.assign(SkinnedInfo->BoneCount(), 0);
+	}
+
+	void AdvanceTime(float dt)
 	{
 		TimePos += dt;
 
-		if (TimePos > SkinnedInfo->GetClipEndTime(ClipName))
+		if (TimePos > ClipEndTime)
 		{
 			TimePos = 0.0f;
 		}
-
-		SkinnedInfo->GetFinalTransforms(ClipName, TimePos, FinalTransforms);
 	}
 };
 
@@ -70,6 +98,33 @@ struct RenderItem
 };
 
 
+// CPU-side results of the background loads.
+struct SkullMesh
+{
+	std::vector<Vertex> Vertices;
+	std::vector<std::int32_t> Indices;
+	BoundingBox Bounds;
+};
+
+struct SkinnedModel
+{
+	std::vector<M3DLoader::SkinnedVertex> Vertices;
+	std::vector<std::uint16_t> Indices;
+	std::vector<M3DLoader::Subset> Subsets;
+	std::vector<M3DLoader::M3dMaterial> Mats;
+	SkinnedData SkinnedInfo;
+};
+
+// The textures a material samples, by name.  Its SRV indices point at the
+// placeholders until these have been uploaded.
+struct MaterialTextures
+{
+	Material* Mat = nullptr;
+	std::string DiffuseMapName;
+	std::string NormalMapName;
+};
+
+
 enum class RenderLayer : int
 {
 	Opaque = 0,
@@ -100,6 +155,8 @@ private:
 	virtual void OnMouseDown(WPARAM btnState, int x, int y) override;
 	virtual void OnMouseMove(WPARAM btnState, int x, int y) override;
 
+	void QueueAssetLoads();
+
 	void OnKeyboardInput(const GameTimer& gt);
 	void AnimateMaterials(const GameTimer& gt);
 	void UpdateObjectCBs(const GameTimer& gt);
@@ -110,14 +167,19 @@ private:
 	void UpdateShadowPassCB(const GameTimer& gt);
 	void UpdateSsaoCB(const GameTimer& gt);
 
-	void LoadTextures();
+	void QueueTextureLoad(const std::string& name, const std::string& filename);
 	void BuildRootSignature();
 	void BuildSsaoRootSignature();
 	void BuildDescriptorHeaps();
+	void BuildPlaceholderTexture(const std::string& name, UINT color, UINT srvIndex);
+	void BuildTexture(const std::string& name, const std::vector<char>& bytes);
+	void SetMaterialTextures(Material* mat, const std::string& diffuseMapName, const std::string& normalMapName);
 	void BuildShadersAndInputLayout();
 	void BuildShapeGeometry();
-	void BuildSkullGeometry();
-	void LoadSkinnedModel();
+	void BuildSkullGeometry(const SkullMesh& mesh);
+	void BuildSkinnedModel(SkinnedModel& model);
+	void RecordPendingUploads();
+	void ReleaseAfterFrame(ComPtr<ID3D12Resource>& uploadBuffer);
 	void BuildPSOs();
 	void BuildFrameResources();
 	void BuildMaterials();
@@ -156,6 +218,10 @@ private:
 	// Render items divided by PSO.
 	std::vector<RenderItem*> mRitemLayer[(int)RenderLayer::Count];
 
+	UINT mPlaceholderDiffuseSrvIndex = 0;
+	UINT mPlaceholderNormalSrvIndex = 0;
+	UINT mNextTextureSrvIndex = 0;
+
 	UINT mSkyTexHeapIndex = 0;
 	UINT mShadowMapHeapIndex = 0;
 
@@ -167,17 +233,33 @@ private:
 	UINT mNullTexSrvIndex2 = 0;
 
 	CD3DX12_GPU_DESCRIPTOR_HANDLE mNullSrv;
+	CD3DX12_GPU_DESCRIPTOR_HANDLE mNullCubeSrv;
+
+	// The null cube until the sky's texture has been uploaded.
+	CD3DX12_GPU_DESCRIPTOR_HANDLE mSkySrv;
+
+	std::vector<MaterialTextures> mMaterialTextures;
+	std::unordered_map<std::string, UINT> mTextureSrvIndices;
 
 	PassConstants mMainPassCB;
 	PassConstants mShadowPassCB;
 
-	UINT mSkinnedSrvHeapStart = 0;
 	std::string mSkinnedModelFilename = "..\\Models\\soldier.m3d";
-	std::unique_ptr<SkinnedModelInstance> mSkinnedModelInst;
+	std::vector<std::unique_ptr<SkinnedModelInstance>> mSkinnedModelInsts;
+	std::vector<PoseRequest> mSkinnedPoseRequests;
+	AnimationStage mAnimationStage;
 	SkinnedData mSkinnedInfo;
 	std::vector<M3DLoader::Subset> mSkinnedSubsets;
 	std::vector<M3DLoader::M3dMaterial> mSkinnedMats;
-	std::vector<std::string> mSkinnedTextureNames;
+
+	// Nothing is waited for: the soldier, the skull and the textures are added to the
+	// scene as they load.  Their completion callbacks queue the GPU copies, which Draw
+	// records at the top of the next frame's command list; the upload buffers are
+	// released once that frame's fence has passed.
+	AssetLoader mAssetLoader;
+	std::vector<std::function<void()>> mPendingUploads;
+	std::vector<std::pair<UINT64, ComPtr<ID3D12Resource>>> mReleasedUploadBuffers;
+	RenderItem* mSkullRitem = nullptr;
 
 	Camera mCamera;
 
@@ -252,19 +334,20 @@ bool SkinnedMeshApp::Initialize()
 	}
 	ThrowIfFailed(mCommandList->Reset(mDirectCmdListAlloc.Get(), nullptr));
 
+	// The models and textures are read and decoded while the scene is built below,
+	// and added to it from Update as they arrive.
+	QueueAssetLoads();
+
 	mCamera.SetPosition(0.0f, 2.0f, -15.0f);
 
 	mShadowMap = std::make_unique<ShadowMap>(md3dDevice.Get(), 2048, 2048);
 	mSsao = std::make_unique<Ssao>(md3dDevice.Get(), mCommandList.Get(), mClientWidth, mClientHeight);
 
-	LoadSkinnedModel();
-	LoadTextures();
 	BuildRootSignature();
 	BuildSsaoRootSignature();
-	BuildDescriptorHeaps();
 	BuildShadersAndInputLayout();
 	BuildShapeGeometry();
-	BuildSkullGeometry();
+	BuildDescriptorHeaps();
 	BuildMaterials();
 	BuildRenderItems();
 	BuildFrameResources();
@@ -318,6 +401,8 @@ void SkinnedMeshApp::Update(const GameTimer& gt)
 {
 	OnKeyboardInput(gt);
 
+	mAssetLoader.DispatchCompletions();
+
 	mCurrFrameResourceIndex = (mCurrFrameResourceIndex + 1) % gNumFrameResources;
 	mCurrFrameResource = mFrameResources[mCurrFrameResourceIndex].get();
 
@@ -329,6 +414,12 @@ void SkinnedMeshApp::Update(const GameTimer& gt)
 		CloseHandle(eventHandle);
 	}
 
+	// Release the upload buffers of the copies the GPU has finished.
+	const UINT64 completedFence = mFence->GetCompletedValue();
+	mReleasedUploadBuffers.erase(std::remove_if(mReleasedUploadBuffers.begin(), mReleasedUploadBuffers.end(),
+		[completedFence](const std::pair<UINT64, ComPtr<ID3D12Resource>>& e) { return e.first <= completedFence; }),
+		mReleasedUploadBuffers.end());
+
 	// Animate the lights (and hence shadows)
 	mLightRotationAngle += 0.1f * gt.DeltaTime();
 	XMMATRIX R = XMMatrixRotationY(mLightRotationAngle);
@@ -357,6 +448,8 @@ void SkinnedMeshApp::Draw(const GameTimer& gt)
 
 	ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), mPSOs["opaque"].Get()));
 
+	RecordPendingUploads();
+
 	ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvDescriptorHeap.Get() };
 	mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
 
@@ -370,6 +463,7 @@ void SkinnedMeshApp::Draw(const GameTimer& gt)
 		// Bind null SRV for shadow map pass.
 		mCommandList->SetGraphicsRootDescriptorTable(4, mNullSrv);
 		mCommandList->SetGraphicsRootDescriptorTable(5, mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
+		mCommandList->SetGraphicsRootDescriptorTable(6, mNullCubeSrv);
 
 		DrawSceneToShadowMap();
 		DrawNormalsAndDepth();
@@ -399,10 +493,9 @@ void SkinnedMeshApp::Draw(const GameTimer& gt)
 	mCommandList->SetGraphicsRootConstantBufferView(1, passCB->GetGPUVirtualAddress());
 	mCommandList->SetGraphicsRootShaderResourceView(3, matBuffer->GetGPUVirtualAddress());
 
-	CD3DX12_GPU_DESCRIPTOR_HANDLE skyTexDescriptor(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-	skyTexDescriptor.Offset(mSkyTexHeapIndex, mCbvSrvUavDescriptorSize);
-	mCommandList->SetGraphicsRootDescriptorTable(4, skyTexDescriptor);
+	mCommandList->SetGraphicsRootDescriptorTable(4, GetGpuSrv(mShadowMapHeapIndex));
 	mCommandList->SetGraphicsRootDescriptorTable(5, mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
+	mCommandList->SetGraphicsRootDescriptorTable(6, mSkySrv);
 
 	mCommandList->SetPipelineState(mPSOs["opaque"].Get());
 	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
@@ -433,6 +526,143 @@ void SkinnedMeshApp::Draw(const GameTimer& gt)
 	mCommandQueue->Signal(mFence.Get(), mCurrentFence);
 }
 
+// Runs on an AssetLoader thread, so it only touches the mesh it fills.
+static bool LoadSkullMesh(SkullMesh& mesh)
+{
+	std::vector<MeshFileVertex> meshVertices;
+	std::vector<std::uint32_t> meshIndices;
+	if (!LoadTextMeshParallel("../Models/skull.txt", meshVertices, meshIndices))
+	{
+		return false;
+	}
+
+	OptimizeMesh(meshVertices, meshIndices);
+
+	std::vector<Vertex>& vertices = mesh.Vertices;
+	vertices.resize(meshVertices.size());
+	for (size_t i = 0; i < meshVertices.size(); ++i)
+	{
+		vertices[i].Pos = meshVertices[i].Pos;
+		vertices[i].Normal = meshVertices[i].Normal;
+
+		vertices[i].TexC = { 0.0f, 0.0f };
+
+		XMVECTOR N = XMLoadFloat3(&vertices[i].Normal);
+
+		// Generate a tangent vector so normal mapping works.
+		// We aren't applying a texture map to the skull,
+		// so we just need any tangent vector
+		// so that the math works out to give us the original interpolated vertex normal.
+		XMVECTOR up = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+		if (fabsf(XMVectorGetX(XMVector3Dot(N, up))) < 1.0f - 0.001f)
+		{
+			XMVECTOR T = XMVector3Normalize(XMVector3Cross(up, N));
+			XMStoreFloat3(&vertices[i].TangentU, T);
+		}
+		else
+		{
+			up = XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
+			XMVECTOR T = XMVector3Normalize(XMVector3Cross(N, up));
+			XMStoreFloat3(&vertices[i].TangentU, T);
+		}
+	}
+
+	mesh.Bounds = ComputeMeshBounds(meshVertices.data(), meshVertices.size());
+	mesh.Indices.assign(meshIndices.begin(), meshIndices.end());
+
+	return true;
+}
+
+void SkinnedMeshApp::QueueAssetLoads()
+{
+	std::string skinnedModelFilename = mSkinnedModelFilename;
+	mAssetLoader.Load<SkinnedModel>([skinnedModelFilename](SkinnedModel& model)
+		{
+			// Prefer soldier.m3db, written by the ModelConverter tool, when it is there.
+			M3DLoader m3dLoader;
+			if (!m3dLoader.LoadM3db(skinnedModelFilename + "b", model.Vertices, model.Indices,
+					model.Subsets, model.Mats, model.SkinnedInfo) &&
+				!m3dLoader.LoadM3d(skinnedModelFilename, model.Vertices, model.Indices,
+					model.Subsets, model.Mats, model.SkinnedInfo))
+			{
+				return false;
+			}
+
+			// The default tolerances are well below what is visible at this scale.
+			model.SkinnedInfo.CompressClips(AnimationCompressionSettings());
+			return true;
+		},
+		[this](SkinnedModel& model, bool loaded)
+		{
+			if (!loaded)
+			{
+				MessageBox(0, L"../Models/soldier.m3d not found.", 0, 0);
+				return;
+			}
+			BuildSkinnedModel(model);
+		});
+
+	QueueTextureLoad("bricksDiffuseMap", "../Textures/bricks2.dds");
+	QueueTextureLoad("bricksNormalMap", "../Textures/bricks2_nmap.dds");
+	QueueTextureLoad("tileDiffuseMap", "../Textures/tile.dds");
+	QueueTextureLoad("tileNormalMap", "../Textures/tile_nmap.dds");
+	QueueTextureLoad("defaultDiffuseMap", "../Textures/white1x1.dds");
+	QueueTextureLoad("defaultNormalMap", "../Textures/default_nmap.dds");
+	QueueTextureLoad("skyCubeMap", "../Textures/desertcube1024.dds");
+
+	mAssetLoader.Load<SkullMesh>(&LoadSkullMesh,
+		[this](SkullMesh& mesh, bool loaded)
+		{
+			if (!loaded)
+			{
+				MessageBox(0, L"../Models/skull.txt not found.", 0, 0);
+				return;
+			}
+			mPendingUploads.push_back([this, mesh = std::move(mesh)]() { BuildSkullGeometry(mesh); });
+		});
+}
+
+void SkinnedMeshApp::QueueTextureLoad(const std::string& name, const std::string& filename)
+{
+	// Don't load duplicates.
+	if (mTextures.find(name) != std::end(mTextures))
+	{
+		return;
+	}
+
+	auto texMap = std::make_unique<Texture>();
+	texMap->Name = name;
+	texMap->Filename = AnsiToWString(filename);
+	mTextures[name] = std::move(texMap);
+
+	// A file that could not be read leaves the materials on their placeholders.
+	mAssetLoader.LoadFileBytes(filename,
+		[this, name](std::vector<char>& bytes, bool loaded)
+		{
+			if (loaded)
+			{
+				mPendingUploads.push_back([this, name, bytes = std::move(bytes)]() { BuildTexture(name, bytes); });
+			}
+		});
+}
+
+void SkinnedMeshApp::RecordPendingUploads()
+{
+	// The copies of the assets that arrived since the last frame go ahead of the
+	// draws that use them.
+	for (auto& upload : mPendingUploads)
+	{
+		upload();
+	}
+	mPendingUploads.clear();
+}
+
+void SkinnedMeshApp::ReleaseAfterFrame(ComPtr<ID3D12Resource>& uploadBuffer)
+{
+	// The frame being recorded signals mCurrentFence + 1 when it is done.
+	mReleasedUploadBuffers.emplace_back(mCurrentFence + 1, std::move(uploadBuffer));
+}
+
 void SkinnedMeshApp::OnMouseDown(WPARAM btnState, int x, int y)
 {
 	mLastMousePos.x = x;
@@ -528,15 +758,21 @@ void SkinnedMeshApp::UpdateSkinnedCBs(const GameTimer& gt)
 {
 	auto currSkinnedCB = mCurrFrameResource->SkinnedCB.get();
 
-	mSkinnedModelInst->UpdateSkinnedAnimation(gt.DeltaTime());
+	for (size_t i = 0; i < mSkinnedModelInsts.size(); ++i)
+	{
+		SkinnedModelInstance* inst = mSkinnedModelInsts[i].get();
+		inst->AdvanceTime(gt.DeltaTime());
+
+		PoseRequest& request = mSkinnedPoseRequests[i];
+		request.Clip = inst->Clip;
+		request.TimePos = inst->TimePos;
+		request.KeyframeCursors = inst->KeyframeCursors.data();
+		request.FinalTransforms = currSkinnedCB->MappedElement(inst->SkinnedCBIndex)->BoneTransforms;
+	}
 
-	SkinnedConstants skinnedConstants;
-	std::copy(
-		std::begin(mSkinnedModelInst->FinalTransforms),
-		std::end(mSkinnedModelInst->FinalTransforms),
-		&skinnedConstants.BoneTransforms[0]
-	);
-	currSkinnedCB->CopyData(0, skinnedConstants);
+	// Poses every soldier straight into this frame's constant buffer; returns once
+	// all of them are written, before Draw records anything that reads them.
+	mAnimationStage.Run(mSkinnedInfo, mSkinnedPoseRequests.data(), (UINT)mSkinnedPoseRequests.size());
 }
 
 void SkinnedMeshApp::UpdateMaterialBuffer(const GameTimer& gt)
@@ -718,77 +954,20 @@ void SkinnedMeshApp::UpdateSsaoCB(const GameTimer& gt)
 	currSsaoCB->CopyData(0, ssaoCB);
 }
 
-void SkinnedMeshApp::LoadTextures()
-{
-	std::vector<std::string> texNames =
-	{
-		"bricksDiffuseMap",
-		"bricksNormalMap",
-		"tileDiffuseMap",
-		"tileNormalMap",
-		"defaultDiffuseMap",
-		"defaultNormalMap",
-		"skyCubeMap"
-	};
-
-	std::vector<std::wstring> texFilenames =
-	{
-		L"../Textures/bricks2.dds",
-		L"../Textures/bricks2_nmap.dds",
-		L"../Textures/tile.dds",
-		L"../Textures/tile_nmap.dds",
-		L"../Textures/white1x1.dds",
-		L"../Textures/default_nmap.dds",
-		L"../Textures/desertcube1024.dds"
-	};
-
-	// Add skinned model textures to list so we can reference by name later.
-	for (UINT i = 0; i < mSkinnedMats.size(); ++i)
-	{
-		std::string diffuseName = mSkinnedMats[i].DiffuseMapName;
-		std::string normalName = mSkinnedMats[i].NormalMapName;
-
-		std::wstring diffuseFilename = L"../Textures/" + AnsiToWString(diffuseName);
-		std::wstring normalFilename = L"../Textures/" + AnsiToWString(normalName);
-
-		// strip off extension
-		diffuseName = diffuseName.substr(0, diffuseName.find_last_of("."));
-		normalName = normalName.substr(0, normalName.find_last_of("."));
-
-		mSkinnedTextureNames.emplace_back(diffuseName);
-		texNames.emplace_back(diffuseName);
-		texFilenames.emplace_back(diffuseFilename);
-
-		mSkinnedTextureNames.emplace_back(normalName);
-		texNames.emplace_back(normalName);
-		texFilenames.emplace_back(normalFilename);
-	}
-
-	for (int i = 0; i < (int)texNames.size(); ++i)
-	{	// Don't create duplicates.
-		if (mTextures.find(texNames[i]) == std::end(mTextures))
-		{
-			auto texMap = std::make_unique<Texture>();
-			texMap->Name = texNames[i];
-			texMap->Filename = texFilenames[i];
-			ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-				mCommandList.Get(), texMap->Filename.c_str(),
-				texMap->Resource, texMap->UploadHeap));
-
-			mTextures[texMap->Name] = std::move(texMap);
-		}
-	}
-}
-
 void SkinnedMeshApp::BuildRootSignature()
 {
 	CD3DX12_DESCRIPTOR_RANGE texTable0;
-	texTable0.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 3, 0, 0);
+	texTable0.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 2, 1, 0);
 
 	CD3DX12_DESCRIPTOR_RANGE texTable1;
-	texTable1.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 48, 3, 0);
+	texTable1.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, gNumTextureMapSrvs, 3, 0);
 
-	CD3DX12_ROOT_PARAMETER slotRootParameter[6];
+	// The sky has a table of its own so it can be switched from the null cube once
+	// it has loaded, without touching descriptors frames in flight still read.
+	CD3DX12_DESCRIPTOR_RANGE cubeTable;
+	cubeTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 0);
+
+	CD3DX12_ROOT_PARAMETER slotRootParameter[7];
 
 	slotRootParameter[0].InitAsConstantBufferView(0);
 	slotRootParameter[1].InitAsConstantBufferView(1);
@@ -796,10 +975,11 @@ void SkinnedMeshApp::BuildRootSignature()
 	slotRootParameter[3].InitAsShaderResourceView(0, 1);
 	slotRootParameter[4].InitAsDescriptorTable(1, &texTable0, D3D12_SHADER_VISIBILITY_PIXEL);
 	slotRootParameter[5].InitAsDescriptorTable(1, &texTable1, D3D12_SHADER_VISIBILITY_PIXEL);
+	slotRootParameter[6].InitAsDescriptorTable(1, &cubeTable, D3D12_SHADER_VISIBILITY_PIXEL);
 
 	auto staticSamplers = GetStaticSamplers();
 
-	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(6, slotRootParameter,
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(7, slotRootParameter,
 		(UINT)staticSamplers.size(), staticSamplers.data(),
 		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
@@ -908,68 +1088,41 @@ void SkinnedMeshApp::BuildDescriptorHeaps()
 		&srvHeapDesc, IID_PPV_ARGS(&mSrvDescriptorHeap)
 	));
 
-	// Fill out the heap
-	CD3DX12_CPU_DESCRIPTOR_HANDLE hDescriptor(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
+	// The 2D textures come first, where gTextureMaps sees them: the placeholders, then
+	// a slot for each texture as it is uploaded.
+	mPlaceholderDiffuseSrvIndex = 0;
+	mPlaceholderNormalSrvIndex = 1;
+	mNextTextureSrvIndex = 2;
 
-	std::vector<ComPtr<ID3D12Resource>> tex2DList =
-	{
-		mTextures["bricksDiffuseMap"]->Resource,
-		mTextures["bricksNormalMap"]->Resource,
-		mTextures["tileDiffuseMap"]->Resource,
-		mTextures["tileNormalMap"]->Resource,
-		mTextures["defaultDiffuseMap"]->Resource,
-		mTextures["defaultNormalMap"]->Resource
-	};
+	mSkyTexHeapIndex = gNumTextureMapSrvs;
+	mShadowMapHeapIndex = mSkyTexHeapIndex + 1;
 
-	mSkinnedSrvHeapStart = (UINT)tex2DList.size();
+	mSsaoHeapIndexStart = mShadowMapHeapIndex + 1;
+	mSsaoAmbientMapIndex = mSsaoHeapIndexStart + 3;
 
-	for (UINT i = 0; i < (UINT)mSkinnedTextureNames.size(); ++i)
-	{
-		auto texResource = mTextures[mSkinnedTextureNames[i]]->Resource;
-		assert(texResource != nullptr);
-		tex2DList.emplace_back(texResource);
-	}
+	mNullCubeSrvIndex = mSsaoHeapIndexStart + 5;
+	mNullTexSrvIndex1 = mNullCubeSrvIndex + 1;
+	mNullTexSrvIndex2 = mNullTexSrvIndex1 + 1;
 
-	auto skyCubeMap = mTextures["skyCubeMap"]->Resource;
+	// White, and a normal straight out of the surface.
+	BuildPlaceholderTexture("placeholderDiffuseMap", 0xffffffff, mPlaceholderDiffuseSrvIndex);
+	BuildPlaceholderTexture("placeholderNormalMap", 0xffff8080, mPlaceholderNormalSrvIndex);
 
 	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
 	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-
-	for (UINT i = 0; i < (UINT)tex2DList.size(); ++i)
-	{
-		srvDesc.Format = tex2DList[i]->GetDesc().Format;
-		srvDesc.Texture2D.MipLevels = tex2DList[i]->GetDesc().MipLevels;
-		md3dDevice->CreateShaderResourceView(tex2DList[i].Get(), &srvDesc, hDescriptor);
-
-		// next descriptor
-		hDescriptor.Offset(1, mCbvSrvUavDescriptorSize);
-	}
-
+	srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
 	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
 	srvDesc.TextureCube.MostDetailedMip = 0;
-	srvDesc.TextureCube.MipLevels = skyCubeMap->GetDesc().MipLevels;
+	srvDesc.TextureCube.MipLevels = 1;
 	srvDesc.TextureCube.ResourceMinLODClamp = 0.0f;
-	srvDesc.Format = skyCubeMap->GetDesc().Format;
-	md3dDevice->CreateShaderResourceView(skyCubeMap.Get(), &srvDesc, hDescriptor);
-
-	mSkyTexHeapIndex = (UINT)tex2DList.size();
-	mShadowMapHeapIndex = mSkyTexHeapIndex + 1;
-
-	mSsaoHeapIndexStart = mShadowMapHeapIndex + 1;
-	mSsaoAmbientMapIndex = mSsaoHeapIndexStart + 3;
-
-	mNullCubeSrvIndex = mSsaoHeapIndexStart + 5;
-	mNullTexSrvIndex1 = mNullCubeSrvIndex + 1;
-	mNullTexSrvIndex2 = mNullTexSrvIndex1 + 1;
 
 	auto nullSrv = GetCpuSrv(mNullCubeSrvIndex);
-	mNullSrv = GetGpuSrv(mNullCubeSrvIndex);
+	mNullCubeSrv = GetGpuSrv(mNullCubeSrvIndex);
+	mSkySrv = mNullCubeSrv;
 	md3dDevice->CreateShaderResourceView(nullptr, &srvDesc, nullSrv);
 
 	nullSrv.Offset(1, mCbvSrvUavDescriptorSize);
+	mNullSrv = GetGpuSrv(mNullTexSrvIndex1);
 
 	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
 	srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
@@ -997,6 +1150,115 @@ void SkinnedMeshApp::BuildDescriptorHeaps()
 	);
 }
 
+void SkinnedMeshApp::BuildPlaceholderTexture(const std::string& name, UINT color, UINT srvIndex)
+{
+	// A 1x1 texture of one RGBA8 color, copied on the Initialize command list.
+	auto texMap = std::make_unique<Texture>();
+	texMap->Name = name;
+
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, 1, 1, 1, 1),
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(texMap->Resource.GetAddressOf())));
+
+	const UINT64 uploadBufferSize = GetRequiredIntermediateSize(texMap->Resource.Get(), 0, 1);
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(texMap->UploadHeap.GetAddressOf())));
+
+	D3D12_SUBRESOURCE_DATA subResourceData = {};
+	subResourceData.pData = &color;
+	subResourceData.RowPitch = sizeof(UINT);
+	subResourceData.SlicePitch = subResourceData.RowPitch;
+
+	UpdateSubresources<1>(mCommandList.Get(), texMap->Resource.Get(), texMap->UploadHeap.Get(), 0, 0, 1, &subResourceData);
+	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(texMap->Resource.Get(),
+		D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Texture2D.MostDetailedMip = 0;
+	srvDesc.Texture2D.MipLevels = 1;
+	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
+	md3dDevice->CreateShaderResourceView(texMap->Resource.Get(), &srvDesc, GetCpuSrv(srvIndex));
+
+	mTextures[texMap->Name] = std::move(texMap);
+}
+
+void SkinnedMeshApp::BuildTexture(const std::string& name, const std::vector<char>& bytes)
+{
+	Texture* texMap = mTextures[name].get();
+
+	// A file that is not a texture is treated like a missing one; the placeholder stays.
+	if (FAILED(DirectX::CreateDDSTextureFromMemory12(md3dDevice.Get(),
+		mCommandList.Get(), reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size(),
+		texMap->Resource, texMap->UploadHeap)))
+	{
+		return;
+	}
+	ReleaseAfterFrame(texMap->UploadHeap);
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Format = texMap->Resource->GetDesc().Format;
+
+	// Each view goes in a slot no recorded frame reads yet, so the frames in flight
+	// are left alone; the draws of this frame on see the texture.
+	if (name == "skyCubeMap")
+	{
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
+		srvDesc.TextureCube.MostDetailedMip = 0;
+		srvDesc.TextureCube.MipLevels = texMap->Resource->GetDesc().MipLevels;
+		srvDesc.TextureCube.ResourceMinLODClamp = 0.0f;
+		md3dDevice->CreateShaderResourceView(texMap->Resource.Get(), &srvDesc, GetCpuSrv(mSkyTexHeapIndex));
+
+		mSkySrv = GetGpuSrv(mSkyTexHeapIndex);
+		return;
+	}
+
+	if (mNextTextureSrvIndex == gNumTextureMapSrvs)
+	{
+		return;
+	}
+	const UINT srvIndex = mNextTextureSrvIndex++;
+
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Texture2D.MostDetailedMip = 0;
+	srvDesc.Texture2D.MipLevels = texMap->Resource->GetDesc().MipLevels;
+	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
+	md3dDevice->CreateShaderResourceView(texMap->Resource.Get(), &srvDesc, GetCpuSrv(srvIndex));
+
+	// The material buffers are rewritten from the next frame on, which the GPU runs
+	// after this frame's copy.
+	mTextureSrvIndices[name] = srvIndex;
+	for (const MaterialTextures& m : mMaterialTextures)
+	{
+		if (m.DiffuseMapName == name || m.NormalMapName == name)
+		{
+			SetMaterialTextures(m.Mat, m.DiffuseMapName, m.NormalMapName);
+		}
+	}
+}
+
+void SkinnedMeshApp::SetMaterialTextures(Material* mat, const std::string& diffuseMapName, const std::string& normalMapName)
+{
+	auto diffuse = mTextureSrvIndices.find(diffuseMapName);
+	auto normal = mTextureSrvIndices.find(normalMapName);
+
+	mat->DiffuseSrvHeapIndex = diffuse != std::end(mTextureSrvIndices) ? diffuse->second : mPlaceholderDiffuseSrvIndex;
+	mat->NormalSrvHeapIndex = normal != std::end(mTextureSrvIndices) ? normal->second : mPlaceholderNormalSrvIndex;
+	mat->NumFramesDirty = gNumFrameResources;
+}
+
 void SkinnedMeshApp::BuildShadersAndInputLayout()
 {
 	const D3D_SHADER_MACRO alphaTestDefines[] =
@@ -1191,97 +1453,27 @@ void SkinnedMeshApp::BuildShapeGeometry()
 	mGeometries[geo->Name] = std::move(geo);
 }
 
-void SkinnedMeshApp::BuildSkullGeometry()
+void SkinnedMeshApp::BuildSkullGeometry(const SkullMesh& mesh)
 {
-	std::ifstream fin("../Models/skull.txt");
-
-	if (!fin)
-	{
-		MessageBox(0, L"../Models/skull.txt not found.", 0, 0);
-		return;
-	}
-
-	UINT vcount = 0;
-	UINT tcount = 0;
-	std::string ignore;
-
-	fin >> ignore >> vcount;
-	fin >> ignore >> tcount;
-	fin >> ignore >> ignore >> ignore >> ignore;
-
-	XMFLOAT3 vMinf3(+MathHelper::Infinity, +MathHelper::Infinity, +MathHelper::Infinity);
-	XMFLOAT3 vMaxf3(-MathHelper::Infinity, -MathHelper::Infinity, -MathHelper::Infinity);
-
-	XMVECTOR vMin = XMLoadFloat3(&vMinf3);
-	XMVECTOR vMax = XMLoadFloat3(&vMaxf3);
+	const std::vector<Vertex>& vertices = mesh.Vertices;
+	const std::vector<std::int32_t>& indices = mesh.Indices;
 
-	std::vector<Vertex> vertices(vcount);
-	for (UINT i = 0; i < vcount; ++i)
-	{
-		fin >> vertices[i].Pos.x >> vertices[i].Pos.y >> vertices[i].Pos.z;
-		fin >> vertices[i].Normal.x >> vertices[i].Normal.y >> vertices[i].Normal.z;
-
-		vertices[i].TexC = { 0.0f, 0.0f };
-
-		XMVECTOR P = XMLoadFloat3(&vertices[i].Pos);
-
-		XMVECTOR N = XMLoadFloat3(&vertices[i].Normal);
-
-		// Generate a tangent vector so normal mapping works.
-		// We aren't applying a texture map to the skull,
-		// so we just need any tangent vector
-		// so that the math works out to give us the original interpolated vertex normal.
-		XMVECTOR up = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
-		if (fabsf(XMVectorGetX(XMVector3Dot(N, up))) < 1.0f - 0.001f)
-		{
-			XMVECTOR T = XMVector3Normalize(XMVector3Cross(up, N));
-			XMStoreFloat3(&vertices[i].TangentU, T);
-		}
-		else
-		{
-			up = XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
-			XMVECTOR T = XMVector3Normalize(XMVector3Cross(N, up));
-			XMStoreFloat3(&vertices[i].TangentU, T);
-		}
-		vMin = XMVectorMin(vMin, P);
-		vMax = XMVectorMax(vMax, P);
-	}
-
-	BoundingBox bounds;
-	XMStoreFloat3(&bounds.Center, 0.5f * (vMin + vMax));
-	XMStoreFloat3(&bounds.Extents, 0.5f * (vMax - vMin));
-
-	fin >> ignore;
-	fin >> ignore;
-	fin >> ignore;
-
-	std::vector<std::int32_t> indices(3 * tcount);
-	for (UINT i = 0; i < tcount; ++i)
-	{
-		fin >> indices[i * 3 + 0] >> indices[i * 3 + 1] >> indices[i * 3 + 2];
-	}
-
-	fin.close();
-
-	// Pack the indices of all the meshes into one index buffer.
 	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
 	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::int32_t);
 
 	auto geo = std::make_unique<MeshGeometry>();
 	geo->Name = "skullGeo";
 
-	// ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-	// CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
-
-	// ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-	// CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
-
+	// Recorded by RecordPendingUploads, ahead of this frame's draws.
 	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
 		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
 
 	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
 		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
 
+	ReleaseAfterFrame(geo->VertexBufferUploader);
+	ReleaseAfterFrame(geo->IndexBufferUploader);
+
 	geo->VertexByteStride = sizeof(Vertex);
 	geo->VertexBufferByteSize = vbByteSize;
 	geo->IndexFormat = DXGI_FORMAT_R32_UINT;
@@ -1291,45 +1483,83 @@ void SkinnedMeshApp::BuildSkullGeometry()
 	submesh.IndexCount = (UINT)indices.size();
 	submesh.StartIndexLocation = 0;
 	submesh.BaseVertexLocation = 0;
-	submesh.Bounds = bounds;
+	submesh.Bounds = mesh.Bounds;
 
 	geo->DrawArgs["skull"] = submesh;
 
+	// The render item was made without geometry; it is drawn from now on.
+	mSkullRitem->Geo = geo.get();
+	mSkullRitem->IndexCount = submesh.IndexCount;
+	mSkullRitem->StartIndexLocation = submesh.StartIndexLocation;
+	mSkullRitem->BaseVertexLocation = submesh.BaseVertexLocation;
+	mRitemLayer[(int)RenderLayer::Opaque].emplace_back(mSkullRitem);
+
 	mGeometries[geo->Name] = std::move(geo);
 }
 
-void SkinnedMeshApp::LoadSkinnedModel()
+void SkinnedMeshApp::BuildSkinnedModel(SkinnedModel& model)
 {
-	std::vector<M3DLoader::SkinnedVertex> vertices;
-	std::vector<std::uint16_t> indices;
+	// The frame resources were sized before the model arrived.
+	if (model.Mats.size() > gMaxSkinnedMaterials || model.Subsets.size() < model.Mats.size())
+	{
+		MessageBox(0, L"../Models/soldier.m3d has more materials than the frame resources hold.", 0, 0);
+		return;
+	}
 
-	M3DLoader m3dLoader;
-	m3dLoader.LoadM3d(mSkinnedModelFilename, vertices, indices,
-		mSkinnedSubsets, mSkinnedMats, mSkinnedInfo);
+	std::vector<M3DLoader::SkinnedVertex> vertices = std::move(model.Vertices);
+	std::vector<std::uint16_t> indices = std::move(model.Indices);
+	mSkinnedSubsets = std::move(model.Subsets);
+	mSkinnedMats = std::move(model.Mats);
+	mSkinnedInfo = std::move(model.SkinnedInfo);
 
-	mSkinnedModelInst = std::make_unique<SkinnedModelInstance>();
-	mSkinnedModelInst->SkinnedInfo = &mSkinnedInfo;
-	mSkinnedModelInst->FinalTransforms.resize(mSkinnedInfo.BoneCount());
-	mSkinnedModelInst->ClipName = "Take1";
-	mSkinnedModelInst->TimePos = 0.0f;
+	for (UINT i = 0; i < gNumSkinnedInstances; ++i)
+	{
+		auto inst = std::make_unique<SkinnedModelInstance>();
+		inst->SkinnedInfo = &mSkinnedInfo;
+		inst->SkinnedCBIndex = i;
+		inst->SetClip("Take1");
 
-	const UINT vbByteSize = (UINT)vertices.size() * sizeof(SkinnedVertex);
-	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
+		// Start the soldiers at different points of the walk cycle.
+		inst->TimePos = std::fmod(0.37f * i, inst->ClipEndTime);
 
-	auto geo = std::make_unique<MeshGeometry>();
-	geo->Name = mSkinnedModelFilename;
+		mSkinnedModelInsts.push_back(std::move(inst));
+	}
+	mSkinnedPoseRequests.resize(mSkinnedModelInsts.size());
 
-	// ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-	// CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+	// The materials start on the placeholders and pick up their textures as they load.
+	for (UINT i = 0; i < mSkinnedMats.size(); ++i)
+	{
+		std::string diffuseName = mSkinnedMats[i].DiffuseMapName;
+		std::string normalName = mSkinnedMats[i].NormalMapName;
 
-	// ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-	// CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+		std::string diffuseFilename = "../Textures/" + diffuseName;
+		std::string normalFilename = "../Textures/" + normalName;
 
-	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+		// strip off extension
+		diffuseName = diffuseName.substr(0, diffuseName.find_last_of("."));
+		normalName = normalName.substr(0, normalName.find_last_of("."));
 
-	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+		auto mat = std::make_unique<Material>();
+		mat->Name = mSkinnedMats[i].Name;
+		mat->MatCBIndex = (int)mMaterials.size();
+		mat->DiffuseAlbedo = mSkinnedMats[i].DiffuseAlbedo;
+		mat->FresnelR0 = mSkinnedMats[i].FresnelR0;
+		mat->Roughness = mSkinnedMats[i].Roughness;
+
+		SetMaterialTextures(mat.get(), diffuseName, normalName);
+		mMaterialTextures.push_back({ mat.get(), diffuseName, normalName });
+
+		mMaterials[mat->Name] = std::move(mat);
+
+		QueueTextureLoad(diffuseName, diffuseFilename);
+		QueueTextureLoad(normalName, normalFilename);
+	}
+
+	const UINT vbByteSize = (UINT)vertices.size() * sizeof(SkinnedVertex);
+	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
+
+	auto geo = std::make_unique<MeshGeometry>();
+	geo->Name = mSkinnedModelFilename;
 
 	geo->VertexByteStride = sizeof(SkinnedVertex);
 	geo->VertexBufferByteSize = vbByteSize;
@@ -1348,7 +1578,68 @@ void SkinnedMeshApp::LoadSkinnedModel()
 		geo->DrawArgs[name] = submesh;
 	}
 
+	MeshGeometry* skinnedGeo = geo.get();
 	mGeometries[geo->Name] = std::move(geo);
+
+	// The render items are made now, so their constants are written before the frame
+	// that uploads the geometry draws them.
+	std::vector<RenderItem*> skinnedRitems;
+	for (UINT instIndex = 0; instIndex < mSkinnedModelInsts.size(); ++instIndex)
+	{
+		SkinnedModelInstance* inst = mSkinnedModelInsts[instIndex].get();
+
+		// Extra soldiers stand in rows of ten, alternating left and right of the first.
+		UINT column = instIndex % 10;
+		float columnOffset = (column % 2 ? -2.0f : 2.0f) * ((column + 1) / 2);
+		float rowOffset = 3.0f * (instIndex / 10);
+
+		for (UINT i = 0; i < mSkinnedMats.size(); ++i)
+		{
+			std::string submeshName = "sm_" + std::to_string(i);
+
+			auto ritem = std::make_unique<RenderItem>();
+
+			// Reflect to change coordinate system from the RHS the data was exported out as.
+			XMMATRIX modelScale = XMMatrixScaling(0.05f, 0.05f, -0.05f);
+			XMMATRIX modelRot = XMMatrixRotationY(MathHelper::Pi);
+			XMMATRIX modelOffset = XMMatrixTranslation(columnOffset, 0.0f, -5.0f + rowOffset);
+			XMStoreFloat4x4(&ritem->World, modelScale * modelRot * modelOffset);
+
+			ritem->TexTransform = MathHelper::Identity4x4();
+			ritem->ObjCBIndex = (UINT)mAllRitems.size();
+			ritem->Mat = mMaterials[mSkinnedMats[i].Name].get();
+			ritem->Geo = skinnedGeo;
+			ritem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+			ritem->IndexCount = ritem->Geo->DrawArgs[submeshName].IndexCount;
+			ritem->StartIndexLocation = ritem->Geo->DrawArgs[submeshName].StartIndexLocation;
+			ritem->BaseVertexLocation = ritem->Geo->DrawArgs[submeshName].BaseVertexLocation;
+
+			// All render items for one soldier share its skinned model instance.
+			ritem->SkinnedCBIndex = inst->SkinnedCBIndex;
+			ritem->SkinnedModelInst = inst;
+
+			skinnedRitems.push_back(ritem.get());
+			mAllRitems.emplace_back(std::move(ritem));
+		}
+	}
+
+	mPendingUploads.push_back([this, skinnedGeo, skinnedRitems,
+		vertices = std::move(vertices), indices = std::move(indices)]()
+		{
+			skinnedGeo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
+				mCommandList.Get(), vertices.data(), skinnedGeo->VertexBufferByteSize, skinnedGeo->VertexBufferUploader);
+
+			skinnedGeo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
+				mCommandList.Get(), indices.data(), skinnedGeo->IndexBufferByteSize, skinnedGeo->IndexBufferUploader);
+
+			ReleaseAfterFrame(skinnedGeo->VertexBufferUploader);
+			ReleaseAfterFrame(skinnedGeo->IndexBufferUploader);
+
+			for (RenderItem* ritem : skinnedRitems)
+			{
+				mRitemLayer[(int)RenderLayer::SkinnedOpaque].emplace_back(ritem);
+			}
+		});
 }
 
 void SkinnedMeshApp::BuildPSOs()
@@ -1548,12 +1839,13 @@ void SkinnedMeshApp::BuildPSOs()
 
 void SkinnedMeshApp::BuildFrameResources()
 {
+	// With room for the soldiers, which are added when they have loaded.
 	for (int i = 0; i < gNumFrameResources; ++i)
 	{
 		mFrameResources.emplace_back(std::make_unique<FrameResource>(
 			md3dDevice.Get(), 2,
-			(UINT)mAllRitems.size(),
-			1, (UINT)mMaterials.size(),
+			(UINT)mAllRitems.size() + gNumSkinnedInstances * gMaxSkinnedMaterials,
+			gNumSkinnedInstances, (UINT)mMaterials.size() + gMaxSkinnedMaterials,
 			InitializeType::ssao
 		));
 	}
@@ -1564,8 +1856,6 @@ void SkinnedMeshApp::BuildMaterials()
 	auto bricks0 = std::make_unique<Material>();
 	bricks0->Name = "bricks0";
 	bricks0->MatCBIndex = 0;
-	bricks0->DiffuseSrvHeapIndex = 0;
-	bricks0->NormalSrvHeapIndex = 1;
 	bricks0->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 	bricks0->FresnelR0 = XMFLOAT3(0.1f, 0.1f, 0.1f);
 	bricks0->Roughness = 0.3f;
@@ -1573,8 +1863,6 @@ void SkinnedMeshApp::BuildMaterials()
 	auto tile0 = std::make_unique<Material>();
 	tile0->Name = "tile0";
 	tile0->MatCBIndex = 1;
-	tile0->DiffuseSrvHeapIndex = 2;
-	tile0->NormalSrvHeapIndex = 3;
 	tile0->DiffuseAlbedo = XMFLOAT4(0.9f, 0.9f, 0.9f, 1.0f);
 	tile0->FresnelR0 = XMFLOAT3(0.2f, 0.2f, 0.2f);
 	tile0->Roughness = 0.1f;
@@ -1582,8 +1870,6 @@ void SkinnedMeshApp::BuildMaterials()
 	auto mirror0 = std::make_unique<Material>();
 	mirror0->Name = "mirror0";
 	mirror0->MatCBIndex = 2;
-	mirror0->DiffuseSrvHeapIndex = 4;
-	mirror0->NormalSrvHeapIndex = 5;
 	mirror0->DiffuseAlbedo = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
 	mirror0->FresnelR0 = XMFLOAT3(0.98f, 0.97f, 0.95f);
 	mirror0->Roughness = 0.1f;
@@ -1591,8 +1877,6 @@ void SkinnedMeshApp::BuildMaterials()
 	auto skullMat = std::make_unique<Material>();
 	skullMat->Name = "skullMat";
 	skullMat->MatCBIndex = 3;
-	skullMat->DiffuseSrvHeapIndex = 4;
-	skullMat->NormalSrvHeapIndex = 5;
 	skullMat->DiffuseAlbedo = XMFLOAT4(0.3f, 0.3f, 0.3f, 1.0f);
 	skullMat->FresnelR0 = XMFLOAT3(0.6f, 0.6f, 0.6f);
 	skullMat->Roughness = 0.2f;
@@ -1606,27 +1890,25 @@ void SkinnedMeshApp::BuildMaterials()
 	sky->FresnelR0 = XMFLOAT3(0.1f, 0.1f, 0.1f);
 	sky->Roughness = 1.0f;
 
+	// They sample the placeholders until their textures have been uploaded.
+	const MaterialTextures materialTextures[] =
+	{
+		{ bricks0.get(), "bricksDiffuseMap", "bricksNormalMap" },
+		{ tile0.get(), "tileDiffuseMap", "tileNormalMap" },
+		{ mirror0.get(), "defaultDiffuseMap", "defaultNormalMap" },
+		{ skullMat.get(), "defaultDiffuseMap", "defaultNormalMap" }
+	};
+	for (const MaterialTextures& m : materialTextures)
+	{
+		SetMaterialTextures(m.Mat, m.DiffuseMapName, m.NormalMapName);
+		mMaterialTextures.push_back(m);
+	}
+
 	mMaterials["bricks0"] = std::move(bricks0);
 	mMaterials["tile0"] = std::move(tile0);
 	mMaterials["mirror0"] = std::move(mirror0);
 	mMaterials["skullMat"] = std::move(skullMat);
 	mMaterials["sky"] = std::move(sky);
-
-	UINT matCBIndex = 5;
-	UINT srvHeapIndex = mSkinnedSrvHeapStart;
-	for (UINT i = 0; i < mSkinnedMats.size(); ++i)
-	{
-		auto mat = std::make_unique<Material>();
-		mat->Name = mSkinnedMats[i].Name;
-		mat->MatCBIndex = matCBIndex++;
-		mat->DiffuseSrvHeapIndex = srvHeapIndex++;
-		mat->NormalSrvHeapIndex = srvHeapIndex++;
-		mat->DiffuseAlbedo = mSkinnedMats[i].DiffuseAlbedo;
-		mat->FresnelR0 = mSkinnedMats[i].FresnelR0;
-		mat->Roughness = mSkinnedMats[i].Roughness;
-
-		mMaterials[mat->Name] = std::move(mat);
-	}
 }
 
 void SkinnedMeshApp::BuildRenderItems()
@@ -1678,13 +1960,10 @@ void SkinnedMeshApp::BuildRenderItems()
 	skullRitem->TexTransform = MathHelper::Identity4x4();
 	skullRitem->ObjCBIndex = 3;
 	skullRitem->Mat = mMaterials["skullMat"].get();
-	skullRitem->Geo = mGeometries["skullGeo"].get();
 	skullRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	skullRitem->IndexCount = skullRitem->Geo->DrawArgs["skull"].IndexCount;
-	skullRitem->StartIndexLocation = skullRitem->Geo->DrawArgs["skull"].StartIndexLocation;
-	skullRitem->BaseVertexLocation = skullRitem->Geo->DrawArgs["skull"].BaseVertexLocation;
 
-	mRitemLayer[(int)RenderLayer::Opaque].emplace_back(skullRitem.get());
+	// Its geometry and its place in the opaque layer come with BuildSkullGeometry.
+	mSkullRitem = skullRitem.get();
 	mAllRitems.emplace_back(std::move(skullRitem));
 
 	auto gridRitem = std::make_unique<RenderItem>();
@@ -1766,36 +2045,6 @@ void SkinnedMeshApp::BuildRenderItems()
 		mAllRitems.emplace_back(std::move(leftSphereRitem));
 		mAllRitems.emplace_back(std::move(rightSphereRitem));
 	}
-
-	for (UINT i = 0; i < mSkinnedMats.size(); ++i)
-	{
-		std::string submeshName = "sm_" + std::to_string(i);
-
-		auto ritem = std::make_unique<RenderItem>();
-
-		// Reflect to change coordinate system from the RHS the data was exported out as.
-		XMMATRIX modelScale = XMMatrixScaling(0.05f, 0.05f, -0.05f);
-		XMMATRIX modelRot = XMMatrixRotationY(MathHelper::Pi);
-		XMMATRIX modelOffset = XMMatrixTranslation(0.0f, 0.0f, -5.0f);
-		XMStoreFloat4x4(&ritem->World, modelScale * modelRot * modelOffset);
-
-		ritem->TexTransform = MathHelper::Identity4x4();
-		ritem->ObjCBIndex = objCBIndex++;
-		ritem->Mat = mMaterials[mSkinnedMats[i].Name].get();
-		ritem->Geo = mGeometries[mSkinnedModelFilename].get();
-		ritem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		ritem->IndexCount = ritem->Geo->DrawArgs[submeshName].IndexCount;
-		ritem->StartIndexLocation = ritem->Geo->DrawArgs[submeshName].StartIndexLocation;
-		ritem->BaseVertexLocation = ritem->Geo->DrawArgs[submeshName].BaseVertexLocation;
-
-		// All render items for this solider.m3d instance share
-		// the same skinned model instance.
-		ritem->SkinnedCBIndex = 0;
-		ritem->SkinnedModelInst = mSkinnedModelInst.get();
-
-		mRitemLayer[(int)RenderLayer::SkinnedOpaque].emplace_back(ritem.get());
-		mAllRitems.emplace_back(std::move(ritem));
-	}
 }
 
 void SkinnedMeshApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
@@ -0,0 +1,201 @@
+//***************************************************************************************
+// AssetLoader.cpp
+//***************************************************************************************
+
+#include "AssetLoader.h"
+
+#include <fstream>
+
+
+AssetLoader::AssetLoader(int decodeThreadCount)
+{
+	if (decodeThreadCount <= 0)
+		decodeThreadCount = 2;
+
+	mIoThread = std::thread(&AssetLoader::IoLoop, this);
+	for (int i = 0; i < decodeThreadCount; ++i)
+	{
+		mDecodeThreads.emplace_back(&AssetLoader::DecodeLoop, this);
+	}
+}
+
+AssetLoader::~AssetLoader()
+{
+	std::deque<std::unique_ptr<Request>> dropped;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mShutdown = true;
+		dropped.swap(mIoQueue);
+		for (auto& request : mDecodeQueue)
+			dropped.push_back(std::move(request));
+		mDecodeQueue.clear();
+	}
+	mIoWake.notify_all();
+	mDecodeWake.notify_all();
+
+	for (auto& request : dropped)
+		request->Done.set_value(false);
+
+	mIoThread.join();
+	for (auto& thread : mDecodeThreads)
+	{
+		thread.join();
+	}
+}
+
+AssetHandle<std::vector<char>> AssetLoader::LoadFileBytes(const std::filesystem::path& filename,
+	CompletionFunc<std::vector<char>> onComplete)
+{
+	return LoadFile<std::vector<char>>(filename,
+		[](std::vector<char>& bytes, std::vector<char>& asset)
+		{
+			asset.swap(bytes);
+			return true;
+		},
+		std::move(onComplete));
+}
+
+int AssetLoader::DispatchCompletions()
+{
+	std::deque<std::unique_ptr<Request>> completed;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		completed.swap(mCompleted);
+	}
+
+	// Outside the lock: callbacks may queue further requests.
+	for (auto& request : completed)
+	{
+		if (request->Complete)
+			request->Complete(request->Loaded);
+		mPendingCount.fetch_sub(1, std::memory_order_release);
+	}
+
+	return (int)completed.size();
+}
+
+void AssetLoader::WaitIdle()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mIdle.wait(lock, [this]
+		{
+			return mIoQueue.empty() && mDecodeQueue.empty() && mBusyCount == 0;
+		});
+}
+
+void AssetLoader::Enqueue(std::unique_ptr<Request> request)
+{
+	mPendingCount.fetch_add(1, std::memory_order_relaxed);
+
+	const bool needsRead = !request->Filename.empty();
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (needsRead)
+			mIoQueue.push_back(std::move(request));
+		else
+			mDecodeQueue.push_back(std::move(request));
+	}
+
+	if (needsRead)
+		mIoWake.notify_one();
+	else
+		mDecodeWake.notify_one();
+}
+
+void AssetLoader::IoLoop()
+{
+	for (;;)
+	{
+		std::unique_ptr<Request> request;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mIoWake.wait(lock, [this] { return mShutdown || !mIoQueue.empty(); });
+			if (mShutdown)
+				return;
+
+			request = std::move(mIoQueue.front());
+			mIoQueue.pop_front();
+			++mBusyCount;
+		}
+
+		if (!ReadFile(request->Filename, request->Bytes))
+		{
+			Finish(std::move(request), false);
+			continue;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			--mBusyCount;
+			if (mShutdown)
+			{
+				request->Done.set_value(false);
+				continue;
+			}
+			mDecodeQueue.push_back(std::move(request));
+		}
+		mDecodeWake.notify_one();
+	}
+}
+
+void AssetLoader::DecodeLoop()
+{
+	for (;;)
+	{
+		std::unique_ptr<Request> request;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mDecodeWake.wait(lock, [this] { return mShutdown || !mDecodeQueue.empty(); });
+			if (mShutdown)
+				return;
+
+			request = std::move(mDecodeQueue.front());
+			mDecodeQueue.pop_front();
+			++mBusyCount;
+		}
+
+		// A decoder that throws (ThrowIfFailed, say) fails its own request only.
+		bool loaded = false;
+		try
+		{
+			loaded = request->Decode(request->Bytes);
+		}
+		catch (...)
+		{
+			loaded = false;
+		}
+
+		// The bytes are not needed past the decode.
+		std::vector<char>().swap(request->Bytes);
+
+		Finish(std::move(request), loaded);
+	}
+}
+
+void AssetLoader::Finish(std::unique_ptr<Request> request, bool loaded)
+{
+	request->Loaded = loaded;
+	request->Done.set_value(loaded);
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mCompleted.push_back(std::move(request));
+		--mBusyCount;
+	}
+	mIdle.notify_all();
+}
+
+bool AssetLoader::ReadFile(const std::filesystem::path& filename, std::vector<char>& bytes)
+{
+	std::ifstream file(filename, std::ios::binary | std::ios::ate);
+	if (!file)
+		return false;
+
+	const std::streamoff size = file.tellg();
+	if (size < 0)
+		return false;
+
+	bytes.resize((std::size_t)size);
+	file.seekg(0);
+	return file.read(bytes.data(), size).good() || size == 0;
+}
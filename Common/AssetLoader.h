@@ -0,0 +1,214 @@
+//***************************************************************************************
+// AssetLoader.h
+//
+// Background loading for meshes, models and textures, so an app can queue its assets
+// at startup and draw its first frames while they arrive.
+//
+// A request goes through up to three stages:
+//
+//   1. I/O:     LoadFile requests have their file read into memory by the single I/O
+//               thread, which keeps the disk access sequential.
+//   2. Decode:  the request's decode function turns that (or, for Load, its own file
+//               access) into the CPU-side asset on one of the decode threads.  Decoders
+//               may use ParallelFor.
+//   3. Complete: DispatchCompletions, called by the app once per frame, runs the
+//               completion callbacks of finished requests on the calling thread.  This
+//               is where GPU resources are created, since only that thread records
+//               commands; the loader itself never touches D3D.
+//
+// Load and LoadFile return an AssetHandle, a future for the decoded asset: it can be
+// polled, or waited on when an asset is needed before anything can be drawn.
+//***************************************************************************************
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+template<typename T>
+class AssetHandle
+{
+public:
+	AssetHandle() = default;
+
+	bool IsValid() const { return mAsset != nullptr; }
+
+	// True once the decode has finished, whether or not it succeeded.
+	bool IsDone() const
+	{
+		return mDone.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}
+
+	// Blocks until the decode has finished and returns whether it succeeded.  The
+	// completion callback may still be waiting for DispatchCompletions.
+	bool Wait() const { return mDone.get(); }
+
+	// The decoded asset; only meaningful after Wait() has returned true.
+	T& Get() const { return *mAsset; }
+
+private:
+	friend class AssetLoader;
+
+	std::shared_ptr<T> mAsset;
+	std::shared_future<bool> mDone;
+};
+
+
+class AssetLoader
+{
+public:
+	template<typename T>
+	using DecodeFunc = std::function<bool(T& asset)>;
+
+	template<typename T>
+	using DecodeFileFunc = std::function<bool(std::vector<char>& bytes, T& asset)>;
+
+	// Runs on the thread calling DispatchCompletions; loaded is false if the file could
+	// not be read or the decode failed.
+	template<typename T>
+	using CompletionFunc = std::function<void(T& asset, bool loaded)>;
+
+	// decodeThreadCount <= 0 uses two decode threads.
+	explicit AssetLoader(int decodeThreadCount = 0);
+	AssetLoader(const AssetLoader& rhs) = delete;
+	AssetLoader& operator=(const AssetLoader& rhs) = delete;
+
+	// Requests that have not started decoding are dropped (their handles report
+	// failure) and the ones that have are finished; no callbacks are run.
+	~AssetLoader();
+
+	// decode does its own file access (a mapped file, say) on a decode thread.
+	template<typename T>
+	AssetHandle<T> Load(DecodeFunc<T> decode, CompletionFunc<T> onComplete = nullptr);
+
+	// filename is read on the I/O thread and its bytes handed to decode, which may
+	// move from them.
+	template<typename T>
+	AssetHandle<T> LoadFile(const std::filesystem::path& filename, DecodeFileFunc<T> decode,
+		CompletionFunc<T> onComplete = nullptr);
+
+	// The raw bytes of filename, e.g. a .dds file for CreateDDSTextureFromMemory12.
+	AssetHandle<std::vector<char>> LoadFileBytes(const std::filesystem::path& filename,
+		CompletionFunc<std::vector<char>> onComplete = nullptr);
+
+	// Runs the callbacks of the requests that have finished since the last call, in
+	// the order they finished, and returns how many ran.
+	int DispatchCompletions();
+
+	// Requests whose callbacks have not been dispatched yet.
+	int PendingCount() const { return mPendingCount.load(std::memory_order_acquire); }
+
+	// Blocks until every queued request has been decoded; callbacks still wait for
+	// DispatchCompletions.
+	void WaitIdle();
+
+private:
+	struct Request
+	{
+		std::filesystem::path Filename;
+		std::vector<char> Bytes;
+
+		// Decode and complete close over the typed asset.
+		std::function<bool(std::vector<char>& bytes)> Decode;
+		std::function<void(bool loaded)> Complete;
+
+		std::promise<bool> Done;
+		bool Loaded = false;
+	};
+
+	template<typename T>
+	AssetHandle<T> Submit(std::unique_ptr<Request> request,
+		const std::shared_ptr<T>& asset, CompletionFunc<T> onComplete);
+
+	void Enqueue(std::unique_ptr<Request> request);
+
+	void IoLoop();
+	void DecodeLoop();
+
+	// Sets the request's future and moves it to the completion queue.
+	void Finish(std::unique_ptr<Request> request, bool loaded);
+
+	static bool ReadFile(const std::filesystem::path& filename, std::vector<char>& bytes);
+
+private:
+	std::deque<std::unique_ptr<Request>> mIoQueue;
+	std::deque<std::unique_ptr<Request>> mDecodeQueue;
+	std::deque<std::unique_ptr<Request>> mCompleted;
+
+	// Guards the three queues, mBusyCount and mShutdown.
+	std::mutex mMutex;
+	std::condition_variable mIoWake;
+	std::condition_variable mDecodeWake;
+	std::condition_variable mIdle;
+
+	// Requests taken off a queue and not yet finished.
+	int mBusyCount = 0;
+	bool mShutdown = false;
+
+	std::atomic<int> mPendingCount{ 0 };
+
+	std::thread mIoThread;
+	std::vector<std::thread> mDecodeThreads;
+};
+
+
+template<typename T>
+AssetHandle<T> AssetLoader::Load(DecodeFunc<T> decode, CompletionFunc<T> onComplete)
+{
+	auto asset = std::make_shared<T>();
+
+	auto request = std::make_unique<Request>();
+	request->Decode = [asset, decode](std::vector<char>&)
+		{
+			return decode(*asset);
+		};
+
+	return Submit(std::move(request), asset, std::move(onComplete));
+}
+
+template<typename T>
+AssetHandle<T> AssetLoader::LoadFile(const std::filesystem::path& filename, DecodeFileFunc<T> decode,
+	CompletionFunc<T> onComplete)
+{
+	auto asset = std::make_shared<T>();
+
+	auto request = std::make_unique<Request>();
+	request->Filename = filename;
+	request->Decode = [asset, decode](std::vector<char>& bytes)
+		{
+			return decode(bytes, *asset);
+		};
+
+	return Submit(std::move(request), asset, std::move(onComplete));
+}
+
+template<typename T>
+AssetHandle<T> AssetLoader::Submit(std::unique_ptr<Request> request,
+	const std::shared_ptr<T>& asset, CompletionFunc<T> onComplete)
+{
+	if (onComplete)
+	{
+		request->Complete = [asset, onComplete](bool loaded)
+			{
+				onComplete(*asset, loaded);
+			};
+	}
+
+	AssetHandle<T> handle;
+	handle.mAsset = asset;
+	handle.mDone = request->Done.get_future().share();
+
+	Enqueue(std::move(request));
+	return handle;
+}
@@ -10,7 +10,7 @@
 
 #pragma once
 
-#include "d3dUtil.h"
+#include "MathHelper.h"
 
 class Camera
 {
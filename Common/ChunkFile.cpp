@@ -0,0 +1,133 @@
+//***************************************************************************************
+// ChunkFile.cpp
+//***************************************************************************************
+
+#include "ChunkFile.h"
+
+#include <fstream>
+
+
+namespace
+{
+	const UINT64 ChunkAlignment = 16;
+
+	UINT64 AlignUp(UINT64 offset)
+	{
+		return (offset + ChunkAlignment - 1) & ~(ChunkAlignment - 1);
+	}
+}
+
+void ChunkFileWriter::AddChunk(UINT id, UINT elementSize, const void* data, std::size_t count)
+{
+	Chunk chunk;
+	chunk.Id = id;
+	chunk.ElementSize = elementSize;
+	chunk.Count = count;
+	chunk.Bytes.resize(count * elementSize);
+	if (count > 0)
+		std::memcpy(chunk.Bytes.data(), data, chunk.Bytes.size());
+
+	mChunks.push_back(std::move(chunk));
+}
+
+bool ChunkFileWriter::Save(const std::string& filename, UINT magic, UINT version) const
+{
+	ChunkFileHeader header = {};
+	header.Magic = magic;
+	header.Version = version;
+	header.ChunkCount = (UINT)mChunks.size();
+
+	std::vector<ChunkEntry> entries(mChunks.size());
+	UINT64 offset = AlignUp(sizeof(ChunkFileHeader) + entries.size() * sizeof(ChunkEntry));
+	for (std::size_t i = 0; i < mChunks.size(); ++i)
+	{
+		entries[i].Id = mChunks[i].Id;
+		entries[i].ElementSize = mChunks[i].ElementSize;
+		entries[i].Count = mChunks[i].Count;
+		entries[i].Offset = offset;
+		offset = AlignUp(offset + mChunks[i].Bytes.size());
+	}
+
+	std::ofstream fout(filename, std::ios::binary);
+	if (!fout)
+		return false;
+
+	fout.write((const char*)&header, sizeof(header));
+	fout.write((const char*)entries.data(), entries.size() * sizeof(ChunkEntry));
+
+	const char padding[ChunkAlignment] = {};
+	UINT64 written = sizeof(header) + entries.size() * sizeof(ChunkEntry);
+	for (std::size_t i = 0; i < mChunks.size(); ++i)
+	{
+		fout.write(padding, (std::streamsize)(entries[i].Offset - written));
+		fout.write((const char*)mChunks[i].Bytes.data(), mChunks[i].Bytes.size());
+		written = entries[i].Offset + mChunks[i].Bytes.size();
+	}
+
+	return (bool)fout;
+}
+
+bool ChunkFileReader::Open(const std::string& filename, UINT magic, UINT version)
+{
+	Close();
+
+	if (!mFile.Open(filename))
+		return false;
+
+	const BYTE* data = mFile.Data();
+	const std::size_t size = mFile.Size();
+
+	ChunkFileHeader header;
+	if (size < sizeof(header))
+	{
+		Close();
+		return false;
+	}
+	std::memcpy(&header, data, sizeof(header));
+
+	const UINT64 tableEnd = sizeof(header) + (UINT64)header.ChunkCount * sizeof(ChunkEntry);
+	if (header.Magic != magic || header.Version != version || tableEnd > size)
+	{
+		Close();
+		return false;
+	}
+
+	mEntries = (const ChunkEntry*)(data + sizeof(header));
+	mChunkCount = header.ChunkCount;
+
+	// Everything handed out later is trusted, so check it all once here.
+	for (UINT i = 0; i < mChunkCount; ++i)
+	{
+		const ChunkEntry& entry = mEntries[i];
+		const UINT64 bytes = entry.Count * entry.ElementSize;
+		if (entry.Offset % ChunkAlignment != 0 || entry.Offset > size || bytes > size - entry.Offset)
+		{
+			Close();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void ChunkFileReader::Close()
+{
+	mFile.Close();
+	mEntries = nullptr;
+	mChunkCount = 0;
+}
+
+bool ChunkFileReader::HasChunk(UINT id) const
+{
+	return FindChunk(id) != nullptr;
+}
+
+const ChunkEntry* ChunkFileReader::FindChunk(UINT id) const
+{
+	for (UINT i = 0; i < mChunkCount; ++i)
+	{
+		if (mEntries[i].Id == id)
+			return &mEntries[i];
+	}
+	return nullptr;
+}
@@ -0,0 +1,134 @@
+//***************************************************************************************
+// ChunkFile.h
+//
+// A minimal binary container for preprocessed assets (see Advanced/M3dBinary.h and
+// MeshFile.h).  A file is a header, a table of chunks and the chunk payloads:
+//
+//     ChunkFileHeader   magic, version, chunk count
+//     ChunkEntry[n]     id, element size, element count, byte offset
+//     payloads          each an array of fixed-size records, 16-byte aligned
+//
+// Records are stored exactly as they sit in memory (little-endian, no padding
+// beyond the struct's own), so a reader maps the file and hands out ArrayViews
+// over the payloads without parsing or copying anything.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+
+
+// A read-only view of count consecutive Ts owned by something else (here, a mapping).
+template<typename T>
+class ArrayView
+{
+public:
+	ArrayView() = default;
+	ArrayView(const T* data, std::size_t count) : mData(data), mCount(count) {}
+
+	const T* data() const { return mData; }
+	std::size_t size() const { return mCount; }
+	bool empty() const { return mCount == 0; }
+
+	const T* begin() const { return mData; }
+	const T* end() const { return mData + mCount; }
+	const T& operator[](std::size_t i) const { return mData[i]; }
+
+	// For the few places that still want to own a copy.
+	std::vector<T> ToVector() const { return std::vector<T>(begin(), end()); }
+
+private:
+	const T* mData = nullptr;
+	std::size_t mCount = 0;
+};
+
+
+// Four characters packed into an id, readable in a hex dump: MakeChunkId('I','D','X','3').
+constexpr UINT MakeChunkId(char a, char b, char c, char d)
+{
+	return (UINT)(BYTE)a | ((UINT)(BYTE)b << 8) | ((UINT)(BYTE)c << 16) | ((UINT)(BYTE)d << 24);
+}
+
+struct ChunkFileHeader
+{
+	UINT Magic;
+	UINT Version;
+	UINT ChunkCount;
+	UINT Reserved;
+};
+
+struct ChunkEntry
+{
+	UINT Id;
+	UINT ElementSize;
+	UINT64 Count;
+	UINT64 Offset;
+};
+
+
+class ChunkFileWriter
+{
+public:
+	// Records must be trivially copyable; they are written byte for byte.
+	template<typename T>
+	void AddChunk(UINT id, const T* data, std::size_t count)
+	{
+		AddChunk(id, sizeof(T), data, count);
+	}
+
+	template<typename T>
+	void AddChunk(UINT id, const std::vector<T>& data)
+	{
+		AddChunk(id, sizeof(T), data.data(), data.size());
+	}
+
+	bool Save(const std::string& filename, UINT magic, UINT version) const;
+
+private:
+	void AddChunk(UINT id, UINT elementSize, const void* data, std::size_t count);
+
+	struct Chunk
+	{
+		UINT Id;
+		UINT ElementSize;
+		UINT64 Count;
+		std::vector<BYTE> Bytes;
+	};
+	std::vector<Chunk> mChunks;
+};
+
+
+class ChunkFileReader
+{
+public:
+	// Maps filename and checks its header and chunk table; false if the file is
+	// missing, truncated, or has another magic or version.
+	bool Open(const std::string& filename, UINT magic, UINT version);
+	void Close();
+
+	bool HasChunk(UINT id) const;
+
+	// The records of chunk id, valid while the reader stays open.  Empty if there is
+	// no such chunk or its records are not sizeof(T) bytes.
+	template<typename T>
+	ArrayView<T> Chunk(UINT id) const
+	{
+		const ChunkEntry* entry = FindChunk(id);
+		if (entry == nullptr || entry->ElementSize != sizeof(T))
+			return ArrayView<T>();
+
+		return ArrayView<T>((const T*)(mFile.Data() + entry->Offset), (std::size_t)entry->Count);
+	}
+
+private:
+	const ChunkEntry* FindChunk(UINT id) const;
+
+	MappedFile mFile;
+	const ChunkEntry* mEntries = nullptr;
+	UINT mChunkCount = 0;
+};
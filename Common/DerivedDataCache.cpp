@@ -0,0 +1,251 @@
+//***************************************************************************************
+// DerivedDataCache.cpp
+//***************************************************************************************
+
+#include "DerivedDataCache.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <system_error>
+#include <thread>
+
+
+namespace
+{
+	const UINT KeyChunk = MakeChunkId('K', 'E', 'Y', ' ');
+	const UINT MeshInfoChunk = MakeChunkId('M', 'I', 'N', 'F');
+	const UINT VertexChunk = MakeChunkId('V', 'E', 'R', 'T');
+	const UINT IndexChunk = MakeChunkId('I', 'N', 'D', 'X');
+	const UINT SubmeshChunk = MakeChunkId('S', 'U', 'B', 'M');
+	const UINT StringChunk = MakeChunkId('S', 'T', 'R', 'S');
+
+	struct MeshInfo
+	{
+		UINT VertexStride;
+		UINT IndexStride;
+	};
+
+	struct SubmeshRecord
+	{
+		DerivedSubmesh Submesh;
+		UINT Name;	// offset into the string chunk
+	};
+
+	// The 64-bit finalizer of MurmurHash3.  The keys only need to tell inputs apart,
+	// not to resist anyone crafting collisions.
+	inline UINT64 Mix(UINT64 h)
+	{
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdull;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ull;
+		h ^= h >> 33;
+		return h;
+	}
+
+	// The xxHash64 round.  Bulk data goes through four of these in parallel, since a
+	// single chain of Mix calls is latency bound and took ~2 ms over skull.txt.
+	inline UINT64 Round(UINT64 lane, UINT64 word)
+	{
+		lane += word * 0xc2b2ae3d27d4eb4full;
+		lane = (lane << 31) | (lane >> 33);
+		return lane * 0x9e3779b185ebca87ull;
+	}
+}
+
+DerivedDataKey::DerivedDataKey(const std::string& step, UINT version) :
+	mHash(0x9e3779b97f4a7c15ull)
+{
+	Add(step);
+	AddValue(version);
+}
+
+DerivedDataKey& DerivedDataKey::Add(const void* data, std::size_t size)
+{
+	// The size goes in first so that "ab" + "c" and "a" + "bc" differ.
+	mHash = Mix(mHash ^ size);
+
+	const BYTE* bytes = (const BYTE*)data;
+	std::size_t i = 0;
+
+	if (size >= 32)
+	{
+		UINT64 lanes[4] = { mHash + 1, mHash + 2, mHash + 3, mHash + 4 };
+		for (; i + 32 <= size; i += 32)
+		{
+			UINT64 words[4];
+			std::memcpy(words, bytes + i, 32);
+			for (int lane = 0; lane < 4; ++lane)
+				lanes[lane] = Round(lanes[lane], words[lane]);
+		}
+
+		for (int lane = 0; lane < 4; ++lane)
+			mHash = Mix(mHash ^ lanes[lane]);
+	}
+
+	for (; i + 8 <= size; i += 8)
+	{
+		UINT64 word;
+		std::memcpy(&word, bytes + i, 8);
+		mHash = Mix(mHash ^ word);
+	}
+
+	if (i < size)
+	{
+		UINT64 word = 0;
+		std::memcpy(&word, bytes + i, size - i);
+		mHash = Mix(mHash ^ word);
+	}
+
+	return *this;
+}
+
+DerivedDataKey& DerivedDataKey::Add(const std::string& s)
+{
+	return Add(s.data(), s.size());
+}
+
+bool DerivedDataKey::AddFile(const std::string& filename)
+{
+	MappedFile file;
+	if (!file.Open(filename))
+		return false;
+
+	Add(file.Data(), file.Size());
+	return true;
+}
+
+std::string DerivedDataKey::ToString() const
+{
+	const char digits[] = "0123456789abcdef";
+
+	std::string s(16, '0');
+	for (int i = 0; i < 16; ++i)
+		s[15 - i] = digits[(mHash >> (4 * i)) & 0xf];
+	return s;
+}
+
+DerivedDataCache::DerivedDataCache(const std::string& directory) :
+	mDirectory(directory)
+{
+}
+
+std::string DerivedDataCache::EntryPath(const DerivedDataKey& key) const
+{
+	return (std::filesystem::path(mDirectory) / (key.ToString() + ".ddc")).string();
+}
+
+bool DerivedDataCache::Open(const DerivedDataKey& key, ChunkFileReader& entry) const
+{
+	if (!entry.Open(EntryPath(key), Magic, Version))
+		return false;
+
+	// The file name is the key; the stored copy catches a renamed or mixed-up file.
+	ArrayView<UINT64> storedKey = entry.Chunk<UINT64>(KeyChunk);
+	if (storedKey.size() != 1 || storedKey[0] != key.Value())
+	{
+		entry.Close();
+		return false;
+	}
+	return true;
+}
+
+bool DerivedDataCache::Store(const DerivedDataKey& key, ChunkFileWriter& entry) const
+{
+	const UINT64 keyValue = key.Value();
+	entry.AddChunk(KeyChunk, &keyValue, 1);
+
+	std::error_code error;
+	std::filesystem::create_directories(mDirectory, error);
+
+	const std::string path = EntryPath(key);
+	const std::string tempPath = path + "." +
+		std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()) ^
+			(std::size_t)std::chrono::steady_clock::now().time_since_epoch().count()) + ".tmp";
+
+	if (!entry.Save(tempPath, Magic, Version))
+	{
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+
+	std::filesystem::rename(tempPath, path, error);
+	if (error)
+	{
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	return true;
+}
+
+bool DerivedDataCache::LoadMesh(const DerivedDataKey& key, DerivedMesh& mesh) const
+{
+	ChunkFileReader entry;
+	if (!Open(key, entry))
+		return false;
+
+	ArrayView<MeshInfo> info = entry.Chunk<MeshInfo>(MeshInfoChunk);
+	ArrayView<BYTE> vertices = entry.Chunk<BYTE>(VertexChunk);
+	ArrayView<BYTE> indices = entry.Chunk<BYTE>(IndexChunk);
+	ArrayView<SubmeshRecord> submeshes = entry.Chunk<SubmeshRecord>(SubmeshChunk);
+	ArrayView<char> strings = entry.Chunk<char>(StringChunk);
+
+	if (info.size() != 1 || strings.empty() || strings[strings.size() - 1] != '\0')
+		return false;
+
+	const MeshInfo& meshInfo = info[0];
+	if (meshInfo.VertexStride == 0 || vertices.size() % meshInfo.VertexStride != 0 ||
+		(meshInfo.IndexStride != 2 && meshInfo.IndexStride != 4) || indices.size() % meshInfo.IndexStride != 0)
+	{
+		return false;
+	}
+
+	const UINT64 indexCount = indices.size() / meshInfo.IndexStride;
+	for (const SubmeshRecord& record : submeshes)
+	{
+		if (record.Name >= strings.size() ||
+			(UINT64)record.Submesh.StartIndexLocation + record.Submesh.IndexCount > indexCount)
+		{
+			return false;
+		}
+	}
+
+	mesh.VertexStride = meshInfo.VertexStride;
+	mesh.IndexStride = meshInfo.IndexStride;
+	mesh.VertexData = vertices.ToVector();
+	mesh.IndexData = indices.ToVector();
+
+	mesh.SubmeshNames.clear();
+	mesh.Submeshes.clear();
+	for (const SubmeshRecord& record : submeshes)
+		mesh.AddSubmesh(strings.data() + record.Name, record.Submesh);
+
+	return true;
+}
+
+bool DerivedDataCache::StoreMesh(const DerivedDataKey& key, const DerivedMesh& mesh) const
+{
+	MeshInfo info = { mesh.VertexStride, mesh.IndexStride };
+
+	std::vector<char> strings;
+	std::vector<SubmeshRecord> submeshes(mesh.Submeshes.size());
+	for (std::size_t i = 0; i < mesh.Submeshes.size(); ++i)
+	{
+		submeshes[i].Submesh = mesh.Submeshes[i];
+		submeshes[i].Name = (UINT)strings.size();
+		strings.insert(strings.end(), mesh.SubmeshNames[i].begin(), mesh.SubmeshNames[i].end());
+		strings.push_back('\0');
+	}
+	strings.push_back('\0');
+
+	ChunkFileWriter entry;
+	entry.AddChunk(MeshInfoChunk, &info, 1);
+	entry.AddChunk(VertexChunk, mesh.VertexData);
+	entry.AddChunk(IndexChunk, mesh.IndexData);
+	entry.AddChunk(SubmeshChunk, submeshes);
+	entry.AddChunk(StringChunk, strings);
+
+	return Store(key, entry);
+}
@@ -0,0 +1,124 @@
+//***************************************************************************************
+// DerivedDataCache.h
+//
+// On-disk cache for data the apps derive at startup (generated shapes, parsed models,
+// their bounds and index conversions), so a warm start maps the finished vertex and
+// index blobs instead of rebuilding them.
+//
+// Entries are addressed by a DerivedDataKey: a hash of everything the data is derived
+// from (the bytes of a source file, generator parameters, the vertex size) seeded
+// with the name and version of the processing step.  Changing any input gives a new
+// key, so entries never need invalidating; bump the step's version when the code that
+// derives the data changes.
+//
+// An entry is a ChunkFile named after its key.  A missing, damaged or foreign entry
+// is a miss, and the caller rebuilds the data and stores it again.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <DirectXCollision.h>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "ChunkFile.h"
+
+
+class DerivedDataKey
+{
+public:
+	DerivedDataKey(const std::string& step, UINT version);
+
+	DerivedDataKey& Add(const void* data, std::size_t size);
+	DerivedDataKey& Add(const std::string& s);
+
+	// For parameters: numbers, or structs of them without padding.
+	template<typename T>
+	DerivedDataKey& AddValue(const T& value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "hashed byte for byte");
+		return Add(&value, sizeof(T));
+	}
+
+	// Hashes the contents of filename; false if it cannot be read.
+	bool AddFile(const std::string& filename);
+
+	UINT64 Value() const { return mHash; }
+
+	// Sixteen hex digits, as used for the entry's file name.
+	std::string ToString() const;
+
+private:
+	UINT64 mHash;
+};
+
+
+struct DerivedSubmesh
+{
+	UINT IndexCount = 0;
+	UINT StartIndexLocation = 0;
+	int BaseVertexLocation = 0;
+	DirectX::BoundingBox Bounds;
+};
+
+// Geometry as it goes into a MeshGeometry: vertices already in the app's layout,
+// 16- or 32-bit indices and the named draw ranges (see d3dUtil::CreateMeshGeometry).
+struct DerivedMesh
+{
+	UINT VertexStride = 0;
+	UINT IndexStride = 0;
+	std::vector<BYTE> VertexData;
+	std::vector<BYTE> IndexData;
+
+	std::vector<std::string> SubmeshNames;
+	std::vector<DerivedSubmesh> Submeshes;
+
+	template<typename V>
+	void SetVertices(const std::vector<V>& vertices)
+	{
+		VertexStride = sizeof(V);
+		VertexData.assign((const BYTE*)vertices.data(), (const BYTE*)(vertices.data() + vertices.size()));
+	}
+
+	template<typename I>
+	void SetIndices(const std::vector<I>& indices)
+	{
+		static_assert(sizeof(I) == 2 || sizeof(I) == 4, "16- or 32-bit indices");
+		IndexStride = sizeof(I);
+		IndexData.assign((const BYTE*)indices.data(), (const BYTE*)(indices.data() + indices.size()));
+	}
+
+	void AddSubmesh(const std::string& name, const DerivedSubmesh& submesh)
+	{
+		SubmeshNames.push_back(name);
+		Submeshes.push_back(submesh);
+	}
+};
+
+
+class DerivedDataCache
+{
+public:
+	static const UINT Magic = MakeChunkId('D', 'D', 'C', 'E');
+	static const UINT Version = 1;
+
+	// The directory is created by the first Store.
+	explicit DerivedDataCache(const std::string& directory);
+
+	std::string EntryPath(const DerivedDataKey& key) const;
+
+	// Opens the entry stored under key; false on a miss.
+	bool Open(const DerivedDataKey& key, ChunkFileReader& entry) const;
+
+	// Writes to a temporary file and renames it into place, so a reader never sees a
+	// partial entry and two processes storing the same key do not interfere.
+	bool Store(const DerivedDataKey& key, ChunkFileWriter& entry) const;
+
+	bool LoadMesh(const DerivedDataKey& key, DerivedMesh& mesh) const;
+	bool StoreMesh(const DerivedDataKey& key, const DerivedMesh& mesh) const;
+
+private:
+	std::string mDirectory;
+};
@@ -0,0 +1,311 @@
+//***************************************************************************************
+// DynamicAabbTree.cpp
+//***************************************************************************************
+
+#include "DynamicAabbTree.h"
+
+#include <algorithm>
+
+using namespace DirectX;
+
+
+namespace
+{
+	XMFLOAT3 Min3(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(std::min<float>(a.x, b.x), std::min<float>(a.y, b.y), std::min<float>(a.z, b.z));
+	}
+
+	XMFLOAT3 Max3(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(std::max<float>(a.x, b.x), std::max<float>(a.y, b.y), std::max<float>(a.z, b.z));
+	}
+
+	float SurfaceArea(const XMFLOAT3& min, const XMFLOAT3& max)
+	{
+		float dx = max.x - min.x;
+		float dy = max.y - min.y;
+		float dz = max.z - min.z;
+		return 2.0f * (dx * dy + dy * dz + dz * dx);
+	}
+
+	bool Contains(const XMFLOAT3& outerMin, const XMFLOAT3& outerMax,
+		const XMFLOAT3& innerMin, const XMFLOAT3& innerMax)
+	{
+		return outerMin.x <= innerMin.x && outerMin.y <= innerMin.y && outerMin.z <= innerMin.z &&
+			innerMax.x <= outerMax.x && innerMax.y <= outerMax.y && innerMax.z <= outerMax.z;
+	}
+}
+
+DynamicAabbTree::DynamicAabbTree(float margin) :
+	mMargin(margin)
+{
+}
+
+int DynamicAabbTree::CreateProxy(const BoundingBox& box, UINT userData)
+{
+	const int proxy = AllocateNode();
+
+	Node& leaf = mNodes[proxy];
+	leaf.Min = XMFLOAT3(box.Center.x - box.Extents.x - mMargin,
+		box.Center.y - box.Extents.y - mMargin, box.Center.z - box.Extents.z - mMargin);
+	leaf.Max = XMFLOAT3(box.Center.x + box.Extents.x + mMargin,
+		box.Center.y + box.Extents.y + mMargin, box.Center.z + box.Extents.z + mMargin);
+	leaf.Height = 0;
+	leaf.UserData = userData;
+
+	InsertLeaf(proxy);
+	++mProxyCount;
+	return proxy;
+}
+
+void DynamicAabbTree::DestroyProxy(int proxy)
+{
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+	--mProxyCount;
+}
+
+bool DynamicAabbTree::MoveProxy(int proxy, const BoundingBox& box)
+{
+	const XMFLOAT3 boxMin(box.Center.x - box.Extents.x, box.Center.y - box.Extents.y, box.Center.z - box.Extents.z);
+	const XMFLOAT3 boxMax(box.Center.x + box.Extents.x, box.Center.y + box.Extents.y, box.Center.z + box.Extents.z);
+
+	if (Contains(mNodes[proxy].Min, mNodes[proxy].Max, boxMin, boxMax))
+		return false;
+
+	RemoveLeaf(proxy);
+
+	Node& leaf = mNodes[proxy];
+	leaf.Min = XMFLOAT3(boxMin.x - mMargin, boxMin.y - mMargin, boxMin.z - mMargin);
+	leaf.Max = XMFLOAT3(boxMax.x + mMargin, boxMax.y + mMargin, boxMax.z + mMargin);
+
+	InsertLeaf(proxy);
+	return true;
+}
+
+BoundingBox DynamicAabbTree::GetFatBox(int proxy) const
+{
+	const Node& leaf = mNodes[proxy];
+	return BoundingBox(
+		XMFLOAT3(0.5f * (leaf.Min.x + leaf.Max.x), 0.5f * (leaf.Min.y + leaf.Max.y), 0.5f * (leaf.Min.z + leaf.Max.z)),
+		XMFLOAT3(0.5f * (leaf.Max.x - leaf.Min.x), 0.5f * (leaf.Max.y - leaf.Min.y), 0.5f * (leaf.Max.z - leaf.Min.z)));
+}
+
+void DynamicAabbTree::Clear()
+{
+	mNodes.clear();
+	mRoot = NullNode;
+	mFreeList = NullNode;
+	mProxyCount = 0;
+}
+
+int DynamicAabbTree::AllocateNode()
+{
+	int node = mFreeList;
+	if (node != NullNode)
+	{
+		mFreeList = mNodes[node].Parent;
+	}
+	else
+	{
+		node = (int)mNodes.size();
+		mNodes.emplace_back();
+	}
+
+	Node& n = mNodes[node];
+	n.Parent = NullNode;
+	n.Child1 = NullNode;
+	n.Child2 = NullNode;
+	n.Height = 0;
+	n.UserData = 0;
+	return node;
+}
+
+void DynamicAabbTree::FreeNode(int node)
+{
+	mNodes[node].Parent = mFreeList;
+	mNodes[node].Height = -1;
+	mFreeList = node;
+}
+
+void DynamicAabbTree::SetUnion(int node, int a, int b)
+{
+	mNodes[node].Min = Min3(mNodes[a].Min, mNodes[b].Min);
+	mNodes[node].Max = Max3(mNodes[a].Max, mNodes[b].Max);
+}
+
+void DynamicAabbTree::InsertLeaf(int leaf)
+{
+	if (mRoot == NullNode)
+	{
+		mRoot = leaf;
+		mNodes[leaf].Parent = NullNode;
+		return;
+	}
+
+	const XMFLOAT3 leafMin = mNodes[leaf].Min;
+	const XMFLOAT3 leafMax = mNodes[leaf].Max;
+
+	// Descend to the sibling for which the tree's total surface area grows least.  Every
+	// node on the way down grows to enclose the leaf, which is charged to both children.
+	int index = mRoot;
+	while (!mNodes[index].IsLeaf())
+	{
+		const Node& node = mNodes[index];
+
+		const float area = SurfaceArea(node.Min, node.Max);
+		const float combinedArea = SurfaceArea(Min3(node.Min, leafMin), Max3(node.Max, leafMax));
+
+		// Pairing the leaf with this node as a whole.
+		const float cost = 2.0f * combinedArea;
+
+		// Descending further still grows this node.
+		const float inheritanceCost = 2.0f * (combinedArea - area);
+
+		float childCost[2];
+		const int children[2] = { node.Child1, node.Child2 };
+		for (int c = 0; c < 2; ++c)
+		{
+			const Node& child = mNodes[children[c]];
+			float grownArea = SurfaceArea(Min3(child.Min, leafMin), Max3(child.Max, leafMax));
+			childCost[c] = (child.IsLeaf() ? grownArea : grownArea - SurfaceArea(child.Min, child.Max)) +
+				inheritanceCost;
+		}
+
+		if (cost < childCost[0] && cost < childCost[1])
+			break;
+
+		index = childCost[0] < childCost[1] ? children[0] : children[1];
+	}
+
+	const int sibling = index;
+
+	// A new parent takes the sibling's place, with the sibling and the leaf below it.
+	const int oldParent = mNodes[sibling].Parent;
+	const int newParent = AllocateNode();
+
+	mNodes[newParent].Parent = oldParent;
+	mNodes[newParent].Child1 = sibling;
+	mNodes[newParent].Child2 = leaf;
+	mNodes[newParent].Height = mNodes[sibling].Height + 1;
+	SetUnion(newParent, sibling, leaf);
+
+	if (oldParent != NullNode)
+	{
+		if (mNodes[oldParent].Child1 == sibling)
+			mNodes[oldParent].Child1 = newParent;
+		else
+			mNodes[oldParent].Child2 = newParent;
+	}
+	else
+	{
+		mRoot = newParent;
+	}
+
+	mNodes[sibling].Parent = newParent;
+	mNodes[leaf].Parent = newParent;
+
+	FixUpwards(oldParent);
+}
+
+void DynamicAabbTree::RemoveLeaf(int leaf)
+{
+	if (leaf == mRoot)
+	{
+		mRoot = NullNode;
+		return;
+	}
+
+	// The leaf's sibling takes their parent's place.
+	const int parent = mNodes[leaf].Parent;
+	const int grandParent = mNodes[parent].Parent;
+	const int sibling = mNodes[parent].Child1 == leaf ? mNodes[parent].Child2 : mNodes[parent].Child1;
+
+	mNodes[sibling].Parent = grandParent;
+	if (grandParent != NullNode)
+	{
+		if (mNodes[grandParent].Child1 == parent)
+			mNodes[grandParent].Child1 = sibling;
+		else
+			mNodes[grandParent].Child2 = sibling;
+	}
+	else
+	{
+		mRoot = sibling;
+	}
+
+	FreeNode(parent);
+	mNodes[leaf].Parent = NullNode;
+
+	FixUpwards(grandParent);
+}
+
+void DynamicAabbTree::FixUpwards(int node)
+{
+	while (node != NullNode)
+	{
+		node = Balance(node);
+
+		Node& n = mNodes[node];
+		n.Height = 1 + std::max<int>(mNodes[n.Child1].Height, mNodes[n.Child2].Height);
+		SetUnion(node, n.Child1, n.Child2);
+
+		node = n.Parent;
+	}
+}
+
+int DynamicAabbTree::Balance(int a)
+{
+	Node& A = mNodes[a];
+	if (A.IsLeaf() || A.Height < 2)
+		return a;
+
+	const int b = A.Child1;
+	const int c = A.Child2;
+	const int balance = mNodes[c].Height - mNodes[b].Height;
+
+	if (balance >= -1 && balance <= 1)
+		return a;
+
+	// The taller child becomes the subtree's root, with A as one of its children.  The
+	// promoted node keeps the taller of its own children and hands the shorter to A,
+	// which keeps its other child.
+	const int up = balance > 1 ? c : b;
+	const int stay = balance > 1 ? b : c;
+
+	Node& U = mNodes[up];
+	const int f = U.Child1;
+	const int g = U.Child2;
+	const int taller = mNodes[f].Height > mNodes[g].Height ? f : g;
+	const int shorter = taller == f ? g : f;
+
+	U.Child1 = a;
+	U.Parent = A.Parent;
+	A.Parent = up;
+
+	if (U.Parent != NullNode)
+	{
+		if (mNodes[U.Parent].Child1 == a)
+			mNodes[U.Parent].Child1 = up;
+		else
+			mNodes[U.Parent].Child2 = up;
+	}
+	else
+	{
+		mRoot = up;
+	}
+
+	U.Child2 = taller;
+	A.Child1 = stay;
+	A.Child2 = shorter;
+	mNodes[shorter].Parent = a;
+
+	SetUnion(a, stay, shorter);
+	A.Height = 1 + std::max<int>(mNodes[stay].Height, mNodes[shorter].Height);
+
+	SetUnion(up, a, taller);
+	U.Height = 1 + std::max<int>(A.Height, mNodes[taller].Height);
+
+	return up;
+}
@@ -0,0 +1,169 @@
+//***************************************************************************************
+// DynamicAabbTree.h
+//
+// A bounding volume hierarchy of axis-aligned boxes that objects can be added to,
+// moved in and removed from at any time, after the dynamic tree of Erin Catto's Box2D.
+// Each object is a leaf holding its world-space box enlarged by a margin.  Moving an
+// object only touches the tree once its new box leaves that fat box; the leaf is then
+// taken out and inserted again.  Insertion descends toward the sibling whose box grows
+// the least in surface area, and rotations on the way back up keep the tree balanced.
+//
+// QueryFrustum walks down from the root.  A subtree is dropped as soon as its box is
+// behind one of the frustum planes, a plane the box is wholly in front of is not tested
+// again below it, and a subtree inside every plane is accepted without further tests,
+// so a query costs in proportion to what is visible rather than to the object count.
+//***************************************************************************************
+
+#pragma once
+
+#include <cmath>
+#include <DirectXCollision.h>
+#include <DirectXMath.h>
+#include <utility>
+#include <vector>
+
+#include "FrustumCulling.h"
+#include "Platform.h"
+
+
+class DynamicAabbTree
+{
+public:
+	static const int NullNode = -1;
+
+	// Each leaf's box is enlarged by margin (in world units) on every side.
+	explicit DynamicAabbTree(float margin = 0.1f);
+
+	// Adds an object with the world-space bounds box and returns its proxy, which
+	// stays valid until DestroyProxy.  userData is handed back by the queries.
+	int CreateProxy(const DirectX::BoundingBox& box, UINT userData);
+	void DestroyProxy(int proxy);
+
+	// Gives an object new world-space bounds, for example after its World changed.
+	// Returns true if its leaf had to be reinserted.
+	bool MoveProxy(int proxy, const DirectX::BoundingBox& box);
+
+	UINT GetUserData(int proxy) const { return mNodes[proxy].UserData; }
+
+	// The enlarged box the proxy's leaf holds.
+	DirectX::BoundingBox GetFatBox(int proxy) const;
+
+	int ProxyCount() const { return mProxyCount; }
+
+	// 0 for an empty tree or a single leaf.
+	int Height() const { return mRoot == NullNode ? 0 : mNodes[mRoot].Height; }
+
+	void Clear();
+
+	// Calls visible(userData) for every object whose fat box is not wholly behind one
+	// of the frustum planes (the same test as CullBounds), and returns how many there
+	// were.  The objects come in tree order.
+	template<typename F>
+	UINT QueryFrustum(const FrustumPlanes& frustum, F&& visible) const;
+
+private:
+	struct Node
+	{
+		DirectX::XMFLOAT3 Min;
+		DirectX::XMFLOAT3 Max;
+
+		int Parent;		// the next free node, while on the free list
+		int Child1;
+		int Child2;
+		int Height;		// 0 for a leaf, -1 for a free node
+		UINT UserData;
+
+		bool IsLeaf() const { return Child1 == NullNode; }
+	};
+
+	int AllocateNode();
+	void FreeNode(int node);
+
+	void InsertLeaf(int leaf);
+	void RemoveLeaf(int leaf);
+
+	// Refits and rebalances the ancestors from node up to the root.
+	void FixUpwards(int node);
+
+	// Rotates node's taller child up if the children's heights differ by more than
+	// one; returns the subtree's new root.
+	int Balance(int node);
+
+	void SetUnion(int node, int a, int b);
+
+private:
+	std::vector<Node> mNodes;
+	int mRoot = NullNode;
+	int mFreeList = NullNode;
+	int mProxyCount = 0;
+
+	float mMargin;
+};
+
+
+template<typename F>
+UINT DynamicAabbTree::QueryFrustum(const FrustumPlanes& frustum, F&& visible) const
+{
+	if (mRoot == NullNode)
+		return 0;
+
+	// Each entry is a node and the planes its box may still cross; an empty set means
+	// the whole subtree is inside.
+	std::vector<std::pair<int, int>> stack;
+	stack.reserve(64);
+	stack.emplace_back(mRoot, 0x3f);
+
+	UINT visibleCount = 0;
+	while (!stack.empty())
+	{
+		const int index = stack.back().first;
+		int planes = stack.back().second;
+		stack.pop_back();
+
+		const Node& node = mNodes[index];
+
+		bool outside = false;
+		for (int p = 0; p < 6; ++p)
+		{
+			if ((planes & (1 << p)) == 0)
+				continue;
+
+			const DirectX::XMFLOAT4& plane = frustum.Planes[p];
+
+			// The box's centre distance from the plane and its extent along the normal.
+			const float dist =
+				plane.x * 0.5f * (node.Min.x + node.Max.x) +
+				plane.y * 0.5f * (node.Min.y + node.Max.y) +
+				plane.z * 0.5f * (node.Min.z + node.Max.z) + plane.w;
+			const float radius =
+				std::fabs(plane.x) * 0.5f * (node.Max.x - node.Min.x) +
+				std::fabs(plane.y) * 0.5f * (node.Max.y - node.Min.y) +
+				std::fabs(plane.z) * 0.5f * (node.Max.z - node.Min.z);
+
+			if (dist + radius < 0.0f)
+			{
+				outside = true;
+				break;
+			}
+
+			if (dist - radius >= 0.0f)
+				planes &= ~(1 << p);
+		}
+
+		if (outside)
+			continue;
+
+		if (node.IsLeaf())
+		{
+			visible(node.UserData);
+			++visibleCount;
+		}
+		else
+		{
+			stack.emplace_back(node.Child2, planes);
+			stack.emplace_back(node.Child1, planes);
+		}
+	}
+
+	return visibleCount;
+}
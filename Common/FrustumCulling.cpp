@@ -0,0 +1,107 @@
+//***************************************************************************************
+// FrustumCulling.cpp
+//***************************************************************************************
+
+#include "FrustumCulling.h"
+
+#include <cmath>
+
+using namespace DirectX;
+
+
+void ExtractFrustumPlanes(FrustumPlanes& out, FXMMATRIX viewProj)
+{
+	// A point p is inside when its clip-space position c = p * viewProj has
+	// -w <= x <= w, -w <= y <= w and 0 <= z <= w.  Each bound is a plane dotted with
+	// (p, 1), built from the matrix's columns (Gribb and Hartmann).
+	XMFLOAT4X4 m;
+	XMStoreFloat4x4(&m, viewProj);
+
+	float planes[6][4];
+	for (int r = 0; r < 4; ++r)
+	{
+		planes[0][r] = m.m[r][3] + m.m[r][0];	// -w <= x
+		planes[1][r] = m.m[r][3] - m.m[r][0];	//  x <= w
+		planes[2][r] = m.m[r][3] + m.m[r][1];	// -w <= y
+		planes[3][r] = m.m[r][3] - m.m[r][1];	//  y <= w
+		planes[4][r] = m.m[r][2];				//  0 <= z
+		planes[5][r] = m.m[r][3] - m.m[r][2];	//  z <= w
+	}
+
+	for (int p = 0; p < 6; ++p)
+	{
+		const float* plane = planes[p];
+		float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+		float invLength = length > 0.0f ? 1.0f / length : 0.0f;
+
+		out.Planes[p] = XMFLOAT4(plane[0] * invLength, plane[1] * invLength,
+			plane[2] * invLength, plane[3] * invLength);
+	}
+}
+
+void CullingBounds::Clear()
+{
+	mCount = 0;
+	mCenterX.clear();
+	mCenterY.clear();
+	mCenterZ.clear();
+	mExtentX.clear();
+	mExtentY.clear();
+	mExtentZ.clear();
+}
+
+void CullingBounds::Reserve(std::size_t count)
+{
+	for (std::vector<float>* a : { &mCenterX, &mCenterY, &mCenterZ, &mExtentX, &mExtentY, &mExtentZ })
+		a->reserve(count + LaneWidth - 1);
+}
+
+UINT CullingBounds::Add(const BoundingBox& local, FXMMATRIX world)
+{
+	const UINT index = (UINT)mCount++;
+
+	// The arrays keep LaneWidth - 1 zeroed floats past the last box.
+	for (std::vector<float>* a : { &mCenterX, &mCenterY, &mCenterZ, &mExtentX, &mExtentY, &mExtentZ })
+		a->resize(mCount + LaneWidth - 1, 0.0f);
+
+	Set(index, local, world);
+	return index;
+}
+
+void CullingBounds::Set(UINT index, const BoundingBox& local, FXMMATRIX world)
+{
+	XMFLOAT4X4 m;
+	XMStoreFloat4x4(&m, world);
+
+	// Arvo's transformed box: the centre moves with the matrix, and each world extent
+	// is the local extents weighted by the absolute values of the matrix's column.
+	const float c[3] = { local.Center.x, local.Center.y, local.Center.z };
+	const float e[3] = { local.Extents.x, local.Extents.y, local.Extents.z };
+
+	float center[3];
+	float extent[3];
+	for (int j = 0; j < 3; ++j)
+	{
+		center[j] = m.m[3][j];
+		extent[j] = 0.0f;
+		for (int i = 0; i < 3; ++i)
+		{
+			center[j] += c[i] * m.m[i][j];
+			extent[j] += e[i] * std::fabs(m.m[i][j]);
+		}
+	}
+
+	mCenterX[index] = center[0];
+	mCenterY[index] = center[1];
+	mCenterZ[index] = center[2];
+	mExtentX[index] = extent[0];
+	mExtentY[index] = extent[1];
+	mExtentZ[index] = extent[2];
+}
+
+BoundingBox CullingBounds::Get(UINT index) const
+{
+	return BoundingBox(
+		XMFLOAT3(mCenterX[index], mCenterY[index], mCenterZ[index]),
+		XMFLOAT3(mExtentX[index], mExtentY[index], mExtentZ[index]));
+}
@@ -0,0 +1,236 @@
+//***************************************************************************************
+// FrustumCulling.h
+//
+// Frustum culling for large numbers of instances.  The bounds are moved to world space
+// once, when an instance is placed, and kept as structure-of-arrays boxes (centre and
+// extent per axis), so a frame needs no per-instance matrix work: LaneWidth boxes at a
+// time (8 with AVX2) are tested against the six planes of the camera's view-projection
+// matrix, and the visible ones are handed to a callback, usually to be written straight
+// into the instance buffer.
+//
+// The test is conservative.  A box is culled only if it lies wholly behind one plane,
+// so a box just outside a corner of the frustum can be kept, and the world-space box
+// of a rotated instance is looser than its transformed local box.  Neither ever drops
+// a visible instance.
+//
+// ParallelCullBounds spreads the same test over the task scheduler for instance counts
+// where writing the survivors, rather than testing them, is most of the frame's work.
+// ParallelCullRanges does the same for only some runs of the boxes, the ones a coarser
+// structure (a DynamicAabbTree over groups of consecutive boxes) did not drop whole.
+//***************************************************************************************
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <DirectXCollision.h>
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Platform.h"
+#include "SimdLane.h"
+#include "ThreadPool.h"
+
+
+struct FrustumPlanes
+{
+	// (a, b, c, d), unit normal pointing inwards: a*x + b*y + c*z + d >= 0 inside.
+	// Left, right, bottom, top, near, far.
+	DirectX::XMFLOAT4 Planes[6];
+};
+
+// The planes of the view volume of viewProj, in the space it transforms from (world
+// space for view * proj).  Expects a D3D projection, with depth from 0 to w.
+void ExtractFrustumPlanes(FrustumPlanes& out, DirectX::FXMMATRIX viewProj);
+
+class CullingBounds
+{
+public:
+	std::size_t Size() const { return mCount; }
+
+	void Clear();
+	void Reserve(std::size_t count);
+
+	// Appends the world-space box enclosing local (the mesh's bounds) under world and
+	// returns its index.
+	UINT Add(const DirectX::BoundingBox& local, DirectX::FXMMATRIX world);
+
+	// Replaces a box, for an instance that moved.
+	void Set(UINT index, const DirectX::BoundingBox& local, DirectX::FXMMATRIX world);
+
+	DirectX::BoundingBox Get(UINT index) const;
+
+	// Each array can be read a whole lane past any index below Size().
+	const float* CenterX() const { return mCenterX.data(); }
+	const float* CenterY() const { return mCenterY.data(); }
+	const float* CenterZ() const { return mCenterZ.data(); }
+	const float* ExtentX() const { return mExtentX.data(); }
+	const float* ExtentY() const { return mExtentY.data(); }
+	const float* ExtentZ() const { return mExtentZ.data(); }
+
+private:
+	std::size_t mCount = 0;
+
+	std::vector<float> mCenterX;
+	std::vector<float> mCenterY;
+	std::vector<float> mCenterZ;
+	std::vector<float> mExtentX;
+	std::vector<float> mExtentY;
+	std::vector<float> mExtentZ;
+};
+
+// Calls visible(i) for every box i in [first, last) that is not wholly outside frustum,
+// in increasing order, and returns how many there were.
+template<typename F>
+UINT CullBounds(const FrustumPlanes& frustum, const CullingBounds& bounds, UINT first, UINT last, F&& visible)
+{
+	Lane nx[6], ny[6], nz[6];
+	Lane ax[6], ay[6], az[6];
+	Lane d[6];
+	for (int p = 0; p < 6; ++p)
+	{
+		const DirectX::XMFLOAT4& plane = frustum.Planes[p];
+		nx[p] = LaneSet(plane.x);
+		ny[p] = LaneSet(plane.y);
+		nz[p] = LaneSet(plane.z);
+		ax[p] = LaneAbs(nx[p]);
+		ay[p] = LaneAbs(ny[p]);
+		az[p] = LaneAbs(nz[p]);
+		d[p] = LaneSet(plane.w);
+	}
+
+	const Lane zero = LaneSet(0.0f);
+	const int allLanes = (1 << LaneWidth) - 1;
+
+	UINT visibleCount = 0;
+	for (UINT i = first; i < last; i += LaneWidth)
+	{
+		const Lane cx = LaneLoad(bounds.CenterX() + i);
+		const Lane cy = LaneLoad(bounds.CenterY() + i);
+		const Lane cz = LaneLoad(bounds.CenterZ() + i);
+		const Lane ex = LaneLoad(bounds.ExtentX() + i);
+		const Lane ey = LaneLoad(bounds.ExtentY() + i);
+		const Lane ez = LaneLoad(bounds.ExtentZ() + i);
+
+		// Distance of the box's centre from each plane, plus the box's extent along the
+		// plane normal: negative when even the box's innermost corner is behind the plane.
+		LaneMask outside = LaneLess(zero, zero);
+		for (int p = 0; p < 6; ++p)
+		{
+			Lane dist = LaneAdd(d[p], LaneMul(nx[p], cx));
+			dist = LaneAdd(dist, LaneMul(ny[p], cy));
+			dist = LaneAdd(dist, LaneMul(nz[p], cz));
+			dist = LaneAdd(dist, LaneMul(ax[p], ex));
+			dist = LaneAdd(dist, LaneMul(ay[p], ey));
+			dist = LaneAdd(dist, LaneMul(az[p], ez));
+
+			outside = LaneOr(outside, LaneLess(dist, zero));
+		}
+
+		int inside = ~LaneMaskBits(outside) & allLanes;
+		if (last - i < (UINT)LaneWidth)
+			inside &= (1 << (last - i)) - 1;
+
+		for (int lane = 0; inside != 0; ++lane, inside >>= 1)
+		{
+			if (inside & 1)
+			{
+				visible(i + lane);
+				++visibleCount;
+			}
+		}
+	}
+
+	return visibleCount;
+}
+
+// Boxes per chunk of ParallelCullBounds; a multiple of every LaneWidth.
+const UINT CullingChunkSize = 2048;
+
+// The boxes [First, Last) of a CullingBounds.
+struct CullingRange
+{
+	UINT First;
+	UINT Last;
+};
+
+// Working memory for ParallelCullBounds and ParallelCullRanges.  It grows to the box
+// count on first use and is only reused after that.
+struct CullingScratch
+{
+	// Each range's visible indices, starting at the range's first box.
+	std::vector<UINT> VisibleIndices;
+
+	// Visible boxes in the ranges before each range, plus the total at the end.
+	std::vector<UINT> RangeOffsets;
+
+	// ParallelCullBounds' chunks.
+	std::vector<CullingRange> Chunks;
+};
+
+// CullBounds over the boxes of ranges, which must not overlap, in parallel.  Each range
+// first records its visible indices.  A prefix sum over the ranges' visible counts then
+// gives every range the first output slot of its survivors, and the ranges call
+// write(i, slot) for each visible box i, with slot numbering the visible boxes from 0 in
+// the order of ranges and of i within a range.  A range's slots are contiguous, so each
+// thread fills its own run of the output, and the output is the same as the serial
+// CullBounds' over the ranges in turn whatever the thread count.  Returns the visible
+// count.
+template<typename F>
+UINT ParallelCullRanges(const FrustumPlanes& frustum, const CullingBounds& bounds,
+	const std::vector<CullingRange>& ranges, CullingScratch& scratch, F&& write)
+{
+	const int rangeCount = (int)ranges.size();
+	if (rangeCount == 0)
+		return 0;
+
+	scratch.VisibleIndices.resize(bounds.Size());
+	scratch.RangeOffsets.resize(rangeCount + 1);
+
+	// About CullingChunkSize boxes per task, whatever the range size.
+	std::size_t boxCount = 0;
+	for (const CullingRange& range : ranges)
+		boxCount += range.Last - range.First;
+	const int grainSize = (int)std::max<std::size_t>(CullingChunkSize * ranges.size() / std::max<std::size_t>(boxCount, 1), 1);
+
+	ParallelFor(0, rangeCount, grainSize, [&](int first, int last)
+		{
+			for (int r = first; r < last; ++r)
+			{
+				UINT* visible = scratch.VisibleIndices.data() + ranges[r].First;
+				scratch.RangeOffsets[r + 1] = CullBounds(frustum, bounds, ranges[r].First, ranges[r].Last,
+					[&](UINT i) { *visible++ = i; });
+			}
+		});
+
+	scratch.RangeOffsets[0] = 0;
+	for (int r = 0; r < rangeCount; ++r)
+		scratch.RangeOffsets[r + 1] += scratch.RangeOffsets[r];
+
+	ParallelFor(0, rangeCount, grainSize, [&](int first, int last)
+		{
+			for (int r = first; r < last; ++r)
+			{
+				const UINT* visible = scratch.VisibleIndices.data() + ranges[r].First;
+				for (UINT slot = scratch.RangeOffsets[r]; slot < scratch.RangeOffsets[r + 1]; ++slot)
+					write(*visible++, slot);
+			}
+		});
+
+	return scratch.RangeOffsets[rangeCount];
+}
+
+// ParallelCullRanges over every box, cut into fixed chunks of CullingChunkSize, so the
+// output is in increasing order of i.
+template<typename F>
+UINT ParallelCullBounds(const FrustumPlanes& frustum, const CullingBounds& bounds,
+	CullingScratch& scratch, F&& write)
+{
+	const UINT boxCount = (UINT)bounds.Size();
+
+	scratch.Chunks.clear();
+	for (UINT begin = 0; begin < boxCount; begin += CullingChunkSize)
+		scratch.Chunks.push_back({ begin, std::min<UINT>(begin + CullingChunkSize, boxCount) });
+
+	return ParallelCullRanges(frustum, bounds, scratch.Chunks, scratch, write);
+}
@@ -2,15 +2,45 @@
 // GameTimer.cpp by Frank Luna (C) 2011 All Rights Reserved.
 //***************************************************************************************
 
+#if defined(_WIN32)
 #include <windows.h>
+#else
+#include <chrono>
+#endif
 #include "GameTimer.h"
 
+namespace
+{
+	// The performance counter on Windows, a steady clock elsewhere.
+	std::int64_t QueryCounter()
+	{
+#if defined(_WIN32)
+		__int64 count;
+		QueryPerformanceCounter((LARGE_INTEGER*)&count);
+		return count;
+#else
+		return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+	}
+
+	std::int64_t QueryCounterFrequency()
+	{
+#if defined(_WIN32)
+		__int64 countsPerSec;
+		QueryPerformanceFrequency((LARGE_INTEGER*)&countsPerSec);
+		return countsPerSec;
+#else
+		using Period = std::chrono::steady_clock::period;
+		return Period::den / Period::num;
+#endif
+	}
+}
+
 GameTimer::GameTimer()
 	: mSecondsPerCount(0.0), mDeltaTime(-1.0), mBaseTime(0),
 	mPausedTime(0), mPrevTime(0), mCurrTime(0), mStopped(false)
 {
-	__int64 countsPerSec;
-	QueryPerformanceFrequency((LARGE_INTEGER*)&countsPerSec);
+	std::int64_t countsPerSec = QueryCounterFrequency();
 	mSecondsPerCount = 1.0 / (double)countsPerSec;
 }
 
@@ -55,8 +85,7 @@ float GameTimer::DeltaTime() const
 
 void GameTimer::Reset()
 {
-	__int64 currTime;
-	QueryPerformanceCounter((LARGE_INTEGER*)&currTime);
+	std::int64_t currTime = QueryCounter();
 
 	mBaseTime = currTime;
 	mPrevTime = currTime;
@@ -66,8 +95,7 @@ void GameTimer::Reset()
 
 void GameTimer::Start()
 {
-	__int64 startTime;
-	QueryPerformanceCounter((LARGE_INTEGER*)&startTime);
+	std::int64_t startTime = QueryCounter();
 
 
 	// Accumulate the time elapsed between stop and start pairs.
@@ -90,8 +118,7 @@ void GameTimer::Stop()
 {
 	if (!mStopped)
 	{
-		__int64 currTime;
-		QueryPerformanceCounter((LARGE_INTEGER*)&currTime);
+		std::int64_t currTime = QueryCounter();
 
 		mStopTime = currTime;
 		mStopped = true;
@@ -106,8 +133,7 @@ void GameTimer::Tick()
 		return;
 	}
 
-	__int64 currTime;
-	QueryPerformanceCounter((LARGE_INTEGER*)&currTime);
+	std::int64_t currTime = QueryCounter();
 	mCurrTime = currTime;
 
 	// Time difference between this frame and the previous.
@@ -0,0 +1,119 @@
+//***************************************************************************************
+// MappedFile.cpp
+//***************************************************************************************
+
+#include "MappedFile.h"
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#if defined(_WIN32)
+
+bool MappedFile::Open(const std::string& filename)
+{
+	Close();
+
+	mFile = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (mFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(mFile, &size))
+	{
+		Close();
+		return false;
+	}
+
+	mSize = (std::size_t)size.QuadPart;
+	mIsOpen = true;
+
+	// CreateFileMapping refuses empty files.
+	if (mSize == 0)
+		return true;
+
+	mMapping = CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mMapping != nullptr)
+		mData = (const BYTE*)MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+
+	if (mData == nullptr)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (mData != nullptr)
+		UnmapViewOfFile(mData);
+	if (mMapping != nullptr)
+		CloseHandle(mMapping);
+	if (mFile != INVALID_HANDLE_VALUE)
+		CloseHandle(mFile);
+
+	mData = nullptr;
+	mSize = 0;
+	mIsOpen = false;
+	mMapping = nullptr;
+	mFile = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool MappedFile::Open(const std::string& filename)
+{
+	Close();
+
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	mSize = (std::size_t)info.st_size;
+	if (mSize > 0)
+	{
+		void* data = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED)
+		{
+			close(fd);
+			mSize = 0;
+			return false;
+		}
+		mData = (const BYTE*)data;
+	}
+
+	// The mapping keeps the file alive.
+	close(fd);
+	mIsOpen = true;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (mData != nullptr)
+		munmap((void*)mData, mSize);
+
+	mData = nullptr;
+	mSize = 0;
+	mIsOpen = false;
+}
+
+#endif
@@ -0,0 +1,42 @@
+//***************************************************************************************
+// MappedFile.h
+//
+// Read-only memory mapping of a whole file (CreateFileMapping on Windows, mmap
+// elsewhere).  The bytes are paged in by the OS on first touch and stay valid until
+// Close() or destruction, so loaders can point straight into them instead of copying.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "Platform.h"
+
+
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile& rhs) = delete;
+	MappedFile& operator=(const MappedFile& rhs) = delete;
+	~MappedFile();
+
+	// Maps filename; false if it cannot be opened.  An empty file maps to Size() 0.
+	bool Open(const std::string& filename);
+	void Close();
+
+	bool IsOpen() const { return mIsOpen; }
+	const BYTE* Data() const { return mData; }
+	std::size_t Size() const { return mSize; }
+
+private:
+	const BYTE* mData = nullptr;
+	std::size_t mSize = 0;
+	bool mIsOpen = false;
+
+#if defined(_WIN32)
+	HANDLE mFile = INVALID_HANDLE_VALUE;
+	HANDLE mMapping = nullptr;
+#endif
+};
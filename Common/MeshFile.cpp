@@ -0,0 +1,273 @@
+//***************************************************************************************
+// MeshFile.cpp
+//***************************************************************************************
+
+#include "MeshFile.h"
+#include "MathHelper.h"
+#include "TextTokenizer.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace DirectX;
+
+
+namespace
+{
+	const UINT VertexChunk = MakeChunkId('V', 'P', 'N', 'M');
+	const UINT IndexChunk = MakeChunkId('I', 'D', 'X', '3');
+
+	// Text per parse chunk: about a thousand skull.txt vertex lines, which takes far
+	// longer to convert than to schedule.
+	const std::size_t ChunkBytes = 64 * 1024;
+
+	// Vertices per block of the bounds reduction.
+	const std::size_t BoundsBlockSize = 4096;
+
+	struct TextChunk
+	{
+		const char* First;
+		const char* Last;
+		UINT FirstRecord;
+		UINT RecordCount;
+	};
+
+	inline bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+	}
+
+	// Lines in [first, last) that hold at least one token.  Only the leading whitespace
+	// of a line is looked at; the rest is skipped with memchr.
+	UINT CountRecords(const char* first, const char* last)
+	{
+		UINT count = 0;
+		while (first != last)
+		{
+			const char* c = first;
+			while (c != last && *c != '\n' && IsSpace(*c))
+				++c;
+
+			if (c != last && *c != '\n')
+				++count;
+
+			const char* lineEnd = (const char*)std::memchr(c, '\n', last - c);
+			first = lineEnd != nullptr ? lineEnd + 1 : last;
+		}
+		return count;
+	}
+
+	// Cuts [first, last) into pieces of about ChunkBytes, each ending just after a
+	// line break (or at last).
+	std::vector<TextChunk> SplitLines(const char* first, const char* last)
+	{
+		std::vector<TextChunk> chunks;
+		while (first != last)
+		{
+			const char* split = last;
+			if ((std::size_t)(last - first) > ChunkBytes)
+			{
+				split = std::find(first + ChunkBytes, last, '\n');
+				if (split != last)
+					++split;
+			}
+			chunks.push_back({ first, split, 0, 0 });
+			first = split;
+		}
+		return chunks;
+	}
+
+	// Calls parseRecord(tokens, recordIndex) for each of the recordCount lines of
+	// [first, last), on the worker threads.  Fails if the section does not hold exactly
+	// recordCount records or one of them does not parse.
+	template<typename ParseRecord>
+	bool ParseSection(const char* first, const char* last, UINT recordCount, const ParseRecord& parseRecord)
+	{
+		std::vector<TextChunk> chunks = SplitLines(first, last);
+		const int chunkCount = (int)chunks.size();
+
+		ParallelFor(0, chunkCount, 1, [&](int firstChunk, int lastChunk)
+			{
+				for (int i = firstChunk; i < lastChunk; ++i)
+					chunks[i].RecordCount = CountRecords(chunks[i].First, chunks[i].Last);
+			});
+
+		UINT total = 0;
+		for (TextChunk& chunk : chunks)
+		{
+			chunk.FirstRecord = total;
+			total += chunk.RecordCount;
+		}
+		if (total != recordCount)
+			return false;
+
+		std::vector<char> parsed(chunks.size(), 0);
+		ParallelFor(0, chunkCount, 1, [&](int firstChunk, int lastChunk)
+			{
+				for (int i = firstChunk; i < lastChunk; ++i)
+				{
+					TextTokenizer tokens;
+					tokens.Reset(chunks[i].First, chunks[i].Last);
+
+					const UINT end = chunks[i].FirstRecord + chunks[i].RecordCount;
+					for (UINT record = chunks[i].FirstRecord; record < end; ++record)
+						parseRecord(tokens, record);
+
+					// A line with extra numbers would shift every record after it.
+					parsed[i] = tokens && tokens.NextToken().empty();
+				}
+			});
+
+		return std::find(parsed.begin(), parsed.end(), 0) == parsed.end();
+	}
+}
+
+bool LoadTextMesh(const std::string& filename,
+	std::vector<MeshFileVertex>& vertices,
+	std::vector<std::uint32_t>& indices)
+{
+	TextTokenizer fin;
+	if (!fin.Open(filename))
+		return false;
+
+	UINT vcount = 0;
+	UINT tcount = 0;
+
+	fin.Skip() >> vcount;
+	fin.Skip() >> tcount;
+	fin.Skip(4);
+
+	vertices.resize(vcount);
+	for (UINT i = 0; i < vcount; ++i)
+	{
+		fin >> vertices[i].Pos.x >> vertices[i].Pos.y >> vertices[i].Pos.z;
+		fin >> vertices[i].Normal.x >> vertices[i].Normal.y >> vertices[i].Normal.z;
+	}
+
+	fin.Skip(3);
+
+	indices.resize(3 * tcount);
+	for (UINT i = 0; i < tcount; ++i)
+	{
+		fin >> indices[i * 3 + 0] >> indices[i * 3 + 1] >> indices[i * 3 + 2];
+	}
+
+	return (bool)fin;
+}
+
+bool LoadTextMeshParallel(const std::string& filename,
+	std::vector<MeshFileVertex>& vertices,
+	std::vector<std::uint32_t>& indices)
+{
+	// The counting pass only pays for itself when the chunks run side by side.
+	if (GetTaskScheduler().ConcurrencyLevel() == 1)
+		return LoadTextMesh(filename, vertices, indices);
+
+	MappedFile file;
+	if (!file.Open(filename))
+		return false;
+
+	const char* text = (const char*)file.Data();
+	const char* end = text + file.Size();
+
+	const char* vertexListBegin = std::find(text, end, '{');
+	const char* vertexListEnd = std::find(vertexListBegin, end, '}');
+	const char* triangleListBegin = std::find(vertexListEnd, end, '{');
+	const char* triangleListEnd = std::find(triangleListBegin, end, '}');
+	if (triangleListEnd == end)
+		return false;
+
+	UINT vcount = 0;
+	UINT tcount = 0;
+
+	TextTokenizer header;
+	header.Reset(text, vertexListBegin);
+	header.Skip() >> vcount;
+	header.Skip() >> tcount;
+	if (!header)
+		return false;
+
+	vertices.resize(vcount);
+	indices.resize(3 * tcount);
+
+	MeshFileVertex* v = vertices.data();
+	std::uint32_t* i = indices.data();
+
+	return ParseSection(vertexListBegin + 1, vertexListEnd, vcount,
+			[v](TextTokenizer& fin, UINT k)
+			{
+				fin >> v[k].Pos.x >> v[k].Pos.y >> v[k].Pos.z;
+				fin >> v[k].Normal.x >> v[k].Normal.y >> v[k].Normal.z;
+			}) &&
+		ParseSection(triangleListBegin + 1, triangleListEnd, tcount,
+			[i](TextTokenizer& fin, UINT k)
+			{
+				fin >> i[k * 3 + 0] >> i[k * 3 + 1] >> i[k * 3 + 2];
+			});
+}
+
+BoundingBox ComputeMeshBounds(const MeshFileVertex* vertices, std::size_t count)
+{
+	BoundingBox bounds(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 0.0f));
+	if (count == 0)
+		return bounds;
+
+	const int blockCount = (int)((count + BoundsBlockSize - 1) / BoundsBlockSize);
+	std::vector<XMFLOAT3> blockMin(blockCount);
+	std::vector<XMFLOAT3> blockMax(blockCount);
+
+	ParallelFor(0, blockCount, 1, [&](int firstBlock, int lastBlock)
+		{
+			for (int block = firstBlock; block < lastBlock; ++block)
+			{
+				const std::size_t first = block * BoundsBlockSize;
+				const std::size_t last = std::min<std::size_t>(first + BoundsBlockSize, count);
+
+				XMVECTOR vMin = XMVectorReplicate(+MathHelper::Infinity);
+				XMVECTOR vMax = XMVectorReplicate(-MathHelper::Infinity);
+				for (std::size_t k = first; k < last; ++k)
+				{
+					XMVECTOR P = XMLoadFloat3(&vertices[k].Pos);
+					vMin = XMVectorMin(vMin, P);
+					vMax = XMVectorMax(vMax, P);
+				}
+
+				XMStoreFloat3(&blockMin[block], vMin);
+				XMStoreFloat3(&blockMax[block], vMax);
+			}
+		});
+
+	XMVECTOR vMin = XMLoadFloat3(&blockMin[0]);
+	XMVECTOR vMax = XMLoadFloat3(&blockMax[0]);
+	for (int block = 1; block < blockCount; ++block)
+	{
+		vMin = XMVectorMin(vMin, XMLoadFloat3(&blockMin[block]));
+		vMax = XMVectorMax(vMax, XMLoadFloat3(&blockMax[block]));
+	}
+
+	XMStoreFloat3(&bounds.Center, 0.5f * (vMin + vMax));
+	XMStoreFloat3(&bounds.Extents, 0.5f * (vMax - vMin));
+	return bounds;
+}
+
+bool SaveBinaryMesh(const std::string& filename,
+	const std::vector<MeshFileVertex>& vertices,
+	const std::vector<std::uint32_t>& indices)
+{
+	ChunkFileWriter writer;
+	writer.AddChunk(VertexChunk, vertices);
+	writer.AddChunk(IndexChunk, indices);
+	return writer.Save(filename, BinaryMesh::Magic, BinaryMesh::Version);
+}
+
+bool BinaryMesh::Open(const std::string& filename)
+{
+	if (!mFile.Open(filename, Magic, Version))
+		return false;
+
+	mVertices = mFile.Chunk<MeshFileVertex>(VertexChunk);
+	mIndices = mFile.Chunk<std::uint32_t>(IndexChunk);
+
+	return !mVertices.empty() && mIndices.size() % 3 == 0;
+}
@@ -0,0 +1,78 @@
+//***************************************************************************************
+// MeshFile.h
+//
+// The position/normal triangle meshes in Models/ (skull.txt, car.txt).  They come as
+// text:
+//
+//     VertexCount: n
+//     TriangleCount: m
+//     VertexList (pos, normal)
+//     {
+//         px py pz nx ny nz        (n lines)
+//     }
+//     TriangleList
+//     {
+//         i0 i1 i2                 (m lines)
+//     }
+//
+// and, once run through the ModelConverter tool, as a binary .meshb ChunkFile that
+// BinaryMesh maps without parsing.
+//
+// LoadTextMeshParallel reads the same text on the worker threads: the braces give the
+// two sections, each section is cut into line-aligned chunks, and since every line is
+// one record a quick count of the lines in each chunk tells it where its records go in
+// the preallocated output arrays.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <DirectXCollision.h>
+#include <DirectXMath.h>
+#include <string>
+#include <vector>
+
+#include "ChunkFile.h"
+
+
+struct MeshFileVertex
+{
+	DirectX::XMFLOAT3 Pos;
+	DirectX::XMFLOAT3 Normal;
+};
+
+bool LoadTextMesh(const std::string& filename,
+	std::vector<MeshFileVertex>& vertices,
+	std::vector<std::uint32_t>& indices);
+
+// Same result as LoadTextMesh, parsed in parallel (see above).
+bool LoadTextMeshParallel(const std::string& filename,
+	std::vector<MeshFileVertex>& vertices,
+	std::vector<std::uint32_t>& indices);
+
+// Axis-aligned box around the positions; blocks of vertices are reduced in parallel.
+DirectX::BoundingBox ComputeMeshBounds(const MeshFileVertex* vertices, std::size_t count);
+
+bool SaveBinaryMesh(const std::string& filename,
+	const std::vector<MeshFileVertex>& vertices,
+	const std::vector<std::uint32_t>& indices);
+
+
+// A mapped .meshb file.  The views stay valid while the BinaryMesh is open.
+class BinaryMesh
+{
+public:
+	static const UINT Magic = MakeChunkId('M', 'E', 'S', 'H');
+	static const UINT Version = 1;
+
+	bool Open(const std::string& filename);
+
+	ArrayView<MeshFileVertex> Vertices() const { return mVertices; }
+	ArrayView<std::uint32_t> Indices() const { return mIndices; }
+
+private:
+	ChunkFileReader mFile;
+	ArrayView<MeshFileVertex> mVertices;
+	ArrayView<std::uint32_t> mIndices;
+};
@@ -0,0 +1,393 @@
+//***************************************************************************************
+// MeshOptimizer.cpp
+//***************************************************************************************
+
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <numeric>
+
+using namespace DirectX;
+
+
+namespace
+{
+	// A FIFO cache in the style of the paper: vertex v is resident while fewer than
+	// cacheSize misses have happened since it was last loaded.  Bumping the timestamp
+	// by more than cacheSize flushes it.
+	struct FifoCache
+	{
+		FifoCache(std::size_t vertexCount, UINT cacheSize) :
+			Times(vertexCount, 0),
+			Timestamp(cacheSize + 1),
+			Size(cacheSize)
+		{
+		}
+
+		bool Contains(std::uint32_t v) const { return Timestamp - Times[v] <= Size; }
+
+		// Returns 1 on a miss.
+		UINT Touch(std::uint32_t v)
+		{
+			if (Contains(v))
+				return 0;
+			Times[v] = Timestamp++;
+			return 1;
+		}
+
+		UINT TouchTriangle(const std::uint32_t* tri)
+		{
+			return Touch(tri[0]) + Touch(tri[1]) + Touch(tri[2]);
+		}
+
+		void Flush() { Timestamp += Size + 1; }
+
+		std::vector<std::size_t> Times;
+		std::size_t Timestamp;
+		std::size_t Size;
+	};
+
+	// The triangles using each vertex, as offsets into one array.
+	struct VertexTriangles
+	{
+		VertexTriangles(const std::uint32_t* indices, std::size_t indexCount, std::size_t vertexCount) :
+			Offsets(vertexCount + 1, 0),
+			Triangles(indexCount)
+		{
+			for (std::size_t i = 0; i < indexCount; ++i)
+				++Offsets[indices[i] + 1];
+			std::partial_sum(Offsets.begin(), Offsets.end(), Offsets.begin());
+
+			std::vector<std::uint32_t> fill(Offsets.begin(), Offsets.end() - 1);
+			for (std::size_t i = 0; i < indexCount; ++i)
+				Triangles[fill[indices[i]]++] = (std::uint32_t)(i / 3);
+		}
+
+		const std::uint32_t* begin(std::uint32_t v) const { return Triangles.data() + Offsets[v]; }
+		const std::uint32_t* end(std::uint32_t v) const { return Triangles.data() + Offsets[v + 1]; }
+		std::uint32_t Count(std::uint32_t v) const { return Offsets[v + 1] - Offsets[v]; }
+
+		std::vector<std::uint32_t> Offsets;
+		std::vector<std::uint32_t> Triangles;
+	};
+
+	const std::uint32_t NoVertex = ~0u;
+
+	// Tipsify's choice of the next fanning vertex: of the candidates that still have
+	// triangles left, the one that has been in the cache longest but would still be
+	// there after emitting all of them.
+	std::uint32_t NextFanningVertex(const std::vector<std::uint32_t>& candidates,
+		const std::vector<std::uint32_t>& liveCount, const FifoCache& cache)
+	{
+		std::uint32_t best = NoVertex;
+		std::size_t bestPriority = 0;
+		bool haveBest = false;
+
+		for (std::uint32_t v : candidates)
+		{
+			if (liveCount[v] == 0)
+				continue;
+
+			// Vertices that would fall out of the cache are a last resort (priority 0).
+			std::size_t priority = 0;
+			const std::size_t age = cache.Timestamp - cache.Times[v];
+			if (age + 2 * liveCount[v] <= cache.Size)
+				priority = age;
+
+			if (!haveBest || priority > bestPriority)
+			{
+				best = v;
+				bestPriority = priority;
+				haveBest = true;
+			}
+		}
+
+		return best;
+	}
+}
+
+std::size_t CountVertexCacheMisses(const std::uint32_t* indices, std::size_t indexCount,
+	std::size_t vertexCount, UINT cacheSize)
+{
+	FifoCache cache(vertexCount, cacheSize);
+
+	std::size_t misses = 0;
+	for (std::size_t i = 0; i + 2 < indexCount; i += 3)
+		misses += cache.TouchTriangle(indices + i);
+	return misses;
+}
+
+float ComputeAcmr(const std::uint32_t* indices, std::size_t indexCount,
+	std::size_t vertexCount, UINT cacheSize)
+{
+	const std::size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return 0.0f;
+
+	return (float)CountVertexCacheMisses(indices, indexCount, vertexCount, cacheSize) / triangleCount;
+}
+
+void OptimizeVertexCache(std::uint32_t* indices, std::size_t indexCount,
+	std::size_t vertexCount, UINT cacheSize)
+{
+	const std::size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0 || vertexCount == 0)
+		return;
+
+	const std::vector<std::uint32_t> source(indices, indices + triangleCount * 3);
+	const VertexTriangles adjacency(source.data(), source.size(), vertexCount);
+
+	std::vector<std::uint32_t> liveCount(vertexCount);
+	for (std::uint32_t v = 0; v < vertexCount; ++v)
+		liveCount[v] = adjacency.Count(v);
+
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<std::uint32_t> deadEnd;
+	std::vector<std::uint32_t> candidates;
+	FifoCache cache(vertexCount, cacheSize);
+
+	std::size_t outputCount = 0;
+	std::uint32_t cursor = 0;
+	std::uint32_t fan = 0;
+
+	while (fan != NoVertex)
+	{
+		candidates.clear();
+
+		for (const std::uint32_t* t = adjacency.begin(fan); t != adjacency.end(fan); ++t)
+		{
+			if (emitted[*t])
+				continue;
+
+			const std::uint32_t* tri = source.data() + 3 * *t;
+			for (int k = 0; k < 3; ++k)
+			{
+				const std::uint32_t v = tri[k];
+				indices[outputCount++] = v;
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				--liveCount[v];
+				cache.Touch(v);
+			}
+			emitted[*t] = true;
+		}
+
+		fan = NextFanningVertex(candidates, liveCount, cache);
+		if (fan != NoVertex)
+			continue;
+
+		// Dead end: fall back to the most recently used vertex with triangles left,
+		// then to the next one in input order.
+		while (!deadEnd.empty())
+		{
+			const std::uint32_t v = deadEnd.back();
+			deadEnd.pop_back();
+			if (liveCount[v] > 0)
+			{
+				fan = v;
+				break;
+			}
+		}
+
+		while (fan == NoVertex && cursor < vertexCount)
+		{
+			if (liveCount[cursor] > 0)
+				fan = cursor;
+			++cursor;
+		}
+	}
+}
+
+void OptimizeOverdraw(std::uint32_t* indices, std::size_t indexCount,
+	const XMFLOAT3* positions, std::size_t positionStride, std::size_t vertexCount,
+	float threshold, UINT cacheSize)
+{
+	const std::size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0 || vertexCount == 0)
+		return;
+
+	auto position = [positions, positionStride](std::uint32_t v)
+		{
+			return XMLoadFloat3((const XMFLOAT3*)((const BYTE*)positions + v * positionStride));
+		};
+
+	// Hard boundaries: a triangle whose three vertices all miss starts afresh anyway,
+	// so cutting there costs nothing.
+	std::vector<std::size_t> hardBoundaries(1, 0);
+	{
+		FifoCache cache(vertexCount, cacheSize);
+		cache.TouchTriangle(indices);
+		for (std::size_t t = 1; t < triangleCount; ++t)
+		{
+			if (cache.TouchTriangle(indices + 3 * t) == 3)
+				hardBoundaries.push_back(t);
+		}
+	}
+	hardBoundaries.push_back(triangleCount);
+
+	// Soft boundaries: within a hard cluster, cut as soon as the running ACMR since
+	// the last cut (with the cache flushed there) is within threshold of the cluster's.
+	std::vector<std::size_t> clusters;
+	{
+		FifoCache cache(vertexCount, cacheSize);
+		for (std::size_t c = 0; c + 1 < hardBoundaries.size(); ++c)
+		{
+			const std::size_t first = hardBoundaries[c];
+			const std::size_t last = hardBoundaries[c + 1];
+
+			cache.Flush();
+			std::size_t clusterMisses = 0;
+			for (std::size_t t = first; t < last; ++t)
+				clusterMisses += cache.TouchTriangle(indices + 3 * t);
+			const float target = threshold * clusterMisses / (last - first);
+
+			clusters.push_back(first);
+
+			cache.Flush();
+			std::size_t misses = 0;
+			std::size_t count = 0;
+			for (std::size_t t = first; t + 1 < last; ++t)
+			{
+				misses += cache.TouchTriangle(indices + 3 * t);
+				++count;
+				if ((float)misses / count <= target)
+				{
+					clusters.push_back(t + 1);
+					cache.Flush();
+					misses = 0;
+					count = 0;
+				}
+			}
+		}
+	}
+	clusters.push_back(triangleCount);
+
+	const std::size_t clusterCount = clusters.size() - 1;
+
+	// Each cluster's area-weighted centroid and normal, and the mesh's centroid.
+	std::vector<XMFLOAT3> centroids(clusterCount);
+	std::vector<XMFLOAT3> normals(clusterCount);
+	XMVECTOR meshCentroid = XMVectorZero();
+	float meshArea = 0.0f;
+
+	for (std::size_t c = 0; c < clusterCount; ++c)
+	{
+		XMVECTOR centroid = XMVectorZero();
+		XMVECTOR normal = XMVectorZero();
+		float area = 0.0f;
+
+		for (std::size_t t = clusters[c]; t < clusters[c + 1]; ++t)
+		{
+			XMVECTOR p0 = position(indices[3 * t + 0]);
+			XMVECTOR p1 = position(indices[3 * t + 1]);
+			XMVECTOR p2 = position(indices[3 * t + 2]);
+
+			XMVECTOR n = XMVector3Cross(p1 - p0, p2 - p0);
+			float triangleArea = XMVectorGetX(XMVector3Length(n));
+
+			centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+			normal += n;
+			area += triangleArea;
+		}
+
+		meshCentroid += centroid;
+		meshArea += area;
+
+		XMStoreFloat3(&centroids[c], area > 0.0f ? centroid / area : centroid);
+		XMStoreFloat3(&normals[c], XMVector3Normalize(normal));
+	}
+
+	if (meshArea > 0.0f)
+		meshCentroid /= meshArea;
+
+	// Clusters facing away from the centre are the likeliest occluders: draw them first.
+	std::vector<float> sortKeys(clusterCount);
+	for (std::size_t c = 0; c < clusterCount; ++c)
+	{
+		XMVECTOR toCluster = XMLoadFloat3(&centroids[c]) - meshCentroid;
+		sortKeys[c] = XMVectorGetX(XMVector3Dot(toCluster, XMLoadFloat3(&normals[c])));
+	}
+
+	std::vector<std::size_t> order(clusterCount);
+	std::iota(order.begin(), order.end(), std::size_t(0));
+	std::stable_sort(order.begin(), order.end(), [&sortKeys](std::size_t a, std::size_t b)
+		{
+			return sortKeys[a] > sortKeys[b];
+		});
+
+	const std::vector<std::uint32_t> source(indices, indices + triangleCount * 3);
+	std::size_t outputCount = 0;
+	for (std::size_t c : order)
+	{
+		for (std::size_t i = 3 * clusters[c]; i < 3 * clusters[c + 1]; ++i)
+			indices[outputCount++] = source[i];
+	}
+}
+
+void OptimizeVertexFetch(std::uint32_t* indices, std::size_t indexCount,
+	std::size_t vertexCount, std::vector<std::uint32_t>& remap)
+{
+	remap.assign(vertexCount, NoVertex);
+
+	std::uint32_t next = 0;
+	for (std::size_t i = 0; i < indexCount; ++i)
+	{
+		std::uint32_t& newIndex = remap[indices[i]];
+		if (newIndex == NoVertex)
+			newIndex = next++;
+		indices[i] = newIndex;
+	}
+
+	for (std::uint32_t& newIndex : remap)
+	{
+		if (newIndex == NoVertex)
+			newIndex = next++;
+	}
+}
+
+MeshOptimizationStats OptimizeMeshIndices(std::uint32_t* indices, std::size_t indexCount,
+	const XMFLOAT3* positions, std::size_t positionStride, std::size_t vertexCount,
+	std::vector<std::uint32_t>& remap)
+{
+	MeshOptimizationStats stats;
+
+	// A list that is not whole triangles of valid indices is left as it is.
+	const bool valid = indexCount % 3 == 0 &&
+		std::all_of(indices, indices + indexCount, [vertexCount](std::uint32_t v) { return v < vertexCount; });
+	if (!valid)
+	{
+		remap.resize(vertexCount);
+		std::iota(remap.begin(), remap.end(), 0u);
+		return stats;
+	}
+
+	stats.TriangleCount = indexCount / 3;
+	stats.CacheMissesBefore = CountVertexCacheMisses(indices, indexCount, vertexCount);
+
+	// Some models come already ordered for the cache (the skull is within 2% of what
+	// Tipsify manages); keep their order then.
+	std::vector<std::uint32_t> cacheOrdered(indices, indices + indexCount);
+	OptimizeVertexCache(indices, indexCount, vertexCount);
+	std::size_t cacheMisses = CountVertexCacheMisses(indices, indexCount, vertexCount);
+	if (cacheMisses > stats.CacheMissesBefore)
+	{
+		std::copy(cacheOrdered.begin(), cacheOrdered.end(), indices);
+		cacheMisses = stats.CacheMissesBefore;
+	}
+	else
+	{
+		std::copy(indices, indices + indexCount, cacheOrdered.begin());
+	}
+
+	// Clustering only targets each cluster's ACMR, and sorting the clusters changes
+	// which vertices are cached across the cuts, so check the whole list and undo it
+	// if it costs more than the threshold allows.
+	OptimizeOverdraw(indices, indexCount, positions, positionStride, vertexCount, OverdrawAcmrThreshold);
+	if (CountVertexCacheMisses(indices, indexCount, vertexCount) > OverdrawAcmrThreshold * cacheMisses)
+		std::copy(cacheOrdered.begin(), cacheOrdered.end(), indices);
+
+	OptimizeVertexFetch(indices, indexCount, vertexCount, remap);
+
+	stats.CacheMissesAfter = CountVertexCacheMisses(indices, indexCount, vertexCount);
+	return stats;
+}
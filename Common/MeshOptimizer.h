@@ -0,0 +1,111 @@
+//***************************************************************************************
+// MeshOptimizer.h
+//
+// Reorders a triangle list for the GPU.  The text models list their triangles in
+// whatever order the modelling tool wrote them, which thrashes the post-transform
+// vertex cache on dense meshes like the skull.  The passes, in the order OptimizeMesh
+// runs them:
+//
+//   1. Vertex cache:  Tipsify (Sander, Nehab and Barczak, "Fast Triangle Reordering for
+//                     Vertex Locality and Reduced Overdraw", 2007) fans around recently
+//                     used vertices to keep the average cache miss ratio (ACMR: misses
+//                     per triangle, 0.5 at best, 3 at worst) low.
+//   2. Overdraw:      the same paper's clustering.  The cache-ordered list is cut into
+//                     clusters wherever the cache would be flushed anyway, or once a
+//                     cluster has reached the ACMR target, and the clusters are sorted
+//                     so the ones facing away from the mesh's centre are drawn first.
+//                     The threshold trades ACMR for overdraw (1.05 = 5% worse ACMR)
+//                     per cluster; the sort can lose more across the cuts, so
+//                     OptimizeMeshIndices keeps the cache order whenever the whole
+//                     list ends up worse than OverdrawAcmrThreshold times it.
+//   3. Vertex fetch:  vertices are renumbered in the order the triangles first use
+//                     them, so the input assembler reads memory in order.  Vertices no
+//                     triangle uses go to the end.
+//
+// The passes only permute: the output draws the same triangles with the same winding.
+// ACMR is measured against a FIFO cache of VertexCacheSize entries.  The single passes
+// expect every index to be below vertexCount; OptimizeMeshIndices checks, and leaves a
+// list that is not whole triangles of valid indices as it is.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Platform.h"
+
+
+const UINT VertexCacheSize = 16;
+
+// How much worse an ACMR the overdraw pass may leave than the vertex cache pass.
+const float OverdrawAcmrThreshold = 1.05f;
+
+struct MeshOptimizationStats
+{
+	std::size_t TriangleCount = 0;
+	std::size_t CacheMissesBefore = 0;
+	std::size_t CacheMissesAfter = 0;
+
+	float AcmrBefore() const { return TriangleCount ? (float)CacheMissesBefore / TriangleCount : 0.0f; }
+	float AcmrAfter() const { return TriangleCount ? (float)CacheMissesAfter / TriangleCount : 0.0f; }
+
+	MeshOptimizationStats& operator+=(const MeshOptimizationStats& rhs)
+	{
+		TriangleCount += rhs.TriangleCount;
+		CacheMissesBefore += rhs.CacheMissesBefore;
+		CacheMissesAfter += rhs.CacheMissesAfter;
+		return *this;
+	}
+};
+
+// Transforms a FIFO cache of cacheSize vertices would miss drawing the triangle list.
+std::size_t CountVertexCacheMisses(const std::uint32_t* indices, std::size_t indexCount,
+	std::size_t vertexCount, UINT cacheSize = VertexCacheSize);
+
+float ComputeAcmr(const std::uint32_t* indices, std::size_t indexCount,
+	std::size_t vertexCount, UINT cacheSize = VertexCacheSize);
+
+void OptimizeVertexCache(std::uint32_t* indices, std::size_t indexCount,
+	std::size_t vertexCount, UINT cacheSize = VertexCacheSize);
+
+// positions points at the first vertex's position and positionStride is the size of
+// a vertex, so the app's own vertex array can be passed.
+void OptimizeOverdraw(std::uint32_t* indices, std::size_t indexCount,
+	const DirectX::XMFLOAT3* positions, std::size_t positionStride, std::size_t vertexCount,
+	float threshold = OverdrawAcmrThreshold, UINT cacheSize = VertexCacheSize);
+
+// Renumbers the indices in first-use order; vertex v of the old array becomes vertex
+// remap[v] of the new one (see RemapVertices).
+void OptimizeVertexFetch(std::uint32_t* indices, std::size_t indexCount,
+	std::size_t vertexCount, std::vector<std::uint32_t>& remap);
+
+template<typename V>
+void RemapVertices(V* vertices, std::size_t vertexCount, const std::vector<std::uint32_t>& remap)
+{
+	std::vector<V> source(vertices, vertices + vertexCount);
+	for (std::size_t v = 0; v < vertexCount; ++v)
+		vertices[remap[v]] = source[v];
+}
+
+// All three passes over one triangle list; the caller applies remap to its vertices.
+MeshOptimizationStats OptimizeMeshIndices(std::uint32_t* indices, std::size_t indexCount,
+	const DirectX::XMFLOAT3* positions, std::size_t positionStride, std::size_t vertexCount,
+	std::vector<std::uint32_t>& remap);
+
+// For vertex types with an XMFLOAT3 Pos, such as MeshFileVertex.
+template<typename V>
+MeshOptimizationStats OptimizeMesh(std::vector<V>& vertices, std::vector<std::uint32_t>& indices)
+{
+	if (vertices.empty() || indices.empty())
+		return MeshOptimizationStats();
+
+	std::vector<std::uint32_t> remap;
+	MeshOptimizationStats stats = OptimizeMeshIndices(indices.data(), indices.size(),
+		&vertices[0].Pos, sizeof(V), vertices.size(), remap);
+
+	RemapVertices(vertices.data(), vertices.size(), remap);
+	return stats;
+}
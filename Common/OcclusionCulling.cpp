@@ -0,0 +1,532 @@
+//***************************************************************************************
+// OcclusionCulling.cpp
+//***************************************************************************************
+
+#include "OcclusionCulling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+#include "SimdLane.h"
+
+using namespace DirectX;
+
+
+namespace
+{
+	// Triangles are clipped to this multiple of the viewport in x and y, which keeps
+	// the screen coordinates small enough for float edge functions.
+	const float GuardBand = 2.0f;
+
+	// The corners of a box, bit 0 set for +x, bit 1 for +y and bit 2 for +z, and its
+	// faces wound clockwise seen from outside.
+	const std::uint32_t BoxIndices[36] =
+	{
+		0, 2, 3,  0, 3, 1,	// -z
+		4, 5, 7,  4, 7, 6,	// +z
+		0, 4, 6,  0, 6, 2,	// -x
+		1, 3, 7,  1, 7, 5,	// +x
+		0, 1, 5,  0, 5, 4,	// -y
+		2, 6, 7,  2, 7, 3	// +y
+	};
+
+	void BoxCorners(const BoundingBox& box, XMFLOAT3 corners[8])
+	{
+		for (int i = 0; i < 8; ++i)
+		{
+			corners[i] = XMFLOAT3(
+				box.Center.x + (i & 1 ? box.Extents.x : -box.Extents.x),
+				box.Center.y + (i & 2 ? box.Extents.y : -box.Extents.y),
+				box.Center.z + (i & 4 ? box.Extents.z : -box.Extents.z));
+		}
+	}
+
+	// Signed distance of a clip-space point from clip plane p: the near plane, then
+	// the guard band's left, right, bottom and top.  Positive inside.
+	float ClipDistance(const XMFLOAT4& v, int p)
+	{
+		switch (p)
+		{
+		case 0: return v.z;
+		case 1: return GuardBand * v.w + v.x;
+		case 2: return GuardBand * v.w - v.x;
+		case 3: return GuardBand * v.w + v.y;
+		default: return GuardBand * v.w - v.y;
+		}
+	}
+
+	XMFLOAT4 Lerp(const XMFLOAT4& a, const XMFLOAT4& b, float t)
+	{
+		return XMFLOAT4(a.x + t * (b.x - a.x), a.y + t * (b.y - a.y), a.z + t * (b.z - a.z), a.w + t * (b.w - a.w));
+	}
+
+	const float* Component(const XMFLOAT3& v)
+	{
+		return &v.x;
+	}
+}
+
+OcclusionBuffer::OcclusionBuffer(UINT width, UINT height)
+{
+	XMStoreFloat4x4(&mViewProj, XMMatrixIdentity());
+	Resize(width, height);
+}
+
+void OcclusionBuffer::Resize(UINT width, UINT height)
+{
+	mWidth = std::max<UINT>(width, 1u);
+	mHeight = std::max<UINT>(height, 1u);
+	mRowPitch = (mWidth + LaneWidth - 1) / LaneWidth * LaneWidth;
+	mTilesX = (mWidth + TileSize - 1) / TileSize;
+	mTilesY = (mHeight + TileSize - 1) / TileSize;
+
+	mDepth.assign(mRowPitch * mHeight, 1.0f);
+	mTileMaxDepth.assign(mTilesX * mTilesY, 1.0f);
+}
+
+void OcclusionBuffer::Clear(FXMMATRIX viewProj)
+{
+	XMStoreFloat4x4(&mViewProj, viewProj);
+
+	std::fill(mDepth.begin(), mDepth.end(), 1.0f);
+	std::fill(mTileMaxDepth.begin(), mTileMaxDepth.end(), 1.0f);
+	mTriangleCount = 0;
+}
+
+void OcclusionBuffer::RenderOccluder(const XMFLOAT3* positions, std::size_t positionStride,
+	std::size_t vertexCount, const std::uint32_t* indices, std::size_t indexCount, FXMMATRIX world)
+{
+	XMMATRIX worldViewProj = XMMatrixMultiply(world, XMLoadFloat4x4(&mViewProj));
+
+	mClipVertices.resize(vertexCount);
+	for (std::size_t i = 0; i < vertexCount; ++i)
+	{
+		const XMFLOAT3* p = (const XMFLOAT3*)((const BYTE*)positions + i * positionStride);
+		XMStoreFloat4(&mClipVertices[i], XMVector3Transform(XMLoadFloat3(p), worldViewProj));
+	}
+
+	for (std::size_t i = 0; i + 3 <= indexCount; i += 3)
+	{
+		const std::uint32_t i0 = indices[i + 0];
+		const std::uint32_t i1 = indices[i + 1];
+		const std::uint32_t i2 = indices[i + 2];
+		if (i0 < vertexCount && i1 < vertexCount && i2 < vertexCount)
+			RenderClipTriangle(mClipVertices[i0], mClipVertices[i1], mClipVertices[i2]);
+	}
+}
+
+void OcclusionBuffer::RenderOccluderBox(const BoundingBox& box, FXMMATRIX world)
+{
+	XMFLOAT3 corners[8];
+	BoxCorners(box, corners);
+	RenderOccluder(corners, sizeof(XMFLOAT3), 8, BoxIndices, 36, world);
+}
+
+void OcclusionBuffer::RenderClipTriangle(const XMFLOAT4& a, const XMFLOAT4& b, const XMFLOAT4& c)
+{
+	// Sutherland-Hodgman against the near plane and the guard band; each plane can add
+	// one vertex to the polygon.
+	XMFLOAT4 polygons[2][8] = { { a, b, c } };
+	int count = 3;
+	int current = 0;
+
+	for (int p = 0; p < 5; ++p)
+	{
+		const XMFLOAT4* in = polygons[current];
+		XMFLOAT4* out = polygons[current ^ 1];
+
+		float dist[8];
+		bool anyOutside = false;
+		for (int i = 0; i < count; ++i)
+		{
+			dist[i] = ClipDistance(in[i], p);
+			anyOutside |= dist[i] < 0.0f;
+		}
+		if (!anyOutside)
+			continue;
+
+		int outCount = 0;
+		for (int i = 0; i < count; ++i)
+		{
+			const int j = (i + 1) % count;
+			if (dist[i] >= 0.0f)
+				out[outCount++] = in[i];
+			if ((dist[i] >= 0.0f) != (dist[j] >= 0.0f))
+				out[outCount++] = Lerp(in[i], in[j], dist[i] / (dist[i] - dist[j]));
+		}
+
+		count = outCount;
+		current ^= 1;
+		if (count < 3)
+			return;
+	}
+
+	// To pixels, y down, with z / w for depth.
+	XMFLOAT3 screen[8];
+	for (int i = 0; i < count; ++i)
+	{
+		const XMFLOAT4& v = polygons[current][i];
+		const float invW = 1.0f / v.w;
+		screen[i] = XMFLOAT3(
+			(v.x * invW + 1.0f) * 0.5f * mWidth,
+			(1.0f - v.y * invW) * 0.5f * mHeight,
+			v.z * invW);
+	}
+
+	for (int i = 1; i + 1 < count; ++i)
+	{
+		const XMFLOAT3 triangle[3] = { screen[0], screen[i], screen[i + 1] };
+		RasterizeTriangle(triangle);
+	}
+}
+
+void OcclusionBuffer::RasterizeTriangle(const XMFLOAT3 v[3])
+{
+	// Twice the area; positive for clockwise triangles on screen, which face the camera.
+	const float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+	if (!(area > 0.0f))
+		return;
+
+	const float minX = std::min<float>(v[0].x, std::min<float>(v[1].x, v[2].x));
+	const float maxX = std::max<float>(v[0].x, std::max<float>(v[1].x, v[2].x));
+	const float minY = std::min<float>(v[0].y, std::min<float>(v[1].y, v[2].y));
+	const float maxY = std::max<float>(v[0].y, std::max<float>(v[1].y, v[2].y));
+
+	int x0 = std::max<int>(0, (int)std::floor(minX));
+	const int x1 = std::min<int>((int)mWidth, (int)std::ceil(maxX));
+	const int y0 = std::max<int>(0, (int)std::floor(minY));
+	const int y1 = std::min<int>((int)mHeight, (int)std::ceil(maxY));
+	if (x0 >= x1 || y0 >= y1)
+		return;
+
+	++mTriangleCount;
+
+	// Edge i runs from v[i] to v[i + 1]; A x + B y + C is its cross product with the
+	// pixel centre, positive on the inner side.
+	float A[3], B[3], C[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		const XMFLOAT3& p = v[i];
+		const XMFLOAT3& q = v[(i + 1) % 3];
+		A[i] = p.y - q.y;
+		B[i] = q.x - p.x;
+		C[i] = -(A[i] * p.x + B[i] * p.y);
+	}
+
+	// Depth is a plane over the screen: each vertex weighted by the edge opposite it.
+	const float invArea = 1.0f / area;
+	const float zA = (A[1] * v[0].z + A[2] * v[1].z + A[0] * v[2].z) * invArea;
+	const float zB = (B[1] * v[0].z + B[2] * v[1].z + B[0] * v[2].z) * invArea;
+	const float zC = (C[1] * v[0].z + C[2] * v[1].z + C[0] * v[2].z) * invArea;
+
+	static const float pixelCentres[8] = { 0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f };
+	const Lane centres = LaneLoad(pixelCentres);
+	const Lane zero = LaneSet(0.0f);
+
+	const Lane a0 = LaneSet(A[0]);
+	const Lane a1 = LaneSet(A[1]);
+	const Lane a2 = LaneSet(A[2]);
+	const Lane az = LaneSet(zA);
+
+	// Rows are padded to whole lanes, so a lane starting at or after x0 never runs
+	// past the end of its row.
+	x0 -= x0 % LaneWidth;
+
+	for (int y = y0; y < y1; ++y)
+	{
+		const float py = y + 0.5f;
+		const Lane e0Row = LaneSet(B[0] * py + C[0]);
+		const Lane e1Row = LaneSet(B[1] * py + C[1]);
+		const Lane e2Row = LaneSet(B[2] * py + C[2]);
+		const Lane zRow = LaneSet(zB * py + zC);
+
+		float* row = &mDepth[y * mRowPitch];
+		for (int x = x0; x < x1; x += LaneWidth)
+		{
+			const Lane px = LaneAdd(LaneSet((float)x), centres);
+
+			const Lane e0 = LaneAdd(LaneMul(a0, px), e0Row);
+			const Lane e1 = LaneAdd(LaneMul(a1, px), e1Row);
+			const Lane e2 = LaneAdd(LaneMul(a2, px), e2Row);
+			const Lane z = LaneAdd(LaneMul(az, px), zRow);
+
+			const LaneMask outside = LaneOr(LaneOr(LaneLess(e0, zero), LaneLess(e1, zero)), LaneLess(e2, zero));
+
+			const Lane depth = LaneLoad(row + x);
+			LaneStore(row + x, LaneSelect(outside, depth, LaneMin(depth, z)));
+		}
+	}
+}
+
+void OcclusionBuffer::FinishOccluders()
+{
+	for (UINT ty = 0; ty < mTilesY; ++ty)
+	{
+		for (UINT tx = 0; tx < mTilesX; ++tx)
+		{
+			const UINT xEnd = std::min<UINT>(mWidth, (tx + 1) * TileSize);
+			const UINT yEnd = std::min<UINT>(mHeight, (ty + 1) * TileSize);
+
+			float maxDepth = 0.0f;
+			for (UINT y = ty * TileSize; y < yEnd; ++y)
+			{
+				for (UINT x = tx * TileSize; x < xEnd; ++x)
+					maxDepth = std::max<float>(maxDepth, mDepth[y * mRowPitch + x]);
+			}
+
+			mTileMaxDepth[ty * mTilesX + tx] = maxDepth;
+		}
+	}
+}
+
+bool OcclusionBuffer::IsVisible(const BoundingBox& worldBox) const
+{
+	XMMATRIX viewProj = XMLoadFloat4x4(&mViewProj);
+
+	XMFLOAT3 corners[8];
+	BoxCorners(worldBox, corners);
+
+	float minX = +1e30f, maxX = -1e30f;
+	float minY = +1e30f, maxY = -1e30f;
+	float nearestZ = 1.0f;
+	for (int i = 0; i < 8; ++i)
+	{
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector3Transform(XMLoadFloat3(&corners[i]), viewProj));
+
+		// Crossing the near plane: the rectangle would be unbounded.
+		if (clip.z < 0.0f || clip.w <= 0.0f)
+			return true;
+
+		const float invW = 1.0f / clip.w;
+		const float x = (clip.x * invW + 1.0f) * 0.5f * mWidth;
+		const float y = (1.0f - clip.y * invW) * 0.5f * mHeight;
+
+		minX = std::min<float>(minX, x);
+		maxX = std::max<float>(maxX, x);
+		minY = std::min<float>(minY, y);
+		maxY = std::max<float>(maxY, y);
+		nearestZ = std::min<float>(nearestZ, clip.z * invW);
+	}
+
+	// Every pixel the rectangle touches.
+	const int x0 = std::max<int>(0, (int)std::floor(minX));
+	const int x1 = std::min<int>((int)mWidth, (int)std::ceil(maxX));
+	const int y0 = std::max<int>(0, (int)std::floor(minY));
+	const int y1 = std::min<int>((int)mHeight, (int)std::ceil(maxY));
+	if (x0 >= x1 || y0 >= y1)
+		return false;
+
+	for (int ty = y0 / (int)TileSize; ty <= (y1 - 1) / (int)TileSize; ++ty)
+	{
+		for (int tx = x0 / (int)TileSize; tx <= (x1 - 1) / (int)TileSize; ++tx)
+		{
+			if (mTileMaxDepth[ty * mTilesX + tx] < nearestZ)
+				continue;
+
+			const int xBegin = std::max<int>(x0, tx * (int)TileSize);
+			const int xEnd = std::min<int>(x1, (tx + 1) * (int)TileSize);
+			const int yBegin = std::max<int>(y0, ty * (int)TileSize);
+			const int yEnd = std::min<int>(y1, (ty + 1) * (int)TileSize);
+
+			for (int y = yBegin; y < yEnd; ++y)
+			{
+				for (int x = xBegin; x < xEnd; ++x)
+				{
+					if (mDepth[y * mRowPitch + x] >= nearestZ)
+						return true;
+				}
+			}
+		}
+	}
+
+	return false;
+}
+
+bool OcclusionBuffer::SaveDepthImage(const std::string& filename) const
+{
+	std::ofstream fout(filename, std::ios::binary);
+	if (!fout)
+		return false;
+
+	// Stretch the occluders' depth range over the grey levels; z / w crowds toward 1.
+	float nearest = 1.0f;
+	float farthest = 0.0f;
+	for (UINT y = 0; y < mHeight; ++y)
+	{
+		for (UINT x = 0; x < mWidth; ++x)
+		{
+			const float d = Depth(x, y);
+			if (d < 1.0f)
+			{
+				nearest = std::min<float>(nearest, d);
+				farthest = std::max<float>(farthest, d);
+			}
+		}
+	}
+	const float scale = farthest > nearest ? 200.0f / (farthest - nearest) : 0.0f;
+
+	std::vector<BYTE> pixels(mWidth * mHeight);
+	for (UINT y = 0; y < mHeight; ++y)
+	{
+		for (UINT x = 0; x < mWidth; ++x)
+		{
+			const float d = Depth(x, y);
+			pixels[y * mWidth + x] = d < 1.0f ? (BYTE)(255.0f - (d - nearest) * scale) : 0;
+		}
+	}
+
+	fout << "P5\n" << mWidth << " " << mHeight << "\n255\n";
+	fout.write((const char*)pixels.data(), pixels.size());
+	return (bool)fout;
+}
+
+bool ComputeInteriorBox(const XMFLOAT3* positions, std::size_t positionStride,
+	std::size_t vertexCount, const std::uint32_t* indices, std::size_t indexCount,
+	BoundingBox& interior)
+{
+	auto position = [&](std::uint32_t i) -> const XMFLOAT3&
+	{
+		return *(const XMFLOAT3*)((const BYTE*)positions + i * positionStride);
+	};
+
+	const std::size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return false;
+
+	for (std::size_t i = 0; i < 3 * triangleCount; ++i)
+	{
+		if (indices[i] >= vertexCount)
+			return false;
+	}
+
+	// Bounds of each triangle and of the whole mesh.
+	std::vector<XMFLOAT3> triMin(triangleCount);
+	std::vector<XMFLOAT3> triMax(triangleCount);
+	XMFLOAT3 meshMin(+1e30f, +1e30f, +1e30f);
+	XMFLOAT3 meshMax(-1e30f, -1e30f, -1e30f);
+	for (std::size_t t = 0; t < triangleCount; ++t)
+	{
+		const XMFLOAT3& a = position(indices[3 * t + 0]);
+		const XMFLOAT3& b = position(indices[3 * t + 1]);
+		const XMFLOAT3& c = position(indices[3 * t + 2]);
+
+		triMin[t] = XMFLOAT3(std::min<float>(a.x, std::min<float>(b.x, c.x)), std::min<float>(a.y, std::min<float>(b.y, c.y)), std::min<float>(a.z, std::min<float>(b.z, c.z)));
+		triMax[t] = XMFLOAT3(std::max<float>(a.x, std::max<float>(b.x, c.x)), std::max<float>(a.y, std::max<float>(b.y, c.y)), std::max<float>(a.z, std::max<float>(b.z, c.z)));
+
+		meshMin = XMFLOAT3(std::min<float>(meshMin.x, triMin[t].x), std::min<float>(meshMin.y, triMin[t].y), std::min<float>(meshMin.z, triMin[t].z));
+		meshMax = XMFLOAT3(std::max<float>(meshMax.x, triMax[t].x), std::max<float>(meshMax.y, triMax[t].y), std::max<float>(meshMax.z, triMax[t].z));
+	}
+
+	const float meshCentre[3] = { 0.5f * (meshMin.x + meshMax.x), 0.5f * (meshMin.y + meshMax.y), 0.5f * (meshMin.z + meshMax.z) };
+	const float meshExtent[3] = { 0.5f * (meshMax.x - meshMin.x), 0.5f * (meshMax.y - meshMin.y), 0.5f * (meshMax.z - meshMin.z) };
+	if (meshExtent[0] <= 0.0f || meshExtent[1] <= 0.0f || meshExtent[2] <= 0.0f)
+		return false;
+
+	// Times a ray from o along +axis crosses the surface: odd inside a closed mesh.
+	auto crossings = [&](const float o[3], int axis)
+	{
+		const int u = (axis + 1) % 3;
+		const int v = (axis + 2) % 3;
+
+		int count = 0;
+		for (std::size_t t = 0; t < triangleCount; ++t)
+		{
+			if (Component(triMax[t])[axis] < o[axis] ||
+				Component(triMin[t])[u] > o[u] || Component(triMax[t])[u] < o[u] ||
+				Component(triMin[t])[v] > o[v] || Component(triMax[t])[v] < o[v])
+			{
+				continue;
+			}
+
+			const float* p[3] = { Component(position(indices[3 * t + 0])),
+				Component(position(indices[3 * t + 1])), Component(position(indices[3 * t + 2])) };
+
+			// Barycentric coordinates of o projected along the axis.
+			const float det = (p[1][u] - p[0][u]) * (p[2][v] - p[0][v]) - (p[2][u] - p[0][u]) * (p[1][v] - p[0][v]);
+			if (det == 0.0f)
+				continue;
+
+			const float b1 = ((o[u] - p[0][u]) * (p[2][v] - p[0][v]) - (p[2][u] - p[0][u]) * (o[v] - p[0][v])) / det;
+			const float b2 = ((p[1][u] - p[0][u]) * (o[v] - p[0][v]) - (o[u] - p[0][u]) * (p[1][v] - p[0][v])) / det;
+			if (b1 < 0.0f || b2 < 0.0f || b1 + b2 > 1.0f)
+				continue;
+
+			const float hit = p[0][axis] + b1 * (p[1][axis] - p[0][axis]) + b2 * (p[2][axis] - p[0][axis]);
+			if (hit > o[axis])
+				++count;
+		}
+		return count;
+	};
+
+	// Try centres on a grid over the middle of the bounds; keep the largest box.
+	float bestVolume = 0.0f;
+	for (int k = -1; k <= 1; ++k)
+	{
+		for (int j = -1; j <= 1; ++j)
+		{
+			for (int i = -1; i <= 1; ++i)
+			{
+				const int step[3] = { i, j, k };
+				float centre[3];
+				for (int a = 0; a < 3; ++a)
+					centre[a] = meshCentre[a] + 0.25f * step[a] * meshExtent[a];
+
+				int oddAxes = 0;
+				for (int a = 0; a < 3; ++a)
+					oddAxes += crossings(centre, a) & 1;
+				if (oddAxes < 2)
+					continue;
+
+				// The box centre +- s * meshExtent meets a triangle's bounds once s reaches,
+				// on every axis, the gap between them.
+				float scale = 1.0f;
+				for (std::size_t t = 0; t < triangleCount; ++t)
+				{
+					float reach = -1e30f;
+					for (int a = 0; a < 3; ++a)
+					{
+						const float gap = std::max<float>(Component(triMin[t])[a] - centre[a], centre[a] - Component(triMax[t])[a]);
+						reach = std::max<float>(reach, gap / meshExtent[a]);
+					}
+					scale = std::min<float>(scale, reach);
+				}
+				if (scale <= 0.0f)
+					continue;
+
+				float extent[3] = { scale * meshExtent[0], scale * meshExtent[1], scale * meshExtent[2] };
+
+				// Then stretch one axis at a time as far as the triangles that overlap the
+				// box on the other two allow.
+				for (int a = 0; a < 3; ++a)
+				{
+					const int u = (a + 1) % 3;
+					const int v = (a + 2) % 3;
+
+					float limit = meshExtent[a];
+					for (std::size_t t = 0; t < triangleCount; ++t)
+					{
+						if (Component(triMin[t])[u] > centre[u] + extent[u] || Component(triMax[t])[u] < centre[u] - extent[u] ||
+							Component(triMin[t])[v] > centre[v] + extent[v] || Component(triMax[t])[v] < centre[v] - extent[v])
+						{
+							continue;
+						}
+
+						limit = std::min<float>(limit, std::max<float>(Component(triMin[t])[a] - centre[a], centre[a] - Component(triMax[t])[a]));
+					}
+					extent[a] = std::max<float>(extent[a], limit);
+				}
+
+				const float volume = extent[0] * extent[1] * extent[2];
+				if (volume > bestVolume)
+				{
+					bestVolume = volume;
+					interior = BoundingBox(XMFLOAT3(centre[0], centre[1], centre[2]), XMFLOAT3(extent[0], extent[1], extent[2]));
+				}
+			}
+		}
+	}
+
+	return bestVolume > 0.0f;
+}
@@ -0,0 +1,104 @@
+//***************************************************************************************
+// OcclusionCulling.h
+//
+// CPU occlusion culling.  A few large, nearby objects (the occluders) are rasterized
+// into a small depth buffer, and every other object's screen-space bounds are tested
+// against it before the object is drawn:
+//
+//   1. Clear sets the camera and resets the buffer to the far plane.
+//   2. RenderOccluder / RenderOccluderBox rasterize closed meshes, LaneWidth pixels of
+//      a row at a time, keeping the nearest depth per pixel.  Occluders should be
+//      simple and lie inside the objects they stand for (see ComputeInteriorBox), so
+//      they never hide something the real mesh would not.
+//   3. FinishOccluders records the farthest depth of each TileSize x TileSize tile.
+//   4. IsVisible projects a box, then compares its nearest depth with the tiles under
+//      its screen rectangle, looking at single pixels only where a tile is not wholly
+//      in front of it.
+//
+// Depths are z / w after the projection (0 at the near plane, 1 at the far plane).
+// Coverage is sampled at pixel centres, so an object can be reported hidden while a
+// sliver of it less than a pixel wide would show at an occluder's edge; at the default
+// 256 x 128 that is hard to see.  A box crossing the near plane is always visible.
+// SaveDepthImage writes the buffer out for checking what the occluders covered.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <DirectXCollision.h>
+#include <DirectXMath.h>
+#include <string>
+#include <vector>
+
+#include "Platform.h"
+
+
+class OcclusionBuffer
+{
+public:
+	static const UINT TileSize = 8;
+
+	OcclusionBuffer(UINT width = 256, UINT height = 128);
+
+	void Resize(UINT width, UINT height);
+
+	UINT Width() const { return mWidth; }
+	UINT Height() const { return mHeight; }
+
+	// Starts a frame seen through viewProj (view * proj).
+	void Clear(DirectX::FXMMATRIX viewProj);
+
+	// Rasterizes a closed triangle list whose front faces are wound clockwise, like the
+	// apps' meshes; back faces are skipped.  positions points at the first vertex's
+	// position and positionStride is the size of a vertex.
+	void RenderOccluder(const DirectX::XMFLOAT3* positions, std::size_t positionStride,
+		std::size_t vertexCount, const std::uint32_t* indices, std::size_t indexCount,
+		DirectX::FXMMATRIX world);
+
+	// The twelve triangles of box (in the space world maps from).
+	void RenderOccluderBox(const DirectX::BoundingBox& box, DirectX::FXMMATRIX world);
+
+	// Call after the last occluder of the frame and before IsVisible.
+	void FinishOccluders();
+
+	// False if every pixel under the world-space box's screen rectangle holds an
+	// occluder nearer than the box's nearest point.  Safe to call from several threads.
+	bool IsVisible(const DirectX::BoundingBox& worldBox) const;
+
+	float Depth(UINT x, UINT y) const { return mDepth[y * mRowPitch + x]; }
+
+	// Occluder triangles rasterized since Clear, after clipping and back-face culling.
+	UINT OccluderTriangleCount() const { return mTriangleCount; }
+
+	// Writes the buffer as a binary PGM: the nearest occluder white, the farthest dark
+	// grey, and pixels no occluder touched black.
+	bool SaveDepthImage(const std::string& filename) const;
+
+private:
+	void RenderClipTriangle(const DirectX::XMFLOAT4& a, const DirectX::XMFLOAT4& b, const DirectX::XMFLOAT4& c);
+	void RasterizeTriangle(const DirectX::XMFLOAT3 v[3]);
+
+private:
+	UINT mWidth = 0;
+	UINT mHeight = 0;
+	UINT mRowPitch = 0;		// mWidth rounded up to whole lanes
+	UINT mTilesX = 0;
+	UINT mTilesY = 0;
+
+	std::vector<float> mDepth;
+	std::vector<float> mTileMaxDepth;
+
+	DirectX::XMFLOAT4X4 mViewProj;
+	std::vector<DirectX::XMFLOAT4> mClipVertices;
+
+	UINT mTriangleCount = 0;
+};
+
+// Looks for a large box, proportioned like the mesh's bounds, that lies wholly inside
+// the closed triangle list: its centre is inside the mesh and no triangle's bounds
+// reach into it.  Such a box is a cheap occluder for the mesh.  Returns false if none
+// was found.
+bool ComputeInteriorBox(const DirectX::XMFLOAT3* positions, std::size_t positionStride,
+	std::size_t vertexCount, const std::uint32_t* indices, std::size_t indexCount,
+	DirectX::BoundingBox& interior);
@@ -0,0 +1,24 @@
+//***************************************************************************************
+// Platform.h
+//
+// The Windows integer typedefs used by the CPU-side code (math, geometry, animation,
+// model loading).  On Windows these come from <windows.h>; elsewhere they are defined
+// here so those modules build without the Windows SDK.
+//***************************************************************************************
+
+#pragma once
+
+#if defined(_WIN32)
+
+#include <windows.h>
+
+#else
+
+#include <cstdint>
+
+typedef std::uint8_t BYTE;
+typedef std::uint16_t USHORT;
+typedef std::uint32_t UINT;
+typedef std::uint64_t UINT64;
+
+#endif
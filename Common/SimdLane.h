@@ -0,0 +1,97 @@
+//***************************************************************************************
+// SimdLane.h
+//
+// Thin wrappers over the widest float vector DirectXMath was configured for, so SoA
+// kernels (one element per lane) are written once.  With _XM_NO_INTRINSICS_ a lane
+// is a single float and the kernels compile to plain scalar loops.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <cmath>
+
+#if defined(_XM_AVX2_INTRINSICS_)
+using Lane = __m256;
+using LaneMask = __m256;
+constexpr int LaneWidth = 8;
+
+inline Lane LaneSet(float x) { return _mm256_set1_ps(x); }
+inline Lane LaneLoad(const float* p) { return _mm256_loadu_ps(p); }
+inline void LaneStore(float* p, Lane v) { _mm256_storeu_ps(p, v); }
+inline Lane LaneAdd(Lane a, Lane b) { return _mm256_add_ps(a, b); }
+inline Lane LaneSub(Lane a, Lane b) { return _mm256_sub_ps(a, b); }
+inline Lane LaneMul(Lane a, Lane b) { return _mm256_mul_ps(a, b); }
+inline Lane LaneDiv(Lane a, Lane b) { return _mm256_div_ps(a, b); }
+inline Lane LaneSqrt(Lane v) { return _mm256_sqrt_ps(v); }
+
+inline Lane LaneAbs(Lane v) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), v); }
+inline Lane LaneMin(Lane a, Lane b) { return _mm256_min_ps(a, b); }
+inline Lane LaneMax(Lane a, Lane b) { return _mm256_max_ps(a, b); }
+inline float LaneReduceMax(Lane v)
+{
+	__m128 m = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+	m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+	m = _mm_max_ss(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1)));
+	return _mm_cvtss_f32(m);
+}
+inline bool LaneAnyNotEqual(Lane a, Lane b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_NEQ_UQ)) != 0; }
+
+inline LaneMask LaneLess(Lane a, Lane b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+inline LaneMask LaneOr(LaneMask a, LaneMask b) { return _mm256_or_ps(a, b); }
+inline int LaneMaskBits(LaneMask m) { return _mm256_movemask_ps(m); }
+inline Lane LaneSelect(LaneMask m, Lane ifTrue, Lane ifFalse) { return _mm256_blendv_ps(ifFalse, ifTrue, m); }
+#elif defined(_XM_SSE_INTRINSICS_)
+using Lane = __m128;
+using LaneMask = __m128;
+constexpr int LaneWidth = 4;
+
+inline Lane LaneSet(float x) { return _mm_set1_ps(x); }
+inline Lane LaneLoad(const float* p) { return _mm_loadu_ps(p); }
+inline void LaneStore(float* p, Lane v) { _mm_storeu_ps(p, v); }
+inline Lane LaneAdd(Lane a, Lane b) { return _mm_add_ps(a, b); }
+inline Lane LaneSub(Lane a, Lane b) { return _mm_sub_ps(a, b); }
+inline Lane LaneMul(Lane a, Lane b) { return _mm_mul_ps(a, b); }
+inline Lane LaneDiv(Lane a, Lane b) { return _mm_div_ps(a, b); }
+inline Lane LaneSqrt(Lane v) { return _mm_sqrt_ps(v); }
+
+inline Lane LaneAbs(Lane v) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), v); }
+inline Lane LaneMin(Lane a, Lane b) { return _mm_min_ps(a, b); }
+inline Lane LaneMax(Lane a, Lane b) { return _mm_max_ps(a, b); }
+inline float LaneReduceMax(Lane v)
+{
+	__m128 m = _mm_max_ps(v, _mm_movehl_ps(v, v));
+	m = _mm_max_ss(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1)));
+	return _mm_cvtss_f32(m);
+}
+inline bool LaneAnyNotEqual(Lane a, Lane b) { return _mm_movemask_ps(_mm_cmpneq_ps(a, b)) != 0; }
+
+inline LaneMask LaneLess(Lane a, Lane b) { return _mm_cmplt_ps(a, b); }
+inline LaneMask LaneOr(LaneMask a, LaneMask b) { return _mm_or_ps(a, b); }
+inline int LaneMaskBits(LaneMask m) { return _mm_movemask_ps(m); }
+inline Lane LaneSelect(LaneMask m, Lane ifTrue, Lane ifFalse) { return _mm_or_ps(_mm_and_ps(m, ifTrue), _mm_andnot_ps(m, ifFalse)); }
+#else
+using Lane = float;
+using LaneMask = bool;
+constexpr int LaneWidth = 1;
+
+inline Lane LaneSet(float x) { return x; }
+inline Lane LaneLoad(const float* p) { return *p; }
+inline void LaneStore(float* p, Lane v) { *p = v; }
+inline Lane LaneAdd(Lane a, Lane b) { return a + b; }
+inline Lane LaneSub(Lane a, Lane b) { return a - b; }
+inline Lane LaneMul(Lane a, Lane b) { return a * b; }
+inline Lane LaneDiv(Lane a, Lane b) { return a / b; }
+inline Lane LaneSqrt(Lane v) { return sqrtf(v); }
+
+inline Lane LaneAbs(Lane v) { return fabsf(v); }
+inline Lane LaneMin(Lane a, Lane b) { return a < b ? a : b; }
+inline Lane LaneMax(Lane a, Lane b) { return a > b ? a : b; }
+inline float LaneReduceMax(Lane v) { return v; }
+inline bool LaneAnyNotEqual(Lane a, Lane b) { return a != b; }
+
+inline LaneMask LaneLess(Lane a, Lane b) { return a < b; }
+inline LaneMask LaneOr(LaneMask a, LaneMask b) { return a || b; }
+inline int LaneMaskBits(LaneMask m) { return m ? 1 : 0; }
+inline Lane LaneSelect(LaneMask m, Lane ifTrue, Lane ifFalse) { return m ? ifTrue : ifFalse; }
+#endif
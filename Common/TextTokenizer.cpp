@@ -0,0 +1,118 @@
+//***************************************************************************************
+// TextTokenizer.cpp
+//***************************************************************************************
+
+#include "TextTokenizer.h"
+
+#include <charconv>
+
+
+namespace
+{
+	inline bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+	}
+}
+
+bool TextTokenizer::Open(const std::string& filename)
+{
+	if (!mFile.Open(filename))
+	{
+		Reset(nullptr, nullptr);
+		mFailed = true;
+		return false;
+	}
+
+	const char* text = (const char*)mFile.Data();
+	Reset(text, text + mFile.Size());
+	return true;
+}
+
+void TextTokenizer::Reset(const char* first, const char* last)
+{
+	mPos = first;
+	mEnd = last;
+	mFailed = false;
+}
+
+std::string_view TextTokenizer::NextToken()
+{
+	while (mPos != mEnd && IsSpace(*mPos))
+		++mPos;
+
+	const char* first = mPos;
+	while (mPos != mEnd && !IsSpace(*mPos))
+		++mPos;
+
+	if (first == mPos)
+		mFailed = true;
+
+	return std::string_view(first, mPos - first);
+}
+
+TextTokenizer& TextTokenizer::Skip(int count)
+{
+	for (int i = 0; i < count; ++i)
+		NextToken();
+	return *this;
+}
+
+template<typename T>
+TextTokenizer& TextTokenizer::ReadNumber(T& value)
+{
+	if (mFailed)
+		return *this;
+
+	std::string_view token = NextToken();
+
+	// The whole token has to be the number, as ">>" followed by whitespace would need.
+	T parsed;
+	std::from_chars_result result = std::from_chars(token.data(), token.data() + token.size(), parsed);
+	if (result.ec != std::errc() || result.ptr != token.data() + token.size())
+		mFailed = true;
+	else
+		value = parsed;
+
+	return *this;
+}
+
+TextTokenizer& TextTokenizer::operator>>(float& value)
+{
+	return ReadNumber(value);
+}
+
+TextTokenizer& TextTokenizer::operator>>(int& value)
+{
+	return ReadNumber(value);
+}
+
+TextTokenizer& TextTokenizer::operator>>(UINT& value)
+{
+	return ReadNumber(value);
+}
+
+TextTokenizer& TextTokenizer::operator>>(USHORT& value)
+{
+	return ReadNumber(value);
+}
+
+TextTokenizer& TextTokenizer::operator>>(bool& value)
+{
+	int number = 0;
+	ReadNumber(number);
+	if (!mFailed)
+		value = number != 0;
+	return *this;
+}
+
+TextTokenizer& TextTokenizer::operator>>(std::string& value)
+{
+	if (mFailed)
+		return *this;
+
+	std::string_view token = NextToken();
+	if (!mFailed)
+		value.assign(token.data(), token.size());
+	return *this;
+}
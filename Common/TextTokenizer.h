@@ -0,0 +1,57 @@
+//***************************************************************************************
+// TextTokenizer.h
+//
+// Whitespace-separated token reader for the text model formats (.m3d, skull.txt,
+// car.txt).  The file is mapped in one go and numbers are converted in place with
+// std::from_chars, so a token costs neither a heap allocation nor a trip through the
+// stream locale, which is where std::ifstream >> spends most of its time on these
+// files.
+//
+// Extraction follows the iostream idiom the loaders were written in:
+//
+//     tokens.Skip() >> v.x >> v.y >> v.z;     // "Position: x y z"
+//
+// and, as with a stream, a failed read leaves the tokenizer failed (operator bool)
+// and later reads do nothing.
+//***************************************************************************************
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "MappedFile.h"
+
+
+class TextTokenizer
+{
+public:
+	bool Open(const std::string& filename);
+
+	// Tokenizes [first, last), which must stay alive while it is read.
+	void Reset(const char* first, const char* last);
+
+	explicit operator bool() const { return !mFailed; }
+
+	// Skips count tokens (labels such as "#Materials" or "Position:").
+	TextTokenizer& Skip(int count = 1);
+
+	// The next token; empty (and failed) at the end of the text.
+	std::string_view NextToken();
+
+	TextTokenizer& operator>>(float& value);
+	TextTokenizer& operator>>(int& value);
+	TextTokenizer& operator>>(UINT& value);
+	TextTokenizer& operator>>(USHORT& value);
+	TextTokenizer& operator>>(bool& value);
+	TextTokenizer& operator>>(std::string& value);
+
+private:
+	template<typename T>
+	TextTokenizer& ReadNumber(T& value);
+
+	MappedFile mFile;
+	const char* mPos = nullptr;
+	const char* mEnd = nullptr;
+	bool mFailed = false;
+};
@@ -0,0 +1,205 @@
+//***************************************************************************************
+// ThreadPool.cpp
+//***************************************************************************************
+
+#include "ThreadPool.h"
+#include <algorithm>
+
+
+namespace
+{
+	std::atomic<TaskScheduler*> gTaskScheduler{ nullptr };
+
+	// Lets a thread find its own queue when it calls back into the pool that owns it.
+	thread_local const void* tCurrentPool = nullptr;
+	thread_local int tCurrentQueue = -1;
+}
+
+void SerialScheduler::ParallelFor(int begin, int end, int grainSize, const RangeTask& task)
+{
+	if (end <= begin)
+		return;
+
+	if (grainSize <= 0)
+		grainSize = end - begin;
+
+	for (int first = begin; first < end; first += grainSize)
+	{
+		task(first, std::min(first + grainSize, end));
+	}
+}
+
+ThreadPool::ThreadPool(int workerCount)
+{
+	if (workerCount <= 0)
+	{
+		int hardwareThreads = (int)std::thread::hardware_concurrency();
+		workerCount = std::max(hardwareThreads - 1, 0);
+	}
+
+	for (int i = 0; i < workerCount + 1; ++i)
+	{
+		mQueues.push_back(std::make_unique<WorkQueue>());
+	}
+
+	for (int i = 0; i < workerCount; ++i)
+	{
+		mWorkers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mWakeMutex);
+		mShutdown = true;
+	}
+	mWakeCondition.notify_all();
+
+	for (auto& worker : mWorkers)
+	{
+		worker.join();
+	}
+}
+
+void ThreadPool::ParallelFor(int begin, int end, int grainSize, const RangeTask& task)
+{
+	const int count = end - begin;
+	if (count <= 0)
+		return;
+
+	// Default to a few tiles per thread so stealing can even out the load.
+	if (grainSize <= 0)
+	{
+		int targetTiles = ConcurrencyLevel() * 4;
+		grainSize = std::max((count + targetTiles - 1) / targetTiles, 1);
+	}
+
+	const int tileCount = (count + grainSize - 1) / grainSize;
+
+	// Not worth waking anybody up.
+	if (tileCount == 1 || mWorkers.empty())
+	{
+		for (int first = begin; first < end; first += grainSize)
+		{
+			task(first, std::min(first + grainSize, end));
+		}
+		return;
+	}
+
+	const int ownQueue = (tCurrentPool == this) ? tCurrentQueue : (int)mQueues.size() - 1;
+
+	Job job;
+	job.Task = &task;
+	job.RemainingTiles.store(tileCount, std::memory_order_relaxed);
+
+	// Deal the tiles out round-robin, starting with our own queue so the first
+	// tiles are picked up by the calling thread.
+	const int queueCount = (int)mQueues.size();
+	for (int t = 0; t < tileCount; ++t)
+	{
+		Tile tile;
+		tile.Owner = &job;
+		tile.First = begin + t * grainSize;
+		tile.Last = std::min(tile.First + grainSize, end);
+
+		WorkQueue& queue = *mQueues[(ownQueue + t) % queueCount];
+		std::lock_guard<std::mutex> lock(queue.Mutex);
+		queue.Tiles.push_back(tile);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mWakeMutex);
+		mQueuedTiles.fetch_add(tileCount, std::memory_order_relaxed);
+	}
+	mWakeCondition.notify_all();
+
+	// Help out until our own job is done.  We may end up running tiles of other
+	// jobs too, which is what keeps nested ParallelFor calls from deadlocking.
+	while (job.RemainingTiles.load(std::memory_order_acquire) > 0)
+	{
+		Tile tile;
+		if (TryGetTile(ownQueue, tile))
+			RunTile(tile);
+		else
+			std::this_thread::yield();
+	}
+}
+
+void ThreadPool::WorkerLoop(int queueIndex)
+{
+	tCurrentPool = this;
+	tCurrentQueue = queueIndex;
+
+	for (;;)
+	{
+		Tile tile;
+		if (TryGetTile(queueIndex, tile))
+		{
+			RunTile(tile);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(mWakeMutex);
+		mWakeCondition.wait(lock, [this]
+			{
+				return mShutdown || mQueuedTiles.load(std::memory_order_relaxed) > 0;
+			});
+
+		if (mShutdown && mQueuedTiles.load(std::memory_order_relaxed) <= 0)
+			return;
+	}
+}
+
+bool ThreadPool::TryGetTile(int queueIndex, Tile& tile)
+{
+	const int queueCount = (int)mQueues.size();
+	for (int i = 0; i < queueCount; ++i)
+	{
+		WorkQueue& queue = *mQueues[(queueIndex + i) % queueCount];
+		std::lock_guard<std::mutex> lock(queue.Mutex);
+		if (queue.Tiles.empty())
+			continue;
+
+		// Our own tiles are taken in order; stolen ones from the far end so the
+		// owner keeps working on neighbouring (cache-warm) rows.
+		if (i == 0)
+		{
+			tile = queue.Tiles.front();
+			queue.Tiles.pop_front();
+		}
+		else
+		{
+			tile = queue.Tiles.back();
+			queue.Tiles.pop_back();
+		}
+
+		mQueuedTiles.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	return false;
+}
+
+void ThreadPool::RunTile(const Tile& tile)
+{
+	(*tile.Owner->Task)(tile.First, tile.Last);
+
+	// Must be the last access to the job; the owner may return as soon as it sees zero.
+	tile.Owner->RemainingTiles.fetch_sub(1, std::memory_order_release);
+}
+
+TaskScheduler& GetTaskScheduler()
+{
+	TaskScheduler* scheduler = gTaskScheduler.load(std::memory_order_acquire);
+	if (scheduler != nullptr)
+		return *scheduler;
+
+	static ThreadPool defaultPool;
+	return defaultPool;
+}
+
+void SetTaskScheduler(TaskScheduler* scheduler)
+{
+	gTaskScheduler.store(scheduler, std::memory_order_release);
+}
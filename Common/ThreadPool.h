@@ -0,0 +1,113 @@
+//***************************************************************************************
+// ThreadPool.h
+//
+// Portable data-parallel loops for the CPU-side code in Common.  Work is expressed as a
+// half-open index range that is cut into tiles of consecutive indices (for example,
+// blocks of grid rows); each tile is handed to the body as [first, last) so the body
+// runs a plain serial loop over it.
+//
+// ParallelFor dispatches to the current TaskScheduler.  By default this is a shared
+// std::thread pool with per-worker deques and work stealing; tools that want
+// deterministic single-threaded execution can install a SerialScheduler instead.
+//***************************************************************************************
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Processes the indices [first, last).
+using RangeTask = std::function<void(int first, int last)>;
+
+
+class TaskScheduler
+{
+public:
+	virtual ~TaskScheduler() = default;
+
+	// Runs task over [begin, end) in tiles of grainSize indices and returns once every
+	// tile has finished.  A grainSize <= 0 lets the scheduler pick the tile size.
+	virtual void ParallelFor(int begin, int end, int grainSize, const RangeTask& task) = 0;
+
+	// Number of threads that may execute tiles concurrently, including the caller.
+	virtual int ConcurrencyLevel() const = 0;
+};
+
+
+class SerialScheduler : public TaskScheduler
+{
+public:
+	void ParallelFor(int begin, int end, int grainSize, const RangeTask& task) override;
+	int ConcurrencyLevel() const override { return 1; }
+};
+
+
+class ThreadPool : public TaskScheduler
+{
+public:
+	// workerCount == 0 spawns one worker per hardware thread, minus the calling thread.
+	explicit ThreadPool(int workerCount = 0);
+	ThreadPool(const ThreadPool& rhs) = delete;
+	ThreadPool& operator=(const ThreadPool& rhs) = delete;
+	~ThreadPool();
+
+	void ParallelFor(int begin, int end, int grainSize, const RangeTask& task) override;
+	int ConcurrencyLevel() const override { return (int)mWorkers.size() + 1; }
+
+private:
+	struct Job
+	{
+		const RangeTask* Task = nullptr;
+		std::atomic<int> RemainingTiles{ 0 };
+	};
+
+	struct Tile
+	{
+		Job* Owner = nullptr;
+		int First = 0;
+		int Last = 0;
+	};
+
+	struct WorkQueue
+	{
+		std::mutex Mutex;
+		std::deque<Tile> Tiles;
+	};
+
+	void WorkerLoop(int queueIndex);
+
+	// Pops from the front of our own queue, otherwise steals from the back of another.
+	bool TryGetTile(int queueIndex, Tile& tile);
+	void RunTile(const Tile& tile);
+
+private:
+	// One queue per worker plus a last one owned by threads outside the pool.
+	std::vector<std::unique_ptr<WorkQueue>> mQueues;
+	std::vector<std::thread> mWorkers;
+
+	std::mutex mWakeMutex;
+	std::condition_variable mWakeCondition;
+	std::atomic<int> mQueuedTiles{ 0 };
+	bool mShutdown = false;
+};
+
+
+// Returns the scheduler used by ParallelFor; a process-wide ThreadPool unless one
+// was installed with SetTaskScheduler.
+TaskScheduler& GetTaskScheduler();
+
+// Installs scheduler for subsequent ParallelFor calls.  Pass nullptr to go back to the
+// default pool.  The caller keeps ownership and must not destroy it while in use.
+void SetTaskScheduler(TaskScheduler* scheduler);
+
+inline void ParallelFor(int begin, int end, int grainSize, const RangeTask& task)
+{
+	GetTaskScheduler().ParallelFor(begin, end, grainSize, task);
+}
@@ -0,0 +1,444 @@
+//***************************************************************************************
+// TriangleBvh.cpp
+//***************************************************************************************
+
+#include "TriangleBvh.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "ThreadPool.h"
+
+using namespace DirectX;
+
+
+namespace
+{
+	const int BinCount = 16;
+
+	// Traversing a node costs about as much as testing one triangle.
+	const float TraversalCost = 1.0f;
+
+	// Subtrees of up to this many triangles are built in parallel.
+	const UINT ParallelBuildTriangles = 16384;
+
+	struct Box
+	{
+		float Min[3] = { +FLT_MAX, +FLT_MAX, +FLT_MAX };
+		float Max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		void Grow(const float min[3], const float max[3])
+		{
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				Min[axis] = std::min<float>(Min[axis], min[axis]);
+				Max[axis] = std::max<float>(Max[axis], max[axis]);
+			}
+		}
+
+		void Grow(const Box& b) { Grow(b.Min, b.Max); }
+
+		float HalfArea() const
+		{
+			if (Min[0] > Max[0])
+				return 0.0f;
+
+			float dx = Max[0] - Min[0];
+			float dy = Max[1] - Min[1];
+			float dz = Max[2] - Min[2];
+			return dx * dy + dy * dz + dz * dx;
+		}
+	};
+
+	struct Bin
+	{
+		Box Bounds;
+		UINT Count = 0;
+	};
+
+	const XMFLOAT3& Position(const XMFLOAT3* positions, std::size_t stride, std::uint32_t index)
+	{
+		return *reinterpret_cast<const XMFLOAT3*>(reinterpret_cast<const BYTE*>(positions) + index * stride);
+	}
+
+	int BinIndex(float centroid, float lo, float scale)
+	{
+		return std::min<int>(BinCount - 1, (int)((centroid - lo) * scale));
+	}
+}
+
+// A triangle's bounds and centroid, moved rather than referred to while the build
+// partitions, so each pass over a node reads memory in order.
+struct TriangleBvh::BuildTriangle
+{
+	Box Bounds;
+	float Centroid[3];
+	UINT Id;
+};
+
+struct TriangleBvh::BuildTask
+{
+	UINT Node;
+	UINT Begin;
+	UINT End;
+	int Depth;
+};
+
+bool TriangleBvh::Build(const XMFLOAT3* positions, std::size_t positionStride,
+	std::size_t vertexCount, const std::uint32_t* indices, std::size_t indexCount)
+{
+	Clear();
+
+	if (indexCount % 3 != 0)
+		return false;
+
+	for (std::size_t i = 0; i < indexCount; ++i)
+	{
+		if (indices[i] >= vertexCount)
+			return false;
+	}
+
+	const UINT triCount = (UINT)(indexCount / 3);
+	if (triCount == 0)
+		return true;
+
+	std::vector<BuildTriangle> tris(triCount);
+	for (UINT i = 0; i < triCount; ++i)
+	{
+		BuildTriangle& tri = tris[i];
+		for (int k = 0; k < 3; ++k)
+		{
+			const XMFLOAT3& p = Position(positions, positionStride, indices[3 * i + k]);
+			const float v[3] = { p.x, p.y, p.z };
+			tri.Bounds.Grow(v, v);
+		}
+
+		for (int axis = 0; axis < 3; ++axis)
+			tri.Centroid[axis] = 0.5f * (tri.Bounds.Min[axis] + tri.Bounds.Max[axis]);
+		tri.Id = i;
+	}
+
+	// A binary tree with at least one triangle per leaf has fewer than 2n nodes.
+	mNodes.reserve(2 * triCount);
+	mNodes.emplace_back();
+
+	std::vector<BuildTask> deferred;
+	BuildNodes(tris, mNodes, { 0, 0, triCount, 0 }, &deferred);
+
+	// The deferred subtrees cover disjoint runs of tris.  Each is built into its own
+	// array, rooted at index 0, and then spliced in: its root replaces the node that was
+	// deferred and the rest are appended, with the inner nodes' children moved along.
+	std::vector<std::vector<Node>> subtrees(deferred.size());
+	ParallelFor(0, (int)deferred.size(), 1, [&](int first, int last)
+		{
+			for (int k = first; k < last; ++k)
+			{
+				BuildTask task = deferred[k];
+				task.Node = 0;
+
+				subtrees[k].reserve(2 * (task.End - task.Begin));
+				subtrees[k].emplace_back();
+				BuildNodes(tris, subtrees[k], task, nullptr);
+			}
+		});
+
+	for (std::size_t k = 0; k < subtrees.size(); ++k)
+	{
+		const UINT offset = (UINT)mNodes.size() - 1;
+		auto relocate = [offset](Node node)
+		{
+			if (node.Count == 0)
+				node.First += offset;
+			return node;
+		};
+
+		mNodes[deferred[k].Node] = relocate(subtrees[k][0]);
+		for (std::size_t i = 1; i < subtrees[k].size(); ++i)
+			mNodes.push_back(relocate(subtrees[k][i]));
+	}
+
+	mTriangles.resize(triCount);
+	mTriangleIds.resize(triCount);
+	for (UINT i = 0; i < triCount; ++i)
+	{
+		const UINT id = tris[i].Id;
+		XMVECTOR v0 = XMLoadFloat3(&Position(positions, positionStride, indices[3 * id + 0]));
+		XMVECTOR v1 = XMLoadFloat3(&Position(positions, positionStride, indices[3 * id + 1]));
+		XMVECTOR v2 = XMLoadFloat3(&Position(positions, positionStride, indices[3 * id + 2]));
+
+		XMStoreFloat3(&mTriangles[i].V0, v0);
+		XMStoreFloat3(&mTriangles[i].Edge1, XMVectorSubtract(v1, v0));
+		XMStoreFloat3(&mTriangles[i].Edge2, XMVectorSubtract(v2, v0));
+		mTriangleIds[i] = id;
+	}
+
+	return true;
+}
+
+void TriangleBvh::BuildNodes(std::vector<BuildTriangle>& tris, std::vector<Node>& nodes,
+	const BuildTask& task, std::vector<BuildTask>* deferred)
+{
+	std::vector<BuildTask> stack;
+	stack.push_back(task);
+	while (!stack.empty())
+	{
+		const BuildTask entry = stack.back();
+		stack.pop_back();
+
+		const UINT count = entry.End - entry.Begin;
+		if (deferred != nullptr && count <= ParallelBuildTriangles)
+		{
+			deferred->push_back(entry);
+			continue;
+		}
+
+		Box nodeBounds;
+		Box centroidBounds;
+		for (UINT i = entry.Begin; i < entry.End; ++i)
+		{
+			nodeBounds.Grow(tris[i].Bounds);
+			centroidBounds.Grow(tris[i].Centroid, tris[i].Centroid);
+		}
+
+		Node& node = nodes[entry.Node];
+		node.Min = XMFLOAT3(nodeBounds.Min[0], nodeBounds.Min[1], nodeBounds.Min[2]);
+		node.Max = XMFLOAT3(nodeBounds.Max[0], nodeBounds.Max[1], nodeBounds.Max[2]);
+		node.First = entry.Begin;
+		node.Count = count;
+
+		// Intersects' stack holds at most one node per level below the root.
+		if (count == 1 || entry.Depth + 1 >= MaxDepth)
+			continue;
+
+		// Bin the centroids along all three axes in one pass.
+		float scale[3];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const float extent = centroidBounds.Max[axis] - centroidBounds.Min[axis];
+			scale[axis] = extent > 0.0f ? BinCount / extent : 0.0f;
+		}
+
+		Bin bins[3][BinCount];
+		for (UINT i = entry.Begin; i < entry.End; ++i)
+		{
+			const BuildTriangle& tri = tris[i];
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				Bin& bin = bins[axis][BinIndex(tri.Centroid[axis], centroidBounds.Min[axis], scale[axis])];
+				bin.Bounds.Grow(tri.Bounds);
+				++bin.Count;
+			}
+		}
+
+		// Find the cheapest bin boundary.  Costs are in units of triangle tests times
+		// half the surface area.
+		int bestAxis = -1;
+		int bestSplit = 0;
+		float bestCost = FLT_MAX;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			if (scale[axis] == 0.0f)
+				continue;
+
+			// Sweep from the right for the costs of the right-hand sides, then from the
+			// left to total each split.
+			float rightCosts[BinCount];
+			Box right;
+			UINT rightCount = 0;
+			for (int bin = BinCount - 1; bin > 0; --bin)
+			{
+				right.Grow(bins[axis][bin].Bounds);
+				rightCount += bins[axis][bin].Count;
+				rightCosts[bin] = right.HalfArea() * rightCount;
+			}
+
+			Box left;
+			UINT leftCount = 0;
+			for (int split = 1; split < BinCount; ++split)
+			{
+				left.Grow(bins[axis][split - 1].Bounds);
+				leftCount += bins[axis][split - 1].Count;
+				if (leftCount == 0 || leftCount == count)
+					continue;
+
+				const float cost = left.HalfArea() * leftCount + rightCosts[split];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = split;
+				}
+			}
+		}
+
+		UINT mid;
+		if (bestAxis >= 0)
+		{
+			const float leafCost = nodeBounds.HalfArea() * count;
+			const float splitCost = nodeBounds.HalfArea() * TraversalCost + bestCost;
+			if (splitCost >= leafCost && count <= MaxLeafTriangles)
+				continue;
+
+			const float lo = centroidBounds.Min[bestAxis];
+			const float axisScale = scale[bestAxis];
+			mid = (UINT)(std::partition(tris.begin() + entry.Begin, tris.begin() + entry.End,
+				[&](const BuildTriangle& tri)
+				{
+					return BinIndex(tri.Centroid[bestAxis], lo, axisScale) < bestSplit;
+				}) - tris.begin());
+		}
+		else
+		{
+			// Every centroid is the same point, so no plane separates the triangles;
+			// halve the list only to keep the leaves small.
+			if (count <= MaxLeafTriangles)
+				continue;
+
+			mid = entry.Begin + count / 2;
+		}
+
+		const UINT leftChild = (UINT)nodes.size();
+		nodes.emplace_back();
+		nodes.emplace_back();
+
+		nodes[entry.Node].First = leftChild;
+		nodes[entry.Node].Count = 0;
+
+		stack.push_back({ leftChild + 1, mid, entry.End, entry.Depth + 1 });
+		stack.push_back({ leftChild, entry.Begin, mid, entry.Depth + 1 });
+	}
+}
+
+void TriangleBvh::Clear()
+{
+	mNodes.clear();
+	mTriangles.clear();
+	mTriangleIds.clear();
+}
+
+bool TriangleBvh::Intersects(FXMVECTOR origin, FXMVECTOR direction, float& dist, UINT& triangle) const
+{
+	if (mNodes.empty())
+		return false;
+
+	XMFLOAT3 o, d;
+	XMStoreFloat3(&o, origin);
+	XMStoreFloat3(&d, direction);
+
+	// A zero component would make 0 * infinity in the slab test below.
+	auto inverse = [](float v) { return 1.0f / (std::fabs(v) > 1e-20f ? v : std::copysign(1e-20f, v)); };
+	const XMFLOAT3 invD(inverse(d.x), inverse(d.y), inverse(d.z));
+
+	float nearest = FLT_MAX;
+	UINT hitTriangle = 0;
+
+	// The distance along the ray where a node's box starts, or FLT_MAX if the ray
+	// misses it or reaches it only beyond the nearest hit so far.
+	auto boxEntry = [&](const Node& node)
+	{
+		float tx0 = (node.Min.x - o.x) * invD.x;
+		float tx1 = (node.Max.x - o.x) * invD.x;
+		float ty0 = (node.Min.y - o.y) * invD.y;
+		float ty1 = (node.Max.y - o.y) * invD.y;
+		float tz0 = (node.Min.z - o.z) * invD.z;
+		float tz1 = (node.Max.z - o.z) * invD.z;
+
+		float tEnter = std::max<float>(std::max<float>(std::min<float>(tx0, tx1), std::min<float>(ty0, ty1)), std::max<float>(std::min<float>(tz0, tz1), 0.0f));
+		float tExit = std::min<float>(std::min<float>(std::max<float>(tx0, tx1), std::max<float>(ty0, ty1)), std::max<float>(tz0, tz1));
+
+		return tEnter <= tExit && tEnter < nearest ? tEnter : FLT_MAX;
+	};
+
+	UINT stackNodes[MaxDepth];
+	float stackEntries[MaxDepth];
+	int stackSize = 0;
+
+	UINT index = 0;
+	if (boxEntry(mNodes[0]) == FLT_MAX)
+		return false;
+
+	for (;;)
+	{
+		const Node& node = mNodes[index];
+		if (node.Count > 0)
+		{
+			// Moller-Trumbore, accepting either winding.
+			for (UINT i = node.First; i < node.First + node.Count; ++i)
+			{
+				const Triangle& tri = mTriangles[i];
+
+				const XMFLOAT3 p(d.y * tri.Edge2.z - d.z * tri.Edge2.y,
+					d.z * tri.Edge2.x - d.x * tri.Edge2.z,
+					d.x * tri.Edge2.y - d.y * tri.Edge2.x);
+				const float det = tri.Edge1.x * p.x + tri.Edge1.y * p.y + tri.Edge1.z * p.z;
+				if (std::fabs(det) < 1e-20f)
+					continue;
+
+				const float invDet = 1.0f / det;
+				const XMFLOAT3 s(o.x - tri.V0.x, o.y - tri.V0.y, o.z - tri.V0.z);
+
+				const float u = (s.x * p.x + s.y * p.y + s.z * p.z) * invDet;
+				if (u < 0.0f || u > 1.0f)
+					continue;
+
+				const XMFLOAT3 q(s.y * tri.Edge1.z - s.z * tri.Edge1.y,
+					s.z * tri.Edge1.x - s.x * tri.Edge1.z,
+					s.x * tri.Edge1.y - s.y * tri.Edge1.x);
+
+				const float v = (d.x * q.x + d.y * q.y + d.z * q.z) * invDet;
+				if (v < 0.0f || u + v > 1.0f)
+					continue;
+
+				const float t = (tri.Edge2.x * q.x + tri.Edge2.y * q.y + tri.Edge2.z * q.z) * invDet;
+				if (t >= 0.0f && t < nearest)
+				{
+					nearest = t;
+					hitTriangle = mTriangleIds[i];
+				}
+			}
+		}
+		else
+		{
+			UINT nearChild = node.First;
+			UINT farChild = node.First + 1;
+			float nearEntry = boxEntry(mNodes[nearChild]);
+			float farEntry = boxEntry(mNodes[farChild]);
+			if (farEntry < nearEntry)
+			{
+				std::swap(nearChild, farChild);
+				std::swap(nearEntry, farEntry);
+			}
+
+			if (nearEntry != FLT_MAX)
+			{
+				if (farEntry != FLT_MAX)
+				{
+					stackNodes[stackSize] = farChild;
+					stackEntries[stackSize] = farEntry;
+					++stackSize;
+				}
+
+				index = nearChild;
+				continue;
+			}
+		}
+
+		// Take the next pushed node that still starts before the nearest hit.
+		do
+		{
+			if (stackSize == 0)
+			{
+				if (nearest == FLT_MAX)
+					return false;
+
+				dist = nearest;
+				triangle = hitTriangle;
+				return true;
+			}
+
+			--stackSize;
+			index = stackNodes[stackSize];
+		} while (stackEntries[stackSize] >= nearest);
+	}
+}
@@ -0,0 +1,87 @@
+//***************************************************************************************
+// TriangleBvh.h
+//
+// A bounding volume hierarchy over the triangles of one mesh, for ray picking.  Build
+// runs once, when the mesh is loaded:  each node's triangles are binned by centroid
+// along each axis, and the node is split at the bin boundary with the lowest surface
+// area heuristic cost (the children's areas times their triangle counts), or kept as
+// a leaf when no split is cheaper than testing its triangles.  The nodes are stored in
+// one array in the order they are made, a node's two children side by side, and each
+// triangle is copied out, in leaf order, as a corner and two edges, so a leaf's
+// triangles are read contiguously and need no index lookups.
+//
+// Build splits the top of the tree on the calling thread, then builds the subtrees
+// below a fixed size with ParallelFor; the split point does not depend on the thread
+// count, so neither does the tree.
+//
+// Intersects walks the tree with a small fixed stack, nearer child first, and skips
+// any node whose box starts beyond the nearest hit found so far, so a ray visits a few
+// dozen nodes whatever the triangle count.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Platform.h"
+
+
+class TriangleBvh
+{
+public:
+	// Nodes with more triangles than this are split even when the heuristic would keep
+	// them (short of the depth Intersects' stack allows).
+	static const UINT MaxLeafTriangles = 8;
+
+	// positions points at the first vertex's position and positionStride is the size
+	// of a vertex.  Triangle i is indices[3i..3i+2].  Returns false, leaving the tree
+	// empty, if indexCount is not a multiple of 3 or an index is out of range.
+	bool Build(const DirectX::XMFLOAT3* positions, std::size_t positionStride,
+		std::size_t vertexCount, const std::uint32_t* indices, std::size_t indexCount);
+
+	void Clear();
+
+	bool Empty() const { return mNodes.empty(); }
+	UINT NodeCount() const { return (UINT)mNodes.size(); }
+	UINT TriangleCount() const { return (UINT)mTriangleIds.size(); }
+
+	// Finds the nearest triangle, from either side, hit by the ray origin + t*direction
+	// with t >= 0.  On a hit, dist is that t (in units of direction's length) and
+	// triangle the hit triangle's index in the list Build was given.
+	bool Intersects(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float& dist, UINT& triangle) const;
+
+private:
+	struct Node
+	{
+		DirectX::XMFLOAT3 Min;
+		UINT First;			// the left child for an inner node, the first triangle for a leaf
+		DirectX::XMFLOAT3 Max;
+		UINT Count;			// 0 for an inner node
+	};
+
+	struct Triangle
+	{
+		DirectX::XMFLOAT3 V0;
+		DirectX::XMFLOAT3 Edge1;	// V1 - V0
+		DirectX::XMFLOAT3 Edge2;	// V2 - V0
+	};
+
+	struct BuildTriangle;
+	struct BuildTask;
+
+	static const int MaxDepth = 64;
+
+	// Builds the subtree of task into nodes, where task.Node already exists.  With
+	// deferred, nodes small enough to be built in parallel are left unbuilt and
+	// appended to it instead.
+	static void BuildNodes(std::vector<BuildTriangle>& tris, std::vector<Node>& nodes,
+		const BuildTask& task, std::vector<BuildTask>* deferred);
+
+private:
+	std::vector<Node> mNodes;
+	std::vector<Triangle> mTriangles;
+	std::vector<UINT> mTriangleIds;
+};
@@ -57,6 +57,28 @@ public:
 		memcpy(&mMappedData[elementIndex * mElementByteSize], &data, sizeof(T));
 	}
 
+	// Copies count consecutive elements starting at firstElement.  Elements are tightly
+	// packed unless this is a constant buffer, so the whole range is a single memcpy.
+	void CopyRange(int firstElement, const T* data, int count)
+	{
+		if (mElementByteSize == sizeof(T))
+		{
+			memcpy(&mMappedData[firstElement * mElementByteSize], data, count * sizeof(T));
+		}
+		else
+		{
+			for (int i = 0; i < count; ++i)
+				CopyData(firstElement + i, data[i]);
+		}
+	}
+
+	// Lets producers (e.g. worker threads) fill an element in place instead of building
+	// a copy first.  Write only: upload heaps are write-combined, so reads are slow.
+	T* MappedElement(int elementIndex)
+	{
+		return reinterpret_cast<T*>(&mMappedData[elementIndex * mElementByteSize]);
+	}
+
 private:
 	Microsoft::WRL::ComPtr<ID3D12Resource> mUploadBuffer;
 	BYTE* mMappedData = nullptr;
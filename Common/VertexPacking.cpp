@@ -0,0 +1,195 @@
+//***************************************************************************************
+// VertexPacking.cpp
+//***************************************************************************************
+
+#include "VertexPacking.h"
+
+#include <algorithm>
+#include <DirectXPackedVector.h>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+
+namespace
+{
+	inline float SignNotZero(float x)
+	{
+		return x >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	inline UINT EncodeSnorm16(float x)
+	{
+		x = std::min<float>(std::max<float>(x, -1.0f), 1.0f);
+		return (UINT)(std::uint16_t)(std::int16_t)std::lround(x * 32767.0f);
+	}
+
+	inline float DecodeSnorm16(UINT bits)
+	{
+		// -32768 and -32767 both mean -1, as on the GPU.
+		return std::max<float>((float)(std::int16_t)(std::uint16_t)bits / 32767.0f, -1.0f);
+	}
+}
+
+void VertexPackingError::Add(const VertexPackingError& rhs)
+{
+	NormalDegrees = std::max<float>(NormalDegrees, rhs.NormalDegrees);
+	TangentDegrees = std::max<float>(TangentDegrees, rhs.TangentDegrees);
+	TexCoord = std::max<float>(TexCoord, rhs.TexCoord);
+	BoneWeight = std::max<float>(BoneWeight, rhs.BoneWeight);
+}
+
+UINT EncodeOctahedral(const XMFLOAT3& v)
+{
+	const float l1 = std::fabs(v.x) + std::fabs(v.y) + std::fabs(v.z);
+	if (l1 == 0.0f)
+		return EncodeSnorm16(0.0f) | (EncodeSnorm16(0.0f) << 16);
+
+	float x = v.x / l1;
+	float y = v.y / l1;
+
+	// The lower hemisphere folds over the diagonals onto the corners of the square.
+	if (v.z < 0.0f)
+	{
+		const float fx = (1.0f - std::fabs(y)) * SignNotZero(x);
+		const float fy = (1.0f - std::fabs(x)) * SignNotZero(y);
+		x = fx;
+		y = fy;
+	}
+
+	return EncodeSnorm16(x) | (EncodeSnorm16(y) << 16);
+}
+
+XMFLOAT3 DecodeOctahedral(UINT packed)
+{
+	float x = DecodeSnorm16(packed & 0xffff);
+	float y = DecodeSnorm16(packed >> 16);
+	const float z = 1.0f - std::fabs(x) - std::fabs(y);
+
+	if (z < 0.0f)
+	{
+		const float t = -z;
+		x += x >= 0.0f ? -t : t;
+		y += y >= 0.0f ? -t : t;
+	}
+
+	XMFLOAT3 n;
+	XMStoreFloat3(&n, XMVector3Normalize(XMVectorSet(x, y, z, 0.0f)));
+	return n;
+}
+
+UINT EncodeHalf2(const XMFLOAT2& v)
+{
+	return (UINT)XMConvertFloatToHalf(v.x) | ((UINT)XMConvertFloatToHalf(v.y) << 16);
+}
+
+XMFLOAT2 DecodeHalf2(UINT packed)
+{
+	return XMFLOAT2(XMConvertHalfToFloat((HALF)(packed & 0xffff)), XMConvertHalfToFloat((HALF)(packed >> 16)));
+}
+
+UINT EncodeBoneWeights(const XMFLOAT3& weights)
+{
+	const float w[4] = { weights.x, weights.y, weights.z, 1.0f - weights.x - weights.y - weights.z };
+
+	int q[4];
+	int sum = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		q[i] = (int)std::lround(std::min<float>(std::max<float>(w[i], 0.0f), 1.0f) * 255.0f);
+		sum += q[i];
+	}
+
+	// Rounding can leave the total a few steps off 255; settle the difference on the
+	// weights whose rounding was furthest off, so the largest error stays under a step.
+	while (sum != 255)
+	{
+		const int step = sum > 255 ? -1 : 1;
+
+		int best = -1;
+		float bestError = 0.0f;
+		for (int i = 0; i < 4; ++i)
+		{
+			if (q[i] + step < 0 || q[i] + step > 255)
+				continue;
+
+			const float error = (q[i] - w[i] * 255.0f) * -step;
+			if (best < 0 || error > bestError)
+			{
+				best = i;
+				bestError = error;
+			}
+		}
+
+		q[best] += step;
+		sum += step;
+	}
+
+	return (UINT)q[0] | ((UINT)q[1] << 8) | ((UINT)q[2] << 16) | ((UINT)q[3] << 24);
+}
+
+XMFLOAT3 DecodeBoneWeights(UINT packed)
+{
+	return XMFLOAT3(
+		(float)(packed & 0xff) / 255.0f,
+		(float)((packed >> 8) & 0xff) / 255.0f,
+		(float)((packed >> 16) & 0xff) / 255.0f);
+}
+
+PackedVertex PackVertex(const GeometryGenerator::Vertex& v)
+{
+	PackedVertex p;
+	p.Pos = v.Position;
+	p.Normal = EncodeOctahedral(v.Normal);
+	p.TangentU = EncodeOctahedral(v.TangentU);
+	p.TexC = EncodeHalf2(v.TexC);
+	return p;
+}
+
+GeometryGenerator::Vertex UnpackVertex(const PackedVertex& p)
+{
+	GeometryGenerator::Vertex v;
+	v.Position = p.Pos;
+	v.Normal = DecodeOctahedral(p.Normal);
+	v.TangentU = DecodeOctahedral(p.TangentU);
+	v.TexC = DecodeHalf2(p.TexC);
+	return v;
+}
+
+std::vector<PackedVertex> PackVertices(const std::vector<GeometryGenerator::Vertex>& vertices)
+{
+	std::vector<PackedVertex> packed(vertices.size());
+	for (std::size_t i = 0; i < vertices.size(); ++i)
+		packed[i] = PackVertex(vertices[i]);
+	return packed;
+}
+
+VertexPackingError MeasurePackingError(const std::vector<GeometryGenerator::Vertex>& vertices,
+	const std::vector<PackedVertex>& packed)
+{
+	VertexPackingError error;
+	for (std::size_t i = 0; i < vertices.size() && i < packed.size(); ++i)
+	{
+		const GeometryGenerator::Vertex& v = vertices[i];
+		const GeometryGenerator::Vertex u = UnpackVertex(packed[i]);
+
+		VertexPackingError e;
+		e.NormalDegrees = AngleErrorDegrees(v.Normal, u.Normal);
+		e.TangentDegrees = AngleErrorDegrees(v.TangentU, u.TangentU);
+		e.TexCoord = std::max<float>(std::fabs(v.TexC.x - u.TexC.x), std::fabs(v.TexC.y - u.TexC.y));
+		error.Add(e);
+	}
+	return error;
+}
+
+float AngleErrorDegrees(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+	XMVECTOR u = XMVector3Normalize(XMLoadFloat3(&a));
+	XMVECTOR v = XMVector3Normalize(XMLoadFloat3(&b));
+
+	// atan2 of |u x v| and u.v stays accurate for the tiny angles measured here,
+	// where acos of the dot product would round to zero.
+	const float sine = XMVectorGetX(XMVector3Length(XMVector3Cross(u, v)));
+	const float cosine = XMVectorGetX(XMVector3Dot(u, v));
+	return XMConvertToDegrees(std::atan2(sine, cosine));
+}
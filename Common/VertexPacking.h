@@ -0,0 +1,157 @@
+//***************************************************************************************
+// VertexPacking.h
+//
+// Compact encodings of the vertex formats, for meshes whose vertex fetch or memory
+// footprint matters more than exact attributes:
+//
+//   normals, tangents   octahedral, two snorm16 (DXGI_FORMAT_R16G16_SNORM): the unit
+//                       vector is projected onto an octahedron and unfolded into a
+//                       square.  Worst case error ~0.004 degrees.
+//   texture coordinates two halves (DXGI_FORMAT_R16G16_FLOAT).  Within 1/4096 in
+//                       [0, 1]; the error grows with the magnitude for tiled UVs.
+//   bone weights        four unorm8 (DXGI_FORMAT_R8G8B8A8_UNORM) summing to exactly
+//                       255, so the fourth weight the shader derives stays consistent.
+//                       Each is within one step (1/255) of the original.
+//
+// PackedVertex is 24 bytes against GeometryGenerator::Vertex's 44, PackedSkinnedVertex
+// 32 against M3DLoader::SkinnedVertex's 60.  Positions stay full precision.  A shader
+// reading them decodes the octahedral vectors itself:
+//
+//     float3 DecodeOctahedral(float2 e)
+//     {
+//         float3 n = float3(e.xy, 1.0f - abs(e.x) - abs(e.y));
+//         float t = saturate(-n.z);
+//         n.xy += n.xy >= 0.0f ? -t : t;
+//         return normalize(n);
+//     }
+//
+// The Decode functions do the same on the CPU, and MeasurePackingError reports what a
+// mesh lost, to check a model before switching it over.
+//***************************************************************************************
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <DirectXMath.h>
+#include <vector>
+
+#include "GeometryGenerator.h"
+#include "Platform.h"
+
+
+struct PackedVertex
+{
+	DirectX::XMFLOAT3 Pos;
+	UINT Normal;
+	UINT TangentU;
+	UINT TexC;
+};
+
+struct PackedSkinnedVertex
+{
+	DirectX::XMFLOAT3 Pos;
+	UINT Normal;
+	UINT TexC;
+	UINT TangentU;
+	UINT BoneWeights;
+	BYTE BoneIndices[4];
+};
+
+// Largest differences between a mesh and its packed form.
+struct VertexPackingError
+{
+	float NormalDegrees = 0.0f;
+	float TangentDegrees = 0.0f;
+	float TexCoord = 0.0f;		// per component
+	float BoneWeight = 0.0f;	// per weight, including the implied fourth
+
+	void Add(const VertexPackingError& rhs);
+};
+
+UINT EncodeOctahedral(const DirectX::XMFLOAT3& v);
+DirectX::XMFLOAT3 DecodeOctahedral(UINT packed);
+
+UINT EncodeHalf2(const DirectX::XMFLOAT2& v);
+DirectX::XMFLOAT2 DecodeHalf2(UINT packed);
+
+// The first three weights; the fourth is whatever is left of 1.
+UINT EncodeBoneWeights(const DirectX::XMFLOAT3& weights);
+DirectX::XMFLOAT3 DecodeBoneWeights(UINT packed);
+
+PackedVertex PackVertex(const GeometryGenerator::Vertex& v);
+GeometryGenerator::Vertex UnpackVertex(const PackedVertex& v);
+
+std::vector<PackedVertex> PackVertices(const std::vector<GeometryGenerator::Vertex>& vertices);
+
+VertexPackingError MeasurePackingError(const std::vector<GeometryGenerator::Vertex>& vertices,
+	const std::vector<PackedVertex>& packed);
+
+// Angle between two directions, in degrees.
+float AngleErrorDegrees(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b);
+
+// For skinned vertex types with Pos, Normal, TexC, TangentU (XMFLOAT3), BoneWeights
+// (XMFLOAT3) and BoneIndices[4], such as M3DLoader::SkinnedVertex.
+template<typename V>
+PackedSkinnedVertex PackSkinnedVertex(const V& v)
+{
+	PackedSkinnedVertex p;
+	p.Pos = v.Pos;
+	p.Normal = EncodeOctahedral(v.Normal);
+	p.TexC = EncodeHalf2(v.TexC);
+	p.TangentU = EncodeOctahedral(v.TangentU);
+	p.BoneWeights = EncodeBoneWeights(v.BoneWeights);
+	for (int i = 0; i < 4; ++i)
+		p.BoneIndices[i] = v.BoneIndices[i];
+	return p;
+}
+
+template<typename V>
+V UnpackSkinnedVertex(const PackedSkinnedVertex& p)
+{
+	V v;
+	v.Pos = p.Pos;
+	v.Normal = DecodeOctahedral(p.Normal);
+	v.TexC = DecodeHalf2(p.TexC);
+	v.TangentU = DecodeOctahedral(p.TangentU);
+	v.BoneWeights = DecodeBoneWeights(p.BoneWeights);
+	for (int i = 0; i < 4; ++i)
+		v.BoneIndices[i] = p.BoneIndices[i];
+	return v;
+}
+
+template<typename V>
+std::vector<PackedSkinnedVertex> PackSkinnedVertices(const std::vector<V>& vertices)
+{
+	std::vector<PackedSkinnedVertex> packed(vertices.size());
+	for (std::size_t i = 0; i < vertices.size(); ++i)
+		packed[i] = PackSkinnedVertex(vertices[i]);
+	return packed;
+}
+
+template<typename V>
+VertexPackingError MeasureSkinnedPackingError(const std::vector<V>& vertices,
+	const std::vector<PackedSkinnedVertex>& packed)
+{
+	VertexPackingError error;
+	for (std::size_t i = 0; i < vertices.size() && i < packed.size(); ++i)
+	{
+		const V& v = vertices[i];
+		const V u = UnpackSkinnedVertex<V>(packed[i]);
+
+		VertexPackingError e;
+		e.NormalDegrees = AngleErrorDegrees(v.Normal, u.Normal);
+		e.TangentDegrees = AngleErrorDegrees(v.TangentU, u.TangentU);
+		e.TexCoord = std::fmax(std::fabs(v.TexC.x - u.TexC.x), std::fabs(v.TexC.y - u.TexC.y));
+
+		const float w[4] = { v.BoneWeights.x, v.BoneWeights.y, v.BoneWeights.z,
+			1.0f - v.BoneWeights.x - v.BoneWeights.y - v.BoneWeights.z };
+		const float q[4] = { u.BoneWeights.x, u.BoneWeights.y, u.BoneWeights.z,
+			1.0f - u.BoneWeights.x - u.BoneWeights.y - u.BoneWeights.z };
+		for (int k = 0; k < 4; ++k)
+			e.BoneWeight = std::fmax(e.BoneWeight, std::fabs(w[k] - q[k]));
+
+		error.Add(e);
+	}
+	return error;
+}
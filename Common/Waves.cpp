@@ -3,13 +3,28 @@
 //***************************************************************************************
 
 #include "Waves.h"
-#include <ppl.h>
+#include "SimdLane.h"
+#include "ThreadPool.h"
 #include <algorithm>
 #include <vector>
 #include <cassert>
+#include <cmath>
 
 using namespace DirectX;
 
+namespace
+{
+	// Rows handed to a worker at a time.  One row of a 128-wide grid is only a few
+	// hundred flops, so scheduling single rows costs more than it saves.
+	constexpr int RowsPerTile = 16;
+
+	// A row whose heights are all below this for two consecutive steps is flushed
+	// to zero, so calm water settles exactly and stops being reported as changed.
+	// Flushing whole quiet rows (rather than single small heights) matters: zeroing
+	// one point of a moving wave kicks its velocity and keeps the surface ringing.
+	constexpr float SettleHeight = 1.0e-4f;
+}
+
 Waves::Waves(int m, int n, float dx, float dt, float speed, float damping)
 {
 	mNumRows = m;
@@ -27,27 +42,31 @@ Waves::Waves(int m, int n, float dx, float dt, float speed, float damping)
 	mK2 = (4.0f - 8.0f * e) / d;
 	mK3 = (2.0f * e) / d;
 
-	mPrevSolution.resize(m * n);
-	mCurrSolution.resize(m * n);
-	mNormals.resize(m * n);
-	mTangentX.resize(m * n);
+	mGridX.resize(n);
+	mGridZ.resize(m);
+
+	mPrevHeights.assign(m * n, 0.0f);
+	mCurrHeights.assign(m * n, 0.0f);
+	mNormalsX.assign(m * n, 0.0f);
+	mNormalsY.assign(m * n, 1.0f);
+	mNormalsZ.assign(m * n, 0.0f);
+	mTangentsX.assign(m * n, 1.0f);
+	mTangentsY.assign(m * n, 0.0f);
+
+	mRowChanged.assign(m, 0);
+	mRowVersions.assign(m, mVersion);
 
-	// Generate grid vertices in system memory.
+	// Generate grid coordinates in system memory.
 
 	float halfWidth = (n - 1) * dx * 0.5f;
 	float halfDepth = (m - 1) * dx * 0.5f;
 	for (int i = 0; i < m; ++i)
 	{
-		float z = halfDepth - i * dx;
-		for (int j = 0; j < n; ++j)
-		{
-			float x = -halfWidth + j * dx;
-
-			mPrevSolution[i * n + j] = XMFLOAT3(x, 0.0f, z);
-			mCurrSolution[i * n + j] = XMFLOAT3(x, 0.0f, z);
-			mNormals[i * n + j] = XMFLOAT3(0.0f, 1.0f, 0.0f);
-			mTangentX[i * n + j] = XMFLOAT3(1.0f, 0.0f, 0.0f);
-		}
+		mGridZ[i] = halfDepth - i * dx;
+	}
+	for (int j = 0; j < n; ++j)
+	{
+		mGridX[j] = -halfWidth + j * dx;
 	}
 }
 
@@ -85,74 +104,240 @@ float Waves::Depth() const
 	return mNumRows * mSpatialStep;
 }
 
-void Waves::Update(float dt)
+void Waves::SetMaxSubsteps(int maxSubsteps)
 {
-	static float t = 0;
+	assert(maxSubsteps > 0);
+	mMaxSubsteps = maxSubsteps;
+}
 
+float Waves::InterpolationAlpha() const
+{
+	return mAccumulator / mTimeStep;
+}
+
+void Waves::Update(float dt)
+{
 	// Accumulate time.
-	t += dt;
+	mAccumulator += dt;
 
-	// Only update the simulation at the specified time step.
-	if (t >= mTimeStep)
+	// Only update the simulation at the specified time step, catching up with
+	// as many steps as have elapsed since the last call.
+	int substeps = 0;
+	while (mAccumulator >= mTimeStep && substeps < mMaxSubsteps)
 	{
-		// Only update interior points; we use zero boundary conditions.
-		concurrency::parallel_for(1, mNumRows - 1,
-			// for(int i = 1; i < mNumRows-1; ++i)
-			[this](int i)
-			{
-				for (int j = 1; j < mNumCols - 1; ++j)
-				{
-					// After this update we will be discarding the old previous buffer,
-					// so overwrite that buffer with the new update.
-					// Note how we can do this inplace (read/write to same element) 
-					// because we won't need prev_ij again and the assignment happens last.
-
-					// Note j indexes x and i indexes z: h(x_j, z_i, t_k)
-					// Moreover, our +z axis goes "down"; this is just to 
-					// keep consistent with our row indices going down.
-
-					mPrevSolution[i * mNumCols + j].y =
-						mK1 * mPrevSolution[i * mNumCols + j].y +
-						mK2 * mCurrSolution[i * mNumCols + j].y +
-						mK3 * (mCurrSolution[(i + 1) * mNumCols + j].y +
-							mCurrSolution[(i - 1) * mNumCols + j].y +
-							mCurrSolution[i * mNumCols + j + 1].y +
-							mCurrSolution[i * mNumCols + j - 1].y);
-				}
-			});
-
-		// We just overwrote the previous buffer with the new data, so
-		// this data needs to become the current solution and the old
-		// current solution becomes the new previous solution.
-		std::swap(mPrevSolution, mCurrSolution);
-
-		t = 0.0f; // reset time
-
-		//
-		// Compute normals using finite difference scheme.
-		//
-		concurrency::parallel_for(1, mNumRows - 1,
-			// for(int i = 1; i < mNumRows - 1; ++i)
-			[this](int i)
+		Step();
+		mAccumulator -= mTimeStep;
+		++substeps;
+	}
+
+	// If we hit the cap (e.g. after a long stall) drop the backlog rather than
+	// trying to pay it back over the next frames, but keep the fractional part
+	// so the interpolation alpha stays continuous.
+	if (mAccumulator >= mTimeStep)
+	{
+		mAccumulator = fmodf(mAccumulator, mTimeStep);
+	}
+}
+
+void Waves::Step()
+{
+	++mVersion;
+
+	// Only update interior points; we use zero boundary conditions.
+	//
+	// The new heights are integrated and their normals computed in a single
+	// sweep: each tile of rows computes the normals of row i-1 right after
+	// integrating row i, while the rows involved are still in cache.
+	const int interiorRows = mNumRows - 2;
+	const int tileCount = (interiorRows + RowsPerTile - 1) / RowsPerTile;
+
+	ParallelFor(0, tileCount, 1,
+		[this](int firstTile, int lastTile)
+		{
+			for (int tile = firstTile; tile < lastTile; ++tile)
+				StepTile(tile);
+		});
+
+	// The first and last rows of a tile need new heights from the neighbouring
+	// tile, so their normals are only computed once every tile has finished.
+	ParallelFor(1, tileCount, 0,
+		[this](int firstTile, int lastTile)
+		{
+			for (int tile = firstTile; tile < lastTile; ++tile)
 			{
-				for (int j = 1; j < mNumCols - 1; ++j)
-				{
-					float l = mCurrSolution[i * mNumCols + j - 1].y;
-					float r = mCurrSolution[i * mNumCols + j + 1].y;
-					float t = mCurrSolution[(i - 1) * mNumCols + j].y;
-					float b = mCurrSolution[(i + 1) * mNumCols + j].y;
-					mNormals[i * mNumCols + j].x = -r + l;
-					mNormals[i * mNumCols + j].y = 2.0f * mSpatialStep;
-					mNormals[i * mNumCols + j].z = b - t;
-
-					XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&mNormals[i * mNumCols + j]));
-					XMStoreFloat3(&mNormals[i * mNumCols + j], n);
-
-					mTangentX[i * mNumCols + j] = XMFLOAT3(2.0f * mSpatialStep, r - l, 0.0f);
-					XMVECTOR T = XMVector3Normalize(XMLoadFloat3(&mTangentX[i * mNumCols + j]));
-					XMStoreFloat3(&mTangentX[i * mNumCols + j], T);
-				}
-			});
+				int seam = 1 + tile * RowsPerTile;
+				ComputeNormalsRow(seam - 1, mPrevHeights.data());
+				ComputeNormalsRow(seam, mPrevHeights.data());
+			}
+		});
+
+	// We just overwrote the previous buffer with the new data, so
+	// this data needs to become the current solution and the old
+	// current solution becomes the new previous solution.
+	std::swap(mPrevHeights, mCurrHeights);
+
+	// A row's vertices change if its own heights changed or if a neighbouring
+	// row did, since that moves the normals.
+	for (int i = 1; i < mNumRows - 1; ++i)
+	{
+		if (mRowChanged[i - 1] || mRowChanged[i] || mRowChanged[i + 1])
+			mRowVersions[i] = mVersion;
+	}
+}
+
+void Waves::StepTile(int tile)
+{
+	const int first = 1 + tile * RowsPerTile;
+	const int last = std::min(first + RowsPerTile, mNumRows - 1);
+
+	// The new solution is written into the previous buffer (see IntegrateRow).
+	const float* next = mPrevHeights.data();
+
+	for (int i = first; i < last; ++i)
+	{
+		mRowChanged[i] = IntegrateRow(i);
+
+		// Row i-1 now has new heights on both sides; the row above the tile is
+		// only available if it is the fixed boundary row.
+		int r = i - 1;
+		if (r > first || (r == first && first == 1))
+			ComputeNormalsRow(r, next);
+	}
+
+	// The last row of the last tile borders the fixed boundary row.
+	if (last == mNumRows - 1 && (last - 1 > first || first == 1))
+		ComputeNormalsRow(last - 1, next);
+}
+
+bool Waves::IntegrateRow(int i)
+{
+	// After this update we will be discarding the old previous buffer,
+	// so overwrite that buffer with the new update.
+	// Note how we can do this inplace (read/write to same element) 
+	// because we won't need prev_ij again and the assignment happens last.
+
+	// Note j indexes x and i indexes z: h(x_j, z_i, t_k)
+	// Moreover, our +z axis goes "down"; this is just to 
+	// keep consistent with our row indices going down.
+
+	float* prev = &mPrevHeights[i * mNumCols];
+	const float* curr = &mCurrHeights[i * mNumCols];
+	const float* up = curr - mNumCols;
+	const float* down = curr + mNumCols;
+
+	const Lane k1 = LaneSet(mK1);
+	const Lane k2 = LaneSet(mK2);
+	const Lane k3 = LaneSet(mK3);
+
+	bool changed = false;
+	Lane peakNext = LaneSet(0.0f);
+	Lane peakCurr = LaneSet(0.0f);
+
+	int j = 1;
+	for (; j + LaneWidth <= mNumCols - 1; j += LaneWidth)
+	{
+		Lane neighbors = LaneAdd(LaneAdd(LaneAdd(
+			LaneLoad(down + j), LaneLoad(up + j)),
+			LaneLoad(curr + j + 1)), LaneLoad(curr + j - 1));
+
+		Lane next = LaneAdd(LaneAdd(
+			LaneMul(k1, LaneLoad(prev + j)),
+			LaneMul(k2, LaneLoad(curr + j))),
+			LaneMul(k3, neighbors));
+
+		Lane c = LaneLoad(curr + j);
+		changed |= LaneAnyNotEqual(next, c);
+		peakNext = LaneMax(peakNext, LaneAbs(next));
+		peakCurr = LaneMax(peakCurr, LaneAbs(c));
+
+		LaneStore(prev + j, next);
+	}
+
+	float maxNext = LaneReduceMax(peakNext);
+	float maxCurr = LaneReduceMax(peakCurr);
+
+	// Scalar tail for the columns that do not fill a whole lane.
+	for (; j < mNumCols - 1; ++j)
+	{
+		float next =
+			mK1 * prev[j] +
+			mK2 * curr[j] +
+			mK3 * (down[j] + up[j] + curr[j + 1] + curr[j - 1]);
+
+		changed |= (next != curr[j]);
+		maxNext = std::max(maxNext, fabsf(next));
+		maxCurr = std::max(maxCurr, fabsf(curr[j]));
+
+		prev[j] = next;
+	}
+
+	// Settle a quiet row.  Only our own output row is touched; the current heights
+	// are still being read by the neighbouring rows.
+	if (maxNext > 0.0f && maxNext < SettleHeight && maxCurr < SettleHeight)
+	{
+		std::fill(prev + 1, prev + mNumCols - 1, 0.0f);
+		changed = (maxCurr > 0.0f);
+	}
+
+	return changed;
+}
+
+void Waves::ComputeNormalsRow(int i, const float* heights)
+{
+	// Compute normals using finite difference scheme.
+	const int row = i * mNumCols;
+	const float* curr = &heights[row];
+	const float* top = curr - mNumCols;
+	const float* bottom = curr + mNumCols;
+
+	float* nx = &mNormalsX[row];
+	float* ny = &mNormalsY[row];
+	float* nz = &mNormalsZ[row];
+	float* tx = &mTangentsX[row];
+	float* ty = &mTangentsY[row];
+
+	// The unnormalized normal is (l - r, 2dx, b - t) and the unnormalized
+	// tangent is (2dx, r - l, 0).
+	const float twoDx = 2.0f * mSpatialStep;
+	const Lane vTwoDx = LaneSet(twoDx);
+	const Lane vTwoDxSq = LaneSet(twoDx * twoDx);
+	const Lane one = LaneSet(1.0f);
+
+	int j = 1;
+	for (; j + LaneWidth <= mNumCols - 1; j += LaneWidth)
+	{
+		Lane l = LaneLoad(curr + j - 1);
+		Lane r = LaneLoad(curr + j + 1);
+		Lane t = LaneLoad(top + j);
+		Lane b = LaneLoad(bottom + j);
+
+		Lane dx = LaneSub(l, r);
+		Lane dz = LaneSub(b, t);
+		Lane dxSq = LaneMul(dx, dx);
+
+		Lane invLenN = LaneDiv(one, LaneSqrt(LaneAdd(LaneAdd(dxSq, vTwoDxSq), LaneMul(dz, dz))));
+		LaneStore(nx + j, LaneMul(dx, invLenN));
+		LaneStore(ny + j, LaneMul(vTwoDx, invLenN));
+		LaneStore(nz + j, LaneMul(dz, invLenN));
+
+		Lane invLenT = LaneDiv(one, LaneSqrt(LaneAdd(vTwoDxSq, dxSq)));
+		LaneStore(tx + j, LaneMul(vTwoDx, invLenT));
+		LaneStore(ty + j, LaneMul(LaneSub(r, l), invLenT));
+	}
+
+	for (; j < mNumCols - 1; ++j)
+	{
+		float dx = curr[j - 1] - curr[j + 1];
+		float dz = bottom[j] - top[j];
+
+		float invLenN = 1.0f / sqrtf(dx * dx + twoDx * twoDx + dz * dz);
+		nx[j] = dx * invLenN;
+		ny[j] = twoDx * invLenN;
+		nz[j] = dz * invLenN;
+
+		float invLenT = 1.0f / sqrtf(twoDx * twoDx + dx * dx);
+		tx[j] = twoDx * invLenT;
+		ty[j] = -dx * invLenT;
 	}
 }
 
@@ -165,10 +350,16 @@ void Waves::Disturb(int i, int j, float magnitude)
 	float halfMag = 0.5f * magnitude;
 
 	// Disturb the ijth vertex height and its neighbors.
-	mCurrSolution[i * mNumCols + j].y += magnitude;
-	mCurrSolution[i * mNumCols + j + 1].y += halfMag;
-	mCurrSolution[i * mNumCols + j - 1].y += halfMag;
-	mCurrSolution[(i + 1) * mNumCols + j].y += halfMag;
-	mCurrSolution[(i - 1) * mNumCols + j].y += halfMag;
+	mCurrHeights[i * mNumCols + j] += magnitude;
+	mCurrHeights[i * mNumCols + j + 1] += halfMag;
+	mCurrHeights[i * mNumCols + j - 1] += halfMag;
+	mCurrHeights[(i + 1) * mNumCols + j] += halfMag;
+	mCurrHeights[(i - 1) * mNumCols + j] += halfMag;
+
+	++mVersion;
+	for (int r = i - 1; r <= i + 1; ++r)
+	{
+		mRowVersions[r] = mVersion;
+	}
 }
 
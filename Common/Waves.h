@@ -6,9 +6,15 @@
 // Performs the calculations for the wave simulation.  After the simulation has been
 // updated, the client must copy the current solution into vertex buffers for rendering.
 // This class only does the calculations, it does not do any drawing.
+//
+// The height field is stored structure-of-arrays: heights, normals and tangents live
+// in separate contiguous float arrays so the stencil only streams the data it reads
+// and can be vectorized across a row.  The x/z grid coordinates never change, so they
+// are kept once per column/row and the AoS accessors rebuild the vectors on demand.
 //***************************************************************************************
 
 #include <vector>
+#include <cstdint>
 #include <DirectXMath.h>
 
 
@@ -28,17 +34,60 @@ public:
 	float Depth() const;
 
 	// Returns the solution at the ith grid point.
-	const DirectX::XMFLOAT3& Position(int i) const { return mCurrSolution[i]; }
+	DirectX::XMFLOAT3 Position(int i) const
+	{
+		return DirectX::XMFLOAT3(mGridX[i % mNumCols], mCurrHeights[i], mGridZ[i / mNumCols]);
+	}
 
 	// Returns the solution normal at the ith grid point.
-	const DirectX::XMFLOAT3& Normal(int i) const { return mNormals[i]; }
+	DirectX::XMFLOAT3 Normal(int i) const
+	{
+		return DirectX::XMFLOAT3(mNormalsX[i], mNormalsY[i], mNormalsZ[i]);
+	}
 
 	// Returns the unit tangent vector at the ith grid point in the local x-axis direction.
-	const DirectX::XMFLOAT3& TangentX(int i) const { return mTangentX[i]; }
+	DirectX::XMFLOAT3 TangentX(int i) const
+	{
+		return DirectX::XMFLOAT3(mTangentsX[i], mTangentsY[i], 0.0f);
+	}
+
+	// Returns the solution at the ith grid point blended between the last two
+	// simulation steps by InterpolationAlpha(), for rendering between steps.
+	DirectX::XMFLOAT3 InterpolatedPosition(int i) const
+	{
+		float alpha = InterpolationAlpha();
+		float y = mPrevHeights[i] + (mCurrHeights[i] - mPrevHeights[i]) * alpha;
+		return DirectX::XMFLOAT3(mGridX[i % mNumCols], y, mGridZ[i / mNumCols]);
+	}
+
+	// Direct access to the SoA arrays (VertexCount() floats each, row-major).
+	const float* Heights() const { return mCurrHeights.data(); }
+	const float* NormalsX() const { return mNormalsX.data(); }
+	const float* NormalsY() const { return mNormalsY.data(); }
+	const float* NormalsZ() const { return mNormalsZ.data(); }
+
+	// Incremented whenever the solution changes.  Remember the value after copying
+	// the solution out and pass it to IsRowDirty next time to find the rows of
+	// vertices that changed since; rows that have settled stop being dirty.
+	std::uint64_t Version() const { return mVersion; }
+	bool IsRowDirty(int i, std::uint64_t sinceVersion) const { return mRowVersions[i] > sinceVersion; }
 
+	// Upper bound on the number of fixed steps Update may run to catch up with dt.
+	void SetMaxSubsteps(int maxSubsteps);
+
+	// Fraction of a time step accumulated but not yet simulated, in [0, 1).
+	float InterpolationAlpha() const;
+
+	// Advances the simulation by dt seconds in whole steps of the fixed time step.
 	void Update(float dt);
 	void Disturb(int i, int j, float magnitude);
 
+private:
+	void Step();
+	void StepTile(int tile);
+	bool IntegrateRow(int i);
+	void ComputeNormalsRow(int i, const float* heights);
+
 private:
 	int mNumRows = 0;
 	int mNumCols = 0;
@@ -54,8 +103,28 @@ private:
 	float mTimeStep = 0.0f;
 	float mSpatialStep = 0.0f;
 
-	std::vector<DirectX::XMFLOAT3> mPrevSolution;
-	std::vector<DirectX::XMFLOAT3> mCurrSolution;
-	std::vector<DirectX::XMFLOAT3> mNormals;
-	std::vector<DirectX::XMFLOAT3> mTangentX;
+	// Simulation time not yet consumed by a step.
+	float mAccumulator = 0.0f;
+	int mMaxSubsteps = 4;
+
+	// x coordinate of each column and z coordinate of each row.
+	std::vector<float> mGridX;
+	std::vector<float> mGridZ;
+
+	std::vector<float> mPrevHeights;
+	std::vector<float> mCurrHeights;
+
+	std::vector<float> mNormalsX;
+	std::vector<float> mNormalsY;
+	std::vector<float> mNormalsZ;
+
+	// The tangent in the x-axis direction has no z component.
+	std::vector<float> mTangentsX;
+	std::vector<float> mTangentsY;
+
+	// Whether the last step changed any height in a row, and the version at which
+	// each row of vertices (heights and normals) last changed.
+	std::vector<std::uint8_t> mRowChanged;
+	std::vector<std::uint64_t> mRowVersions;
+	std::uint64_t mVersion = 1;
 };
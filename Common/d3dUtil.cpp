@@ -2,6 +2,7 @@
 #include <fstream>
 
 #include "d3dUtil.h"
+#include "DerivedDataCache.h"
 
 using Microsoft::WRL::ComPtr;
 
@@ -88,6 +89,49 @@ Microsoft::WRL::ComPtr<ID3D12Resource> d3dUtil::CreateDefaultBuffer(
 	return defaultBuffer;
 }
 
+std::unique_ptr<MeshGeometry> d3dUtil::CreateMeshGeometry(
+	ID3D12Device* device,
+	ID3D12GraphicsCommandList* cmdList,
+	const std::string& name,
+	const DerivedMesh& mesh)
+{
+	const UINT vbByteSize = (UINT)mesh.VertexData.size();
+	const UINT ibByteSize = (UINT)mesh.IndexData.size();
+
+	auto geo = std::make_unique<MeshGeometry>();
+	geo->Name = name;
+
+	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
+	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), mesh.VertexData.data(), vbByteSize);
+
+	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
+	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), mesh.IndexData.data(), ibByteSize);
+
+	geo->VertexBufferGPU = CreateDefaultBuffer(device, cmdList,
+		mesh.VertexData.data(), vbByteSize, geo->VertexBufferUploader);
+
+	geo->IndexBufferGPU = CreateDefaultBuffer(device, cmdList,
+		mesh.IndexData.data(), ibByteSize, geo->IndexBufferUploader);
+
+	geo->VertexByteStride = mesh.VertexStride;
+	geo->VertexBufferByteSize = vbByteSize;
+	geo->IndexFormat = mesh.IndexStride == sizeof(std::uint16_t) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+	geo->IndexBufferByteSize = ibByteSize;
+
+	for (std::size_t i = 0; i < mesh.Submeshes.size(); ++i)
+	{
+		SubmeshGeometry submesh;
+		submesh.IndexCount = mesh.Submeshes[i].IndexCount;
+		submesh.StartIndexLocation = mesh.Submeshes[i].StartIndexLocation;
+		submesh.BaseVertexLocation = mesh.Submeshes[i].BaseVertexLocation;
+		submesh.Bounds = mesh.Submeshes[i].Bounds;
+
+		geo->DrawArgs[mesh.SubmeshNames[i]] = submesh;
+	}
+
+	return geo;
+}
+
 ComPtr<ID3DBlob> d3dUtil::CompileShader(
 	const std::wstring& filename,
 	const D3D_SHADER_MACRO* defines,
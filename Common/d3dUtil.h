@@ -69,6 +69,10 @@ inline std::wstring AnsiToWString(const std::string& str)
 }
 
 
+struct MeshGeometry;
+struct DerivedMesh;
+
+
 class d3dUtil
 {
 public:
@@ -103,6 +107,16 @@ public:
 		Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer
 	);
 
+	// Creates the vertex and index buffers of a cached or freshly derived mesh and
+	// fills DrawArgs from its submeshes.  Like CreateDefaultBuffer, the uploaders must
+	// stay alive until cmdList has executed.
+	static std::unique_ptr<MeshGeometry> CreateMeshGeometry(
+		ID3D12Device* device,
+		ID3D12GraphicsCommandList* cmdList,
+		const std::string& name,
+		const DerivedMesh& mesh
+	);
+
 	static Microsoft::WRL::ComPtr<ID3DBlob> CompileShader(
 		const std::wstring& filename,
 		const D3D_SHADER_MACRO* defines,
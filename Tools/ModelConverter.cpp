@@ -0,0 +1,70 @@
+//***************************************************************************************
+// ModelConverter.cpp
+//
+// Converts the text models in Models/ into their binary, memory-mappable forms:
+//
+//     ModelConverter soldier.m3d [soldier.m3db]    (see Advanced/M3dBinary.h)
+//     ModelConverter skull.txt [skull.meshb]       (see Common/MeshFile.h)
+//
+// Without an output name the input's extension is replaced.  The triangles are reordered
+// for the GPU on the way (see Common/MeshOptimizer.h) and the vertex cache miss ratio
+// before and after is printed.
+//***************************************************************************************
+
+#include "Advanced/M3dBinary.h"
+#include "Common/MeshFile.h"
+#include "Common/MeshOptimizer.h"
+
+#include <cstdio>
+
+
+namespace
+{
+	std::string Extension(const std::string& filename)
+	{
+		std::size_t dot = filename.find_last_of('.');
+		return dot == std::string::npos ? std::string() : filename.substr(dot);
+	}
+
+	std::string ReplaceExtension(const std::string& filename, const std::string& extension)
+	{
+		std::size_t dot = filename.find_last_of('.');
+		return (dot == std::string::npos ? filename : filename.substr(0, dot)) + extension;
+	}
+
+	bool ConvertMesh(const std::string& input, const std::string& output, MeshOptimizationStats& stats)
+	{
+		std::vector<MeshFileVertex> vertices;
+		std::vector<std::uint32_t> indices;
+		if (!LoadTextMesh(input, vertices, indices))
+			return false;
+
+		stats = OptimizeMesh(vertices, indices);
+		return SaveBinaryMesh(output, vertices, indices);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2 || argc > 3)
+	{
+		std::fprintf(stderr, "usage: %s <model.m3d | mesh.txt> [output]\n", argv[0]);
+		return 1;
+	}
+
+	const std::string input = argv[1];
+	const bool isM3d = Extension(input) == ".m3d";
+	const std::string output = argc == 3 ? std::string(argv[2]) : ReplaceExtension(input, isM3d ? ".m3db" : ".meshb");
+
+	MeshOptimizationStats stats;
+	bool converted = isM3d ? M3dBinary::Convert(input, output, &stats) : ConvertMesh(input, output, stats);
+	if (!converted)
+	{
+		std::fprintf(stderr, "Could not convert %s to %s.\n", input.c_str(), output.c_str());
+		return 1;
+	}
+
+	std::printf("%s -> %s (ACMR %.3f -> %.3f over %zu triangles)\n", input.c_str(), output.c_str(),
+		stats.AcmrBefore(), stats.AcmrAfter(), stats.TriangleCount);
+	return 0;
+}